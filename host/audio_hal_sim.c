@@ -0,0 +1,394 @@
+// audio_hal_sim.c
+// audio_hal.h for the host build: a simulated codec on the I2S bus.
+#include "audio_hal.h"
+#include "audio_hal_sim.h"
+#include "esp_log.h"
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* TAG = "I2S_SIM";
+
+static audio_sim_config_t sim = AUDIO_SIM_DEFAULT_CONFIG();
+static audio_hal_i2s_config_t bus;              /**< Format the recorder asked for */
+static audio_hal_recv_cb_t recv_cb = NULL;
+static audio_hal_overflow_cb_t overflow_cb = NULL;
+static size_t block_bytes = 0;                  /**< One DMA buffer */
+
+// DMA thread
+static pthread_t dma_thread;
+static atomic_bool running;
+static atomic_uint_fast64_t frames_produced;
+static bool source_ended = false;               /**< Only silence from here on */
+
+// Receive queue (polled mode): dma_desc_num buffers, oldest dropped on overflow
+static pthread_mutex_t rx_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rx_changed;
+static uint8_t* rx_blocks = NULL;
+static uint32_t rx_head = 0;                    /**< Oldest queued buffer */
+static uint32_t rx_count = 0;                   /**< Queued buffers */
+static size_t rx_offset = 0;                    /**< Bytes of the head buffer already read */
+static uint64_t rx_taken = 0;                   /**< Bytes that left the queue, read or dropped */
+static uint64_t rx_end = UINT64_MAX;            /**< rx_taken at the end of the source's last buffer */
+
+/** Where polled mode is in reporting the end of the source */
+typedef enum {
+    END_NONE,               /**< The reader has not reached rx_end */
+    END_DUE,                /**< Reached: the read stops there and runs on_end */
+    END_SIGNALLED           /**< on_end has run; reads get silence */
+} end_state_t;
+static end_state_t end_state = END_NONE;
+
+// Signal sources
+static FILE* wav_file = NULL;
+static long wav_data_start = 0;
+static uint32_t wav_data_size = 0;
+static uint32_t wav_data_left = 0;
+static uint16_t wav_channels = 0;
+static uint16_t wav_bytes = 0;                  /**< Bytes per sample in the file */
+static double phase = 0.0;
+static uint32_t noise_state = 0x2545F491u;
+
+/**
+ * @brief Select the source and timing; call before audio_recorder_init().
+ */
+void audio_sim_configure(const audio_sim_config_t* config)
+{
+    sim = *config;
+}
+
+/**
+ * @brief Frames the simulated bus has produced since audio_hal_i2s_init().
+ */
+uint64_t audio_sim_frames(void)
+{
+    return atomic_load(&frames_produced);
+}
+
+// ==================== SOURCES ====================
+static uint32_t read_le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t read_le16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+/**
+ * @brief Open a RIFF/WAVE PCM file and position it at its data chunk.
+ */
+static bool open_wav(const char* path)
+{
+    wav_file = fopen(path, "rb");
+    if (!wav_file) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return false;
+    }
+
+    uint8_t hdr[12], chunk[8], fmt[16];
+    uint32_t rate = 0;
+    bool have_fmt = false;
+    if (fread(hdr, 1, 12, wav_file) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "%s is not a RIFF/WAVE file", path);
+        return false;
+    }
+    while (fread(chunk, 1, 8, wav_file) == 8) {
+        uint32_t size = read_le32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            if (fread(fmt, 1, 16, wav_file) != 16) break;
+            uint16_t tag = read_le16(fmt);
+            wav_channels = read_le16(fmt + 2);
+            rate = read_le32(fmt + 4);
+            wav_bytes = read_le16(fmt + 14) / 8;
+            have_fmt = (tag == 1 || tag == 0xFFFE) && (wav_channels == 1 || wav_channels == 2) &&
+                       (wav_bytes == 2 || wav_bytes == 3 || wav_bytes == 4);
+            fseek(wav_file, (long)((size - 16) + (size & 1)), SEEK_CUR);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) break;
+            wav_data_start = ftell(wav_file);
+            wav_data_size = wav_data_left = size - size % (wav_channels * wav_bytes);
+            if (rate != bus.sample_rate) {
+                ESP_LOGW(TAG, "%s is %lu Hz, replayed at the bus rate of %lu Hz", path,
+                         (unsigned long)rate, (unsigned long)bus.sample_rate);
+            }
+            ESP_LOGI(TAG, "Replaying %s: %u channel(s), %u-bit, %lu frames", path, wav_channels,
+                     wav_bytes * 8, (unsigned long)(wav_data_size / (wav_channels * wav_bytes)));
+            return true;
+        } else {
+            fseek(wav_file, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    ESP_LOGE(TAG, "%s has no PCM data the bus can carry (16/24/32-bit, 1-2 channels)", path);
+    return false;
+}
+
+/**
+ * @brief Decode one WAV sample, left-aligned in 32 bits.
+ */
+static int32_t wav_sample(const uint8_t* p)
+{
+    switch (wav_bytes) {
+        case 2:  return (int32_t)((uint32_t)read_le16(p) << 16);
+        case 3:  return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+        default: return (int32_t)read_le32(p);
+    }
+}
+
+/**
+ * @brief Store one left-aligned 32-bit sample in the bus slot format.
+ *
+ * 24-bit audio arrives MSB-aligned in 32-bit slots with the low byte zero,
+ * as from the codec; 16-bit slots carry the top half.
+ */
+static void put_slot(uint8_t* dst, int32_t v)
+{
+    if (bus.slot_bits == 16) {
+        int16_t s = (int16_t)(v >> 16);
+        memcpy(dst, &s, 2);
+    } else {
+        v &= ~0xFF;
+        memcpy(dst, &v, 4);
+    }
+}
+
+static int32_t from_unit(double x)
+{
+    if (x > 1.0) x = 1.0;
+    if (x < -1.0) x = -1.0;
+    return (int32_t)lrint(x * 2147483392.0);    // Full scale with 24 significant bits
+}
+
+/**
+ * @brief Fill one DMA buffer from the configured source.
+ */
+static void fill_block(uint8_t* dst)
+{
+    const size_t slot = bus.slot_bits / 8;
+    const double amplitude = pow(10.0, sim.level_dbfs / 20.0);
+    uint8_t frame[8];
+
+    for (uint32_t i = 0; i < bus.dma_frame_num; i++, dst += 2 * slot) {
+        int32_t left = 0, right = 0;
+        switch (source_ended ? AUDIO_SIM_SILENCE : sim.source) {
+            case AUDIO_SIM_SINE:
+                left = right = from_unit(amplitude * sin(phase));
+                phase += 2.0 * M_PI * sim.tone_hz / bus.sample_rate;
+                if (phase > 2.0 * M_PI) phase -= 2.0 * M_PI;
+                break;
+            case AUDIO_SIM_NOISE:
+                for (int c = 0; c < 2; c++) {
+                    noise_state ^= noise_state << 13;   // xorshift32
+                    noise_state ^= noise_state >> 17;
+                    noise_state ^= noise_state << 5;
+                    int32_t v = from_unit(amplitude * ((double)noise_state / 2147483648.0 - 1.0));
+                    if (c == 0) left = v; else right = v;
+                }
+                break;
+            case AUDIO_SIM_WAV: {
+                size_t frame_bytes = (size_t)wav_channels * wav_bytes;
+                if (wav_data_left == 0 && sim.loop && wav_data_size > 0) {
+                    fseek(wav_file, wav_data_start, SEEK_SET);
+                    wav_data_left = wav_data_size;
+                }
+                if (wav_data_left == 0 || fread(frame, 1, frame_bytes, wav_file) != frame_bytes) {
+                    wav_data_left = 0;
+                    source_ended = true;        // Silence follows, as from an idle codec
+                    break;
+                }
+                wav_data_left -= (uint32_t)frame_bytes;
+                left = wav_sample(frame);
+                right = (wav_channels == 2) ? wav_sample(frame + wav_bytes) : left;
+                break;
+            }
+            default:
+                break;
+        }
+        put_slot(dst, left);
+        put_slot(dst + slot, right);
+    }
+}
+
+// ==================== DMA THREAD ====================
+/**
+ * @brief Hand a completed buffer to the receive queue, dropping the oldest when full.
+ *
+ * Unpaced, it waits for the reader to make room instead.
+ *
+ * @param block Completed buffer
+ * @param last The source ends with this buffer
+ */
+static void queue_block(const uint8_t* block, bool last)
+{
+    pthread_mutex_lock(&rx_lock);
+    while (sim.speed <= 0.0f && rx_count == bus.dma_desc_num && atomic_load(&running)) {
+        pthread_cond_wait(&rx_changed, &rx_lock);   // Unpaced: the reader sets the rate
+    }
+    if (rx_count == bus.dma_desc_num) {
+        rx_taken += block_bytes - rx_offset;
+        rx_head = (rx_head + 1) % bus.dma_desc_num;
+        rx_count--;
+        rx_offset = 0;
+        if (overflow_cb) overflow_cb(block_bytes);
+    }
+    memcpy(rx_blocks + ((rx_head + rx_count) % bus.dma_desc_num) * block_bytes, block, block_bytes);
+    rx_count++;
+    if (last) rx_end = rx_taken + (uint64_t)(rx_count * block_bytes - rx_offset);
+    pthread_cond_broadcast(&rx_changed);
+    pthread_mutex_unlock(&rx_lock);
+}
+
+static void* dma_main(void* arg)
+{
+    bool ended = false;
+    uint8_t* block = malloc(block_bytes);
+    if (!block) return NULL;
+
+    const uint64_t period_ns = (sim.speed > 0.0f)
+        ? (uint64_t)(bus.dma_frame_num * 1e9 / bus.sample_rate / sim.speed) : 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (atomic_load(&running)) {
+        if (period_ns > 0) {
+            // A buffer completes one period after the previous one, whatever the callback cost
+            uint64_t ns = (uint64_t)next.tv_nsec + period_ns;
+            next.tv_sec += (time_t)(ns / 1000000000u);
+            next.tv_nsec = (long)(ns % 1000000000u);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+            }
+        }
+
+        if (ended && bus.callback_mode) continue;
+
+        fill_block(block);
+        uint64_t frames = atomic_fetch_add(&frames_produced, bus.dma_frame_num) + bus.dma_frame_num;
+        if (sim.frames > 0 && frames >= sim.frames) source_ended = true;
+        bool last = source_ended && !ended;
+        if (bus.callback_mode) {
+            recv_cb(block, block_bytes);
+        } else {
+            queue_block(block, last);   // The reader runs on_end once it has taken this buffer
+        }
+
+        if (last) {
+            ended = true;
+            ESP_LOGI(TAG, "Source ended after %llu frames", (unsigned long long)frames);
+            if (bus.callback_mode && sim.on_end) sim.on_end();
+        }
+    }
+    free(block);
+    return NULL;
+}
+
+// ==================== HAL ====================
+bool audio_hal_i2s_init(const audio_hal_i2s_config_t* config,
+                        audio_hal_recv_cb_t on_recv, audio_hal_overflow_cb_t on_overflow)
+{
+    bus = *config;
+    recv_cb = on_recv;
+    overflow_cb = on_overflow;
+    block_bytes = (size_t)bus.dma_frame_num * 2 * (bus.slot_bits / 8);
+
+    if (bus.callback_mode && sim.speed <= 0.0f) {
+        ESP_LOGE(TAG, "Callback mode needs a paced bus (speed > 0)");
+        return false;
+    }
+    if (sim.source == AUDIO_SIM_WAV && !open_wav(sim.wav_path)) {
+        if (wav_file) { fclose(wav_file); wav_file = NULL; }
+        return false;
+    }
+
+    rx_blocks = malloc(block_bytes * bus.dma_desc_num);
+    if (!rx_blocks) return false;
+    rx_head = rx_count = 0;
+    rx_offset = 0;
+    rx_taken = 0;
+    rx_end = UINT64_MAX;
+    end_state = END_NONE;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rx_changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    source_ended = false;
+    phase = 0.0;                    // Every session sees the same signal
+    noise_state = 0x2545F491u;
+    atomic_store(&frames_produced, 0);
+    atomic_store(&running, true);
+    if (pthread_create(&dma_thread, NULL, dma_main, NULL) != 0) {
+        free(rx_blocks);
+        rx_blocks = NULL;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "I2S simulated at %lu Hz, %u-bit slots, %s, speed %.1fx", (unsigned long)bus.sample_rate,
+             bus.slot_bits, bus.callback_mode ? "DMA callback" : "polled", (double)sim.speed);
+    return true;
+}
+
+void audio_hal_i2s_deinit(void)
+{
+    if (!rx_blocks) return;
+    atomic_store(&running, false);
+    pthread_mutex_lock(&rx_lock);
+    pthread_cond_broadcast(&rx_changed);
+    pthread_mutex_unlock(&rx_lock);
+    pthread_join(dma_thread, NULL);
+
+    pthread_cond_destroy(&rx_changed);
+    free(rx_blocks);
+    rx_blocks = NULL;
+    if (wav_file) { fclose(wav_file); wav_file = NULL; }
+}
+
+/**
+ * @brief Polled read. The read that takes the last buffer of the source
+ * stops there, short but ESP_OK, and runs on_end before returning, so a
+ * reader that stops on it has captured exactly what the source produced.
+ */
+esp_err_t audio_hal_i2s_read(void* buf, size_t size, size_t* bytes_read, uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    uint8_t* out = buf;
+    size_t done = 0;
+    esp_err_t err = ESP_OK;
+    pthread_mutex_lock(&rx_lock);
+    while (done < size) {
+        if (end_state == END_NONE && rx_taken >= rx_end) end_state = END_DUE;
+        if (end_state == END_DUE) break;
+        if (rx_count == 0) {
+            if (pthread_cond_timedwait(&rx_changed, &rx_lock, &deadline) == ETIMEDOUT) {
+                err = ESP_ERR_TIMEOUT;
+                break;
+            }
+            continue;
+        }
+        size_t n = block_bytes - rx_offset;
+        if (n > size - done) n = size - done;
+        memcpy(out + done, rx_blocks + rx_head * block_bytes + rx_offset, n);
+        done += n;
+        rx_offset += n;
+        rx_taken += n;
+        if (rx_offset == block_bytes) {
+            rx_head = (rx_head + 1) % bus.dma_desc_num;
+            rx_count--;
+            rx_offset = 0;
+            pthread_cond_broadcast(&rx_changed);
+        }
+    }
+    bool end_now = (end_state == END_DUE);
+    if (end_now) end_state = END_SIGNALLED;
+    pthread_mutex_unlock(&rx_lock);
+    *bytes_read = done;
+    if (end_now && sim.on_end) sim.on_end();
+    return err;
+}
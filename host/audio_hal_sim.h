@@ -0,0 +1,67 @@
+// audio_hal_sim.h
+#ifndef AUDIO_HAL_SIM_H
+#define AUDIO_HAL_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+// Señal que entrega el I2S simulado
+typedef enum {
+    AUDIO_SIM_SINE,         /**< Tone on both channels */
+    AUDIO_SIM_NOISE,        /**< White noise on both channels */
+    AUDIO_SIM_SILENCE,      /**< Digital silence */
+    AUDIO_SIM_WAV           /**< Replay of a PCM WAV file (16/24/32-bit, mono or stereo) */
+} audio_sim_source_t;
+
+/**
+ * @brief What the simulated codec produces and how fast (audio_hal.h on the host).
+ *
+ * A thread stands in for the I2S DMA: every dma_frame_num frames of
+ * simulated time it completes one buffer, handing it to the recorder's
+ * callback (callback mode) or to the receive queue that
+ * audio_hal_i2s_read() drains (polled mode, dropping the oldest buffer
+ * when the queue is full, as the driver does).
+ *
+ * The source ends after frames, or at the end of a WAV that does not
+ * loop. The buffer holding the last frame is delivered whole (padded with
+ * silence). on_end runs once the recorder has it: after the callback in
+ * callback mode, and in polled mode from the audio_hal_i2s_read() that
+ * takes it, which stops short there. After that callback mode delivers
+ * nothing more, while polled mode returns silence.
+ */
+typedef struct {
+    audio_sim_source_t source;
+    const char* wav_path;       /**< File replayed by AUDIO_SIM_WAV */
+    bool loop;                  /**< Restart the WAV at its end; otherwise silence follows it */
+    float tone_hz;              /**< AUDIO_SIM_SINE frequency */
+    float level_dbfs;           /**< Peak level of the tone or noise */
+    float speed;                /**< 1 = real time, N = N times faster, 0 = as fast as a polled reader takes it */
+    uint64_t frames;            /**< Frames until the source ends, 0 = unlimited (counted from init) */
+    void (*on_end)(void);       /**< Called once the recorder has taken the last buffer of the source */
+} audio_sim_config_t;
+
+#define AUDIO_SIM_DEFAULT_CONFIG() {    \
+    .source = AUDIO_SIM_SINE,           \
+    .wav_path = NULL,                   \
+    .loop = false,                      \
+    .tone_hz = 1000.0f,                 \
+    .level_dbfs = -20.0f,               \
+    .speed = 1.0f,                      \
+    .frames = 0,                        \
+    .on_end = NULL,                     \
+}
+
+// ==================== API PÚBLICA ====================
+void audio_sim_configure(const audio_sim_config_t* config);
+uint64_t audio_sim_frames(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_HAL_SIM_H
@@ -0,0 +1,245 @@
+// main.c (host build)
+// Runs the recorder pipeline off-target: simulated I2S in, a local
+// directory as the card, the same main/ sources in between.
+#include "audio_bench.h"
+#include "audio_hal_sim.h"
+#include "audio_recorder.h"
+#include "calendar.h"
+#include "roundtrip.h"
+#include "sd_host.h"
+#include "sd_mmc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "HOST";
+
+static void usage(const char* prog)
+{
+    const audio_recorder_config_t defaults = AUDIO_RECORDER_DEFAULT_CONFIG();
+    fprintf(stderr,
+        "Usage: %s [options] [output.wav]\n"
+        "Signal (simulated I2S):\n"
+        "  --source sine|noise|silence|FILE.wav   (default sine)\n"
+        "  --tone HZ --level DBFS --loop\n"
+        "  --speed X          1 = real time, N = N times faster, 0 = unpaced (polled only)\n"
+        "Recorder:\n"
+        "  --rate HZ --bits 16|24|32 --channels 1|2 --output-rate HZ\n"
+        "  --format wav|flac|adpcm|log   --mode callback|polled   --raw-log\n"
+        "  --seconds S        source length from init (default 60, calendar: unlimited)\n"
+        "  --checkpoint S     header checkpoint interval, 0 = only at close (default %u)\n"
+        "  --no-prealloc      do not reserve each file's projected size\n"
+        "Pipeline stages (off by default):\n"
+        "  --trigger-dbfs DBFS  activity gate threshold   --pre-roll MS --post-roll MS\n"
+        "  --highpass HZ --lowpass HZ                      Butterworth filters\n"
+        "  --spectrum         .spc spectral summary next to each file\n"
+        "  --meter-interval S Leq log interval (needed by --format log)   --calibration DB\n"
+        "Card (local directory):\n"
+        "  --sd DIR           card root (default sdcard)\n"
+        "  --write-size B     bytes per file write (default %u)\n"
+        "  --latency US --us-per-kb US --sync-latency US\n"
+        "  --stall-every N --stall US      every Nth write stalls for US\n"
+        "  --raw-log-mb MB    raw log partition in a new DIR/card.img (default 64 with --raw-log)\n"
+        "Other:\n"
+        "  --calendar         run one wake of the calendar (DIR/Calendar.csv, default recorder config)\n"
+        "  --bench            run the kernel benchmark and codec round trips (in DIR), exit 1 on a failure\n"
+        "  --verbose\n",
+        prog, (unsigned)defaults.checkpoint_interval_s, (unsigned)SD_FILE_STAGE_SIZE);
+}
+
+static bool parse_format(const char* s, audio_format_t* format)
+{
+    if (strcmp(s, "wav") == 0) *format = AUDIO_FORMAT_WAV;
+    else if (strcmp(s, "flac") == 0) *format = AUDIO_FORMAT_FLAC;
+    else if (strcmp(s, "adpcm") == 0) *format = AUDIO_FORMAT_IMA_ADPCM;
+    else if (strcmp(s, "log") == 0) *format = AUDIO_FORMAT_LOG_ONLY;
+    else return false;
+    return true;
+}
+
+static void print_stats(const audio_recorder_stats_t* st, int64_t elapsed_us, uint32_t rate)
+{
+    double audio_s = (double)st->frames_captured / rate;
+    printf("frames_captured   %llu (%.2f s of audio)\n", (unsigned long long)st->frames_captured, audio_s);
+    printf("real_time         %.2f s (%.1fx)\n", elapsed_us / 1e6, elapsed_us > 0 ? audio_s * 1e6 / elapsed_us : 0.0);
+    printf("card_bytes        %llu\n", (unsigned long long)st->card_bytes);
+    printf("write_kbps        %lu\n", (unsigned long)st->write_kbps);
+    printf("card_writes       %lu\n", (unsigned long)st->card_writes);
+    printf("write_p50_us      %lu\n", (unsigned long)st->write_p50_us);
+    printf("write_p95_us      %lu\n", (unsigned long)st->write_p95_us);
+    printf("write_p99_us      %lu\n", (unsigned long)st->write_p99_us);
+    printf("write_max_us      %lu\n", (unsigned long)st->write_max_us);
+    printf("write_stalls      %lu\n", (unsigned long)st->write_stalls);
+    printf("stall_ring_max    %lu\n", (unsigned long)st->stall_ring_max);
+    printf("ring              %lu of %lu bytes\n", (unsigned long)st->ring_high_water, (unsigned long)st->ring_size);
+    printf("overrun_frames    %lu\n", (unsigned long)st->overrun_frames);
+    printf("trigger_events    %lu (%llu frames gated)\n", (unsigned long)st->trigger_events,
+           (unsigned long long)st->frames_gated);
+    printf("gap_events        %lu (%llu frames)\n", (unsigned long)st->gap_events, (unsigned long long)st->gap_frames);
+    printf("short_reads       %lu\n", (unsigned long)st->short_reads);
+    printf("dma_overflows     %lu\n", (unsigned long)st->dma_overflows);
+    printf("checkpoints       %lu\n", (unsigned long)st->checkpoints);
+}
+
+int main(int argc, char** argv)
+{
+    audio_sim_config_t sim = AUDIO_SIM_DEFAULT_CONFIG();
+    sd_host_config_t card = SD_HOST_DEFAULT_CONFIG();
+    audio_recorder_config_t rec = AUDIO_RECORDER_DEFAULT_CONFIG();
+    double seconds = 0.0;
+    bool calendar = false, bench = false;
+
+    enum {
+        OPT_SOURCE = 256, OPT_TONE, OPT_LEVEL, OPT_LOOP, OPT_SPEED, OPT_RATE, OPT_BITS, OPT_CHANNELS,
+        OPT_OUTPUT_RATE, OPT_FORMAT, OPT_MODE, OPT_RAW_LOG, OPT_SECONDS, OPT_CHECKPOINT, OPT_NO_PREALLOC,
+        OPT_TRIGGER_DBFS, OPT_PRE_ROLL, OPT_POST_ROLL, OPT_HIGHPASS, OPT_LOWPASS, OPT_SPECTRUM,
+        OPT_METER_INTERVAL, OPT_CALIBRATION, OPT_SD, OPT_WRITE_SIZE,
+        OPT_LATENCY, OPT_US_PER_KB, OPT_SYNC_LATENCY, OPT_STALL_EVERY, OPT_STALL, OPT_RAW_LOG_MB,
+        OPT_CALENDAR, OPT_BENCH, OPT_VERBOSE, OPT_HELP
+    };
+    static const struct option options[] = {
+        { "source", required_argument, NULL, OPT_SOURCE },
+        { "tone", required_argument, NULL, OPT_TONE },
+        { "level", required_argument, NULL, OPT_LEVEL },
+        { "loop", no_argument, NULL, OPT_LOOP },
+        { "speed", required_argument, NULL, OPT_SPEED },
+        { "rate", required_argument, NULL, OPT_RATE },
+        { "bits", required_argument, NULL, OPT_BITS },
+        { "channels", required_argument, NULL, OPT_CHANNELS },
+        { "output-rate", required_argument, NULL, OPT_OUTPUT_RATE },
+        { "format", required_argument, NULL, OPT_FORMAT },
+        { "mode", required_argument, NULL, OPT_MODE },
+        { "raw-log", no_argument, NULL, OPT_RAW_LOG },
+        { "seconds", required_argument, NULL, OPT_SECONDS },
+        { "checkpoint", required_argument, NULL, OPT_CHECKPOINT },
+        { "no-prealloc", no_argument, NULL, OPT_NO_PREALLOC },
+        { "trigger-dbfs", required_argument, NULL, OPT_TRIGGER_DBFS },
+        { "pre-roll", required_argument, NULL, OPT_PRE_ROLL },
+        { "post-roll", required_argument, NULL, OPT_POST_ROLL },
+        { "highpass", required_argument, NULL, OPT_HIGHPASS },
+        { "lowpass", required_argument, NULL, OPT_LOWPASS },
+        { "spectrum", no_argument, NULL, OPT_SPECTRUM },
+        { "meter-interval", required_argument, NULL, OPT_METER_INTERVAL },
+        { "calibration", required_argument, NULL, OPT_CALIBRATION },
+        { "sd", required_argument, NULL, OPT_SD },
+        { "write-size", required_argument, NULL, OPT_WRITE_SIZE },
+        { "latency", required_argument, NULL, OPT_LATENCY },
+        { "us-per-kb", required_argument, NULL, OPT_US_PER_KB },
+        { "sync-latency", required_argument, NULL, OPT_SYNC_LATENCY },
+        { "stall-every", required_argument, NULL, OPT_STALL_EVERY },
+        { "stall", required_argument, NULL, OPT_STALL },
+        { "raw-log-mb", required_argument, NULL, OPT_RAW_LOG_MB },
+        { "calendar", no_argument, NULL, OPT_CALENDAR },
+        { "bench", no_argument, NULL, OPT_BENCH },
+        { "verbose", no_argument, NULL, OPT_VERBOSE },
+        { "help", no_argument, NULL, OPT_HELP },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_SOURCE:
+                if (strcmp(optarg, "sine") == 0) sim.source = AUDIO_SIM_SINE;
+                else if (strcmp(optarg, "noise") == 0) sim.source = AUDIO_SIM_NOISE;
+                else if (strcmp(optarg, "silence") == 0) sim.source = AUDIO_SIM_SILENCE;
+                else { sim.source = AUDIO_SIM_WAV; sim.wav_path = optarg; }
+                break;
+            case OPT_TONE: sim.tone_hz = strtof(optarg, NULL); break;
+            case OPT_LEVEL: sim.level_dbfs = strtof(optarg, NULL); break;
+            case OPT_LOOP: sim.loop = true; break;
+            case OPT_SPEED: sim.speed = strtof(optarg, NULL); break;
+            case OPT_RATE: rec.sample_rate = strtoul(optarg, NULL, 0); break;
+            case OPT_BITS: rec.bits_per_sample = (uint8_t)strtoul(optarg, NULL, 0); break;
+            case OPT_CHANNELS: rec.channels = (uint8_t)strtoul(optarg, NULL, 0); break;
+            case OPT_OUTPUT_RATE: rec.output_rate = strtoul(optarg, NULL, 0); break;
+            case OPT_FORMAT:
+                if (!parse_format(optarg, &rec.format)) { usage(argv[0]); return 2; }
+                break;
+            case OPT_MODE:
+                rec.capture_mode = (strcmp(optarg, "polled") == 0) ? CAPTURE_MODE_POLLED : CAPTURE_MODE_DMA_CALLBACK;
+                break;
+            case OPT_RAW_LOG: rec.raw_log = true; break;
+            case OPT_SECONDS: seconds = strtod(optarg, NULL); break;
+            case OPT_CHECKPOINT: rec.checkpoint_interval_s = strtoul(optarg, NULL, 0); break;
+            case OPT_NO_PREALLOC: rec.preallocate = false; break;
+            case OPT_TRIGGER_DBFS:
+                rec.trigger_enabled = true;
+                rec.trigger_threshold_dbfs = strtof(optarg, NULL);
+                break;
+            case OPT_PRE_ROLL: rec.pre_roll_ms = strtoul(optarg, NULL, 0); break;
+            case OPT_POST_ROLL: rec.post_roll_ms = strtoul(optarg, NULL, 0); break;
+            case OPT_HIGHPASS: rec.highpass_hz = strtoul(optarg, NULL, 0); break;
+            case OPT_LOWPASS: rec.lowpass_hz = strtoul(optarg, NULL, 0); break;
+            case OPT_SPECTRUM: rec.spectrum_enabled = true; break;
+            case OPT_METER_INTERVAL: rec.meter_interval_s = strtoul(optarg, NULL, 0); break;
+            case OPT_CALIBRATION: rec.meter_calibration_db = strtof(optarg, NULL); break;
+            case OPT_SD: card.root = optarg; break;
+            case OPT_WRITE_SIZE: card.write_size = strtoul(optarg, NULL, 0); break;
+            case OPT_LATENCY: card.write_latency_us = strtoul(optarg, NULL, 0); break;
+            case OPT_US_PER_KB: card.write_us_per_kb = strtoul(optarg, NULL, 0); break;
+            case OPT_SYNC_LATENCY: card.sync_latency_us = strtoul(optarg, NULL, 0); break;
+            case OPT_STALL_EVERY: card.stall_every = strtoul(optarg, NULL, 0); break;
+            case OPT_STALL: card.stall_us = strtoul(optarg, NULL, 0); break;
+            case OPT_RAW_LOG_MB: card.raw_log_mb = strtoul(optarg, NULL, 0); break;
+            case OPT_CALENDAR: calendar = true; break;
+            case OPT_BENCH: bench = true; break;
+            case OPT_VERBOSE: esp_log_level_set("*", ESP_LOG_DEBUG); break;
+            default: usage(argv[0]); return (opt == OPT_HELP) ? 0 : 2;
+        }
+    }
+    if (card.write_size < 512 || (card.write_size & (card.write_size - 1)) != 0 || seconds < 0.0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (rec.raw_log && card.raw_log_mb == 0) card.raw_log_mb = 64;
+    if (seconds == 0.0 && !calendar) seconds = 60.0;
+
+    sd_host_configure(&card);
+    if (bench) {
+        bool ok = audio_bench_run();
+        ok = roundtrip_adpcm() && ok;
+        sd_card_unmount();
+        return ok ? 0 : 1;
+    }
+
+    // The simulated source ends the session; the recorder's own length (whole minutes) is a bound
+    sim.frames = (uint64_t)(seconds * rec.sample_rate);
+    sim.on_end = audio_recorder_stop;
+    audio_sim_configure(&sim);
+
+    if (calendar) {
+        check_calendar();       // Deep sleep ends the process; continuous recording returns when the source ends
+        sd_card_unmount();
+        return 0;
+    }
+
+    char filename[128];
+    snprintf(filename, sizeof(filename), "/%s", optind < argc ? argv[optind] : "host");
+    if (!strchr(filename, '.')) {
+        strncat(filename, audio_recorder_file_extension(rec.format), sizeof(filename) - strlen(filename) - 1);
+    }
+
+    if (!audio_recorder_init(&rec)) {
+        ESP_LOGE(TAG, "Recorder initialization failed");
+        return 1;
+    }
+
+    uint64_t minutes = (uint64_t)((seconds + 59.0) / 60.0);
+    int64_t t0 = esp_timer_get_time();
+    bool ok = audio_recorder_start(filename, minutes);
+    int64_t elapsed = esp_timer_get_time() - t0;
+
+    audio_recorder_stats_t stats;
+    audio_recorder_get_stats(&stats);
+    audio_recorder_deinit();
+    sd_card_unmount();
+
+    print_stats(&stats, elapsed, rec.sample_rate);
+    if (!ok) ESP_LOGE(TAG, "Session failed");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// esp_port.c
+// ESP-IDF system services used by main/: console log, timers, cycle
+// counter, error names and deep sleep.
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG_LEVELS 16
+
+static uint64_t boot_ns = 0;                    /**< CLOCK_MONOTONIC at startup */
+static uint64_t wakeup_us = 0;                  /**< Set by esp_sleep_enable_timer_wakeup() */
+static esp_log_level_t default_level = ESP_LOG_INFO;
+static struct { const char* tag; esp_log_level_t level; } tag_levels[LOG_TAG_LEVELS];
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+__attribute__((constructor)) static void port_boot(void)
+{
+    boot_ns = monotonic_ns();
+}
+
+// ==================== TIME ====================
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)((monotonic_ns() - boot_ns) / 1000);
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    return (esp_cpu_cycle_count_t)((monotonic_ns() - boot_ns) * HOST_CPU_TICKS_PER_US / 1000);
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return HOST_CPU_TICKS_PER_US;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+    struct timespec ts = { us / 1000000, (long)(us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+
+// ==================== LOG ====================
+static esp_log_level_t level_of(const char* tag)
+{
+    for (int i = 0; i < LOG_TAG_LEVELS && tag_levels[i].tag; i++) {
+        if (strcmp(tag_levels[i].tag, tag) == 0) return tag_levels[i].level;
+    }
+    return default_level;
+}
+
+/**
+ * @brief Set the level of one tag, or of every tag with "*".
+ */
+void esp_log_level_set(const char* tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&log_lock);
+    if (strcmp(tag, "*") == 0) {
+        default_level = level;
+    } else {
+        int i = 0;
+        while (i < LOG_TAG_LEVELS - 1 && tag_levels[i].tag && strcmp(tag_levels[i].tag, tag) != 0) i++;
+        tag_levels[i].tag = tag;
+        tag_levels[i].level = level;
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...)
+{
+    static const char letters[] = "NEWIDV";
+
+    pthread_mutex_lock(&log_lock);
+    bool shown = level <= level_of(tag);
+    pthread_mutex_unlock(&log_lock);
+    if (!shown) return;
+
+    char line[512];
+    int n = snprintf(line, sizeof(line), "%c (%lld) %s: ", letters[level],
+                     (long long)(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + n, sizeof(line) - n, format, args);
+    va_end(args);
+    fprintf(stderr, "%s\n", line);
+}
+
+// ==================== ERRORS ====================
+const char* esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                    return "ESP_OK";
+        case ESP_FAIL:                  return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+        default:                        return "UNKNOWN ERROR";
+    }
+}
+
+// ==================== SLEEP ====================
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us)
+{
+    wakeup_us = time_in_us;
+    return ESP_OK;
+}
+
+/**
+ * @brief Deep sleep ends the run; a scheduler (or the user) starts the next wake.
+ */
+void esp_deep_sleep_start(void)
+{
+    ESP_LOGI("HOST", "Deep sleep, wake up in %llu s: exiting", (unsigned long long)(wakeup_us / 1000000));
+    fflush(NULL);
+    exit(0);
+}
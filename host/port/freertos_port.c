@@ -0,0 +1,292 @@
+// freertos_port.c
+// FreeRTOS tasks, notifications, queues and semaphores on POSIX threads.
+// Threads that were not created with xTaskCreatePinnedToCore() (the main
+// thread, the simulated I2S interrupt) get a task record on first use.
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct host_task {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify_value;      /**< Pending xTaskNotifyGive() count */
+    TaskFunction_t fn;
+    void* param;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;     /**< Broadcast on every send, receive and reset */
+    uint8_t* items;
+    size_t item_size;           /**< 0 for semaphores */
+    UBaseType_t length;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+static __thread struct host_task* current_task = NULL;
+
+static void init_cond(pthread_cond_t* cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct host_task* new_task(void)
+{
+    struct host_task* task = calloc(1, sizeof(*task));
+    if (!task) abort();
+    pthread_mutex_init(&task->lock, NULL);
+    init_cond(&task->notified);
+    return task;
+}
+
+static struct host_task* self(void)
+{
+    if (!current_task) {
+        current_task = new_task();
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+/**
+ * @brief Absolute CLOCK_MONOTONIC time ticks from now.
+ */
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ticks / configTICK_RATE_HZ;
+    ts.tv_nsec += (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ);
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+/**
+ * @brief Wait for a condition change with a FreeRTOS timeout.
+ * @return false once the timeout has expired
+ */
+static bool wait_for(pthread_cond_t* cond, pthread_mutex_t* lock, TickType_t ticks, const struct timespec* deadline)
+{
+    if (ticks == 0) return false;
+    if (ticks == portMAX_DELAY) return pthread_cond_wait(cond, lock) == 0;
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+// ==================== TASKS ====================
+static void* task_main(void* arg)
+{
+    current_task = arg;
+    current_task->fn(current_task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+    (void)name; (void)stack_depth; (void)priority; (void)core;
+
+    struct host_task* task = new_task();
+    task->fn = fn;
+    task->param = param;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&task->thread, &attr, task_main, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+/**
+ * @brief End a task. The record is kept: other tasks may still hold its handle.
+ */
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == current_task) pthread_exit(NULL);
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = deadline_after(ticks);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * configTICK_RATE_HZ + ts.tv_nsec / (1000000000L / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return self();
+}
+
+// ==================== NOTIFICATIONS ====================
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task* task = self();
+    struct timespec deadline = deadline_after(ticks_to_wait == portMAX_DELAY ? 0 : ticks_to_wait);
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_value == 0 && wait_for(&task->notified, &task->lock, ticks_to_wait, &deadline)) {
+    }
+    uint32_t value = task->notify_value;
+    if (value > 0) task->notify_value = clear_on_exit ? 0 : value - 1;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify_value++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken)
+{
+    xTaskNotifyGive(task);
+    if (woken) *woken = pdTRUE;
+}
+
+// ==================== QUEUES ====================
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue* queue = calloc(1, sizeof(*queue));
+    if (!queue) return NULL;
+    queue->items = item_size ? malloc((size_t)length * item_size) : NULL;
+    if (item_size && !queue->items) {
+        free(queue);
+        return NULL;
+    }
+    queue->item_size = item_size;
+    queue->length = length;
+    pthread_mutex_init(&queue->lock, NULL);
+    init_cond(&queue->changed);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (!queue) return;
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait)
+{
+    struct timespec deadline = deadline_after(ticks_to_wait == portMAX_DELAY ? 0 : ticks_to_wait);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && wait_for(&queue->changed, &queue->lock, ticks_to_wait, &deadline)) {
+    }
+    BaseType_t ok = queue->count < queue->length;
+    if (ok) {
+        if (queue->item_size && item) {
+            UBaseType_t tail = (queue->head + queue->count) % queue->length;
+            memcpy(queue->items + (size_t)tail * queue->item_size, item, queue->item_size);
+        }
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* woken)
+{
+    BaseType_t ok = xQueueSend(queue, item, 0);
+    if (ok && woken) *woken = pdTRUE;
+    return ok;
+}
+
+static BaseType_t queue_take(QueueHandle_t queue, void* item, TickType_t ticks_to_wait, bool remove)
+{
+    struct timespec deadline = deadline_after(ticks_to_wait == portMAX_DELAY ? 0 : ticks_to_wait);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && wait_for(&queue->changed, &queue->lock, ticks_to_wait, &deadline)) {
+    }
+    BaseType_t ok = queue->count > 0;
+    if (ok) {
+        if (queue->item_size && item) {
+            memcpy(item, queue->items + (size_t)queue->head * queue->item_size, queue->item_size);
+        }
+        if (remove) {
+            queue->head = (queue->head + 1) % queue->length;
+            queue->count--;
+            pthread_cond_broadcast(&queue->changed);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait)
+{
+    return queue_take(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void* item, TickType_t ticks_to_wait)
+{
+    return queue_take(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->head = queue->count = 0;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+// ==================== SEMAPHORES ====================
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);      // Created empty
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t sem = xQueueCreate(1, 0);
+    if (sem) xSemaphoreGive(sem);   // Created available
+    return sem;
+}
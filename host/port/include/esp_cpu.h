@@ -0,0 +1,20 @@
+// esp_cpu.h (host port)
+#ifndef HOST_ESP_CPU_H
+#define HOST_ESP_CPU_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+/** Cycles of a simulated core at esp_rom_get_cpu_ticks_per_us() MHz, from CLOCK_MONOTONIC */
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_ESP_CPU_H
@@ -0,0 +1,20 @@
+// esp_rom_sys.h (host port)
+#ifndef HOST_ESP_ROM_SYS_H
+#define HOST_ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOST_CPU_TICKS_PER_US 240   // ESP32-S3 at 240 MHz, so cycle counts wrap as on the device
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void);
+void esp_rom_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_ESP_ROM_SYS_H
@@ -0,0 +1,20 @@
+// esp_sleep.h (host port)
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us);
+/** Ends the process: the next wake is the next run */
+void esp_deep_sleep_start(void) __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_ESP_SLEEP_H
@@ -0,0 +1,13 @@
+// esp_task_wdt.h (host port)
+#ifndef HOST_ESP_TASK_WDT_H
+#define HOST_ESP_TASK_WDT_H
+
+#include "esp_err.h"
+#include "freertos/task.h"
+
+// No watchdog on the host
+static inline esp_err_t esp_task_wdt_add(TaskHandle_t task) { (void)task; return ESP_OK; }
+static inline esp_err_t esp_task_wdt_delete(TaskHandle_t task) { (void)task; return ESP_OK; }
+static inline esp_err_t esp_task_wdt_reset(void) { return ESP_OK; }
+
+#endif // HOST_ESP_TASK_WDT_H
@@ -0,0 +1,44 @@
+// FreeRTOS.h (host port)
+// Subset of the FreeRTOS API used by main/, mapped onto POSIX threads.
+// One tick is one millisecond.
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+/** Critical sections only exclude other users of the same lock (no interrupts to mask) */
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+#define taskENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->mutex)
+#define taskENTER_CRITICAL_ISR(mux) taskENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_ISR(mux) taskEXIT_CRITICAL(mux)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_FREERTOS_H
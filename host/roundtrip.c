@@ -0,0 +1,164 @@
+// roundtrip.c
+// Codec round trips through the whole recorder: the same simulated source
+// recorded as PCM and as a compressed format, then compared sample by
+// sample. Run by --bench after the kernel checks.
+#include "roundtrip.h"
+#include "audio_bench.h"
+#include "audio_hal_sim.h"
+#include "audio_recorder.h"
+#include "ima_adpcm.h"
+#include "sd_mmc.h"
+#include "esp_log.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* TAG = "ROUNDTRIP";
+
+/** The parts of a recorded WAV file the comparison needs */
+typedef struct {
+    uint16_t format_tag;
+    uint16_t channels;
+    uint16_t block_align;
+    uint16_t samples_per_block;     /**< IMA ADPCM only */
+    uint32_t fact_frames;           /**< IMA ADPCM only */
+    uint8_t* data;                  /**< data chunk, malloc'ed */
+    uint32_t data_size;
+} roundtrip_wav_t;
+
+static uint32_t read_le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t read_le16(const uint8_t* p) { return (uint16_t)(p[0] | p[1] << 8); }
+
+// ==================== FILES ====================
+/**
+ * @brief Record one session of the round-trip source.
+ * @param format Recording format
+ * @param path File on the card
+ * @return true if the session completed
+ */
+static bool record(audio_format_t format, const char* path)
+{
+    audio_sim_config_t sim = AUDIO_SIM_DEFAULT_CONFIG();
+    sim.tone_hz = ROUNDTRIP_TONE_HZ;
+    sim.level_dbfs = ROUNDTRIP_LEVEL_DBFS;
+    sim.speed = 0.0f;               // Unpaced: as fast as the recorder takes it
+    audio_recorder_config_t rec = AUDIO_RECORDER_DEFAULT_CONFIG();
+    rec.capture_mode = CAPTURE_MODE_POLLED;
+    rec.format = format;
+    sim.frames = (uint64_t)ROUNDTRIP_SECONDS * rec.sample_rate;
+    sim.on_end = audio_recorder_stop;
+    audio_sim_configure(&sim);
+
+    if (!audio_recorder_init(&rec)) return false;
+    bool ok = audio_recorder_start(path, 1);
+    audio_recorder_deinit();
+    return ok;
+}
+
+/**
+ * @brief Load the format, fact and data chunks of a RIFF/WAVE file.
+ */
+static bool load_wav(const char* path, roundtrip_wav_t* wav)
+{
+    memset(wav, 0, sizeof(*wav));
+    FILE* f = sd_card_open(path, "rb");
+    if (!f) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return false;
+    }
+
+    uint8_t hdr[12], chunk[8], fmt[20];
+    bool ok = fread(hdr, 1, 12, f) == 12 && memcmp(hdr, "RIFF", 4) == 0 && memcmp(hdr + 8, "WAVE", 4) == 0;
+    while (ok && !wav->data && fread(chunk, 1, 8, f) == 8) {
+        uint32_t size = read_le32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            size_t n = size < sizeof(fmt) ? size : sizeof(fmt);
+            ok = fread(fmt, 1, n, f) == n;
+            wav->format_tag = read_le16(fmt);
+            wav->channels = read_le16(fmt + 2);
+            wav->block_align = read_le16(fmt + 12);
+            if (n >= 20) wav->samples_per_block = read_le16(fmt + 18);
+            fseek(f, (long)(size - n + (size & 1)), SEEK_CUR);
+        } else if (memcmp(chunk, "fact", 4) == 0 && size >= 4) {
+            uint8_t fact[4];
+            ok = fread(fact, 1, 4, f) == 4;
+            wav->fact_frames = read_le32(fact);
+            fseek(f, (long)(size - 4 + (size & 1)), SEEK_CUR);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            wav->data = malloc(size ? size : 1);
+            ok = wav->data && fread(wav->data, 1, size, f) == size;
+            wav->data_size = size;
+        } else {
+            fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+    sd_card_close(f);
+
+    ok = ok && wav->data && wav->format_tag != 0 && wav->channels > 0 && wav->block_align > 0;
+    if (!ok) ESP_LOGE(TAG, "%s is not a WAV file this check can read", path);
+    return ok;
+}
+
+// ==================== CHECKS ====================
+/**
+ * @brief Record the same tone as 16-bit PCM and as IMA ADPCM, decode the
+ * ADPCM file and check its length and SNR against the PCM file.
+ *
+ * @return true if the frame counts match and the SNR reaches AUDIO_BENCH_ADPCM_MIN_SNR
+ */
+bool roundtrip_adpcm(void)
+{
+    const char* pcm_path = "/roundtrip_pcm.wav";
+    const char* adpcm_path = "/roundtrip_adpcm.wav";
+    if (!record(AUDIO_FORMAT_WAV, pcm_path) || !record(AUDIO_FORMAT_IMA_ADPCM, adpcm_path)) {
+        ESP_LOGE(TAG, "Recording failed");
+        return false;
+    }
+
+    roundtrip_wav_t pcm = { 0 }, adpcm = { 0 };
+    bool ok = load_wav(pcm_path, &pcm) && load_wav(adpcm_path, &adpcm) && pcm.format_tag == 1 &&
+              adpcm.format_tag == 0x0011 && pcm.channels == adpcm.channels && adpcm.samples_per_block > 0;
+    int16_t* decoded = NULL;
+    uint32_t blocks = 0, pcm_frames = 0;
+    if (ok) {
+        blocks = adpcm.data_size / adpcm.block_align;
+        pcm_frames = pcm.data_size / (2 * pcm.channels);
+        decoded = malloc((size_t)blocks * adpcm.samples_per_block * adpcm.channels * sizeof(int16_t) + 1);
+        ok = decoded != NULL;
+    }
+    if (!ok) ESP_LOGE(TAG, "Cannot compare %s with %s", adpcm_path, pcm_path);
+
+    if (ok && adpcm.fact_frames != pcm_frames) {
+        ESP_LOGE(TAG, "ima_adpcm holds %lu frames, pcm %lu", (unsigned long)adpcm.fact_frames,
+                 (unsigned long)pcm_frames);
+        ok = false;
+    }
+    if (ok) {
+        for (uint32_t b = 0; b < blocks; b++) {
+            ima_adpcm_decode_block(adpcm.data + (size_t)b * adpcm.block_align,
+                                   decoded + (size_t)b * adpcm.samples_per_block * adpcm.channels,
+                                   adpcm.channels, adpcm.samples_per_block);
+        }
+
+        const int16_t* ref = (const int16_t*)pcm.data;
+        double signal = 0.0, noise = 0.0;
+        for (size_t i = 0; i < (size_t)pcm_frames * pcm.channels; i++) {
+            double e = (double)ref[i] - decoded[i];
+            signal += (double)ref[i] * ref[i];
+            noise += e * e;
+        }
+        double snr = 10.0 * log10(signal / (noise > 0.0 ? noise : 1.0));
+        ok = snr >= AUDIO_BENCH_ADPCM_MIN_SNR;
+        if (ok) ESP_LOGI(TAG, "ima_adpcm through the recorder: %lu frames, SNR %.1f dB",
+                         (unsigned long)pcm_frames, snr);
+        else ESP_LOGE(TAG, "ima_adpcm through the recorder: SNR %.1f dB, below %.0f dB",
+                      snr, AUDIO_BENCH_ADPCM_MIN_SNR);
+    }
+
+    free(decoded);
+    free(pcm.data);
+    free(adpcm.data);
+    return ok;
+}
@@ -0,0 +1,23 @@
+// roundtrip.h
+#ifndef ROUNDTRIP_H
+#define ROUNDTRIP_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define ROUNDTRIP_SECONDS 5             // Length of each recorded session
+#define ROUNDTRIP_TONE_HZ 1000.0f
+#define ROUNDTRIP_LEVEL_DBFS -6.0f
+
+// ==================== API PÚBLICA ====================
+bool roundtrip_adpcm(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ROUNDTRIP_H
@@ -0,0 +1,54 @@
+// sd_host.h
+#ifndef SD_HOST_H
+#define SD_HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sd_mmc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define SD_HOST_IMAGE "/card.img"       // Raw sectors (MBR + raw log partition), under root
+#define SD_HOST_RAW_LOG_FIRST 2048      // First sector of the raw log partition in the image
+
+/**
+ * @brief Host stand-in for the card (sd_mmc.h on a local directory).
+ *
+ * Files go to root; sector access goes to root/card.img. Every write and
+ * sync can be slowed down to model a card: a fixed cost per access, a
+ * bandwidth cost per KB and a periodic stall (a card's internal garbage
+ * collection). The injected time is inside what the write hook measures.
+ */
+typedef struct {
+    const char* root;               /**< Directory standing in for the card root */
+    uint32_t write_size;            /**< Bytes per file write (sd_file_t stage), a power of two */
+    uint32_t write_latency_us;      /**< Added to every write */
+    uint32_t write_us_per_kb;       /**< Added per KB written */
+    uint32_t sync_latency_us;       /**< Added to every sync */
+    uint32_t stall_every;           /**< Every Nth write also stalls, 0 = never */
+    uint32_t stall_us;              /**< Length of a stall */
+    uint32_t raw_log_mb;            /**< Raw log partition created in a new card.img, 0 = no image */
+} sd_host_config_t;
+
+#define SD_HOST_DEFAULT_CONFIG() {      \
+    .root = "sdcard",                   \
+    .write_size = SD_FILE_STAGE_SIZE,   \
+    .write_latency_us = 0,              \
+    .write_us_per_kb = 0,               \
+    .sync_latency_us = 0,               \
+    .stall_every = 0,                   \
+    .stall_us = 0,                      \
+    .raw_log_mb = 0,                    \
+}
+
+// ==================== API PÚBLICA ====================
+void sd_host_configure(const sd_host_config_t* config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_HOST_H
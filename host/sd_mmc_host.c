@@ -0,0 +1,329 @@
+// sd_mmc_host.c
+// sd_mmc.h for the host build: the card is a local directory, its raw
+// sectors an image file, and its timing whatever sd_host_config_t injects.
+// The host page cache stands in for the card, so nothing is fsync'ed.
+#include "sd_mmc.h"
+#include "sd_host.h"
+#include "raw_log_format.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char* TAG = "SD";
+
+static sd_host_config_t config = SD_HOST_DEFAULT_CONFIG();
+static pthread_mutex_t mount_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool mounted = false;
+static uint32_t mount_refs = 0;                 /**< Outstanding sd_card_acquire() calls */
+static int image_fd = -1;                       /**< card.img, -1 without raw log */
+static uint32_t card_writes = 0;                /**< Writes since start, for stall_every */
+static sd_write_hook_t write_hook = NULL;       /**< Told about every timed card access */
+
+/**
+ * @brief Replace the card model; call before the first sd_card_acquire().
+ */
+void sd_host_configure(const sd_host_config_t* cfg)
+{
+    config = *cfg;
+}
+
+static void full_path(char* buf, size_t size, const char* path)
+{
+    snprintf(buf, size, "%s%s", config.root, path);
+}
+
+// ==================== CARD MODEL ====================
+/**
+ * @brief Time an access and report it to the write hook.
+ * @param t0 Cycle count when the access started
+ * @param bytes Bytes written, 0 for a sync
+ * @param extra_us Latency the model adds to the access
+ */
+static void finish_access(uint32_t t0, size_t bytes, uint32_t extra_us)
+{
+    if (extra_us > 0) esp_rom_delay_us(extra_us);
+    if (write_hook) write_hook(bytes, (uint32_t)esp_cpu_get_cycle_count() - t0);
+}
+
+/**
+ * @brief Latency the model adds to a write of len bytes.
+ */
+static uint32_t write_cost_us(size_t len)
+{
+    uint32_t us = config.write_latency_us + (uint32_t)((uint64_t)len * config.write_us_per_kb / 1024);
+    card_writes++;
+    if (config.stall_every > 0 && card_writes % config.stall_every == 0) us += config.stall_us;
+    return us;
+}
+
+static bool timed_pwrite(int fd, const void* data, size_t len, uint64_t offset)
+{
+    uint32_t t0 = (uint32_t)esp_cpu_get_cycle_count();
+    ssize_t n = pwrite(fd, data, len, (off_t)offset);
+    bool ok = n == (ssize_t)len;
+    finish_access(t0, ok ? len : 0, write_cost_us(len));
+    if (!ok) ESP_LOGE(TAG, "Write of %u bytes at %llu failed: %s", (unsigned)len,
+                      (unsigned long long)offset, strerror(errno));
+    return ok;
+}
+
+static void timed_sync(void)
+{
+    uint32_t t0 = (uint32_t)esp_cpu_get_cycle_count();
+    finish_access(t0, 0, config.sync_latency_us);
+}
+
+// ==================== MOUNT ====================
+/**
+ * @brief Open card.img, creating it with an MBR holding only the raw log partition.
+ */
+static void open_image(void)
+{
+    char path[256];
+    full_path(path, sizeof(path), SD_HOST_IMAGE);
+    image_fd = open(path, O_RDWR);
+    if (image_fd >= 0) return;
+
+    image_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (image_fd < 0) {
+        ESP_LOGE(TAG, "Cannot create %s: %s", path, strerror(errno));
+        return;
+    }
+
+    uint32_t sectors = config.raw_log_mb * (1024 * 1024 / RAW_LOG_SECTOR_SIZE);
+    uint8_t mbr[RAW_LOG_SECTOR_SIZE] = { 0 };
+    uint8_t* e = mbr + 446;
+    e[4] = RAW_LOG_PARTITION_TYPE;
+    for (int i = 0; i < 4; i++) {
+        e[8 + i] = (uint8_t)(SD_HOST_RAW_LOG_FIRST >> (8 * i));
+        e[12 + i] = (uint8_t)(sectors >> (8 * i));
+    }
+    mbr[510] = 0x55;
+    mbr[511] = 0xAA;
+    if (pwrite(image_fd, mbr, sizeof(mbr), 0) != (ssize_t)sizeof(mbr) ||
+        ftruncate(image_fd, ((off_t)SD_HOST_RAW_LOG_FIRST + sectors) * RAW_LOG_SECTOR_SIZE) != 0) {
+        ESP_LOGE(TAG, "Cannot initialize %s: %s", path, strerror(errno));
+        close(image_fd);
+        image_fd = -1;
+        return;
+    }
+    ESP_LOGI(TAG, "Created %s with a %lu MB raw log partition", path, (unsigned long)config.raw_log_mb);
+}
+
+/**
+ * @brief Take a reference to the card, "mounting" the directory on first use.
+ * @return true if the card is mounted.
+ */
+bool sd_card_acquire(void)
+{
+    pthread_mutex_lock(&mount_lock);
+    if (!mounted) {
+        if (mkdir(config.root, 0755) == 0 || errno == EEXIST) {
+            if (config.raw_log_mb > 0) open_image();
+            mounted = true;
+            ESP_LOGI(TAG, "Card mounted at %s (write size %lu)", config.root, (unsigned long)config.write_size);
+        } else {
+            ESP_LOGE(TAG, "Cannot use %s as the card: %s", config.root, strerror(errno));
+        }
+    }
+    mount_refs++;
+    bool ok = mounted;
+    pthread_mutex_unlock(&mount_lock);
+    return ok;
+}
+
+/**
+ * @brief Drop a reference taken with sd_card_acquire().
+ */
+void sd_card_release(void)
+{
+    pthread_mutex_lock(&mount_lock);
+    if (mount_refs > 0) mount_refs--;
+    else ESP_LOGW(TAG, "sd_card_release() without sd_card_acquire()");
+    pthread_mutex_unlock(&mount_lock);
+}
+
+/**
+ * @brief Unmount the card now.
+ */
+void sd_card_unmount(void)
+{
+    pthread_mutex_lock(&mount_lock);
+    if (mount_refs > 0) ESP_LOGW(TAG, "Unmounting with %u reference(s) held", (unsigned)mount_refs);
+    if (image_fd >= 0) close(image_fd);
+    image_fd = -1;
+    mounted = false;
+    pthread_mutex_unlock(&mount_lock);
+}
+
+/**
+ * @brief Formatting needs the SD driver; the directory is left as it is.
+ *
+ * The request is still consumed, as on the card.
+ */
+bool sd_card_prepare(void)
+{
+    sd_card_remove(SD_PREPARE_FILE);
+    ESP_LOGE(TAG, "Card preparation is not available in the host build");
+    return false;
+}
+
+// ==================== FILES ====================
+bool sd_card_exists(const char* path)
+{
+    char p[256];
+    full_path(p, sizeof(p), path);
+    return access(p, F_OK) == 0;
+}
+
+FILE* sd_card_open(const char* path, const char* mode)
+{
+    char p[256];
+    full_path(p, sizeof(p), path);
+    return fopen(p, mode);
+}
+
+void sd_card_close(FILE* file)
+{
+    if (file) { fclose(file); }
+}
+
+bool sd_card_remove(const char* path)
+{
+    char p[256];
+    full_path(p, sizeof(p), path);
+    return remove(p) == 0;
+}
+
+// ==================== SECTORS ====================
+bool sd_card_read_sectors(void* dst, uint32_t sector, uint32_t count)
+{
+    if (image_fd < 0) return false;
+    size_t len = (size_t)count * RAW_LOG_SECTOR_SIZE;
+    ssize_t n = pread(image_fd, dst, len, (off_t)sector * RAW_LOG_SECTOR_SIZE);
+    if (n < 0) {
+        ESP_LOGE(TAG, "Read of %lu sectors at %lu failed: %s", (unsigned long)count, (unsigned long)sector,
+                 strerror(errno));
+        return false;
+    }
+    memset((uint8_t*)dst + n, 0, len - (size_t)n);     // Past the end of the image reads as erased
+    return true;
+}
+
+bool sd_card_write_sectors(const void* src, uint32_t sector, uint32_t count)
+{
+    if (image_fd < 0) return false;
+    return timed_pwrite(image_fd, src, (size_t)count * RAW_LOG_SECTOR_SIZE, (uint64_t)sector * RAW_LOG_SECTOR_SIZE);
+}
+
+void sd_card_set_write_hook(sd_write_hook_t hook)
+{
+    write_hook = hook;
+}
+
+// ==================== DIRECT FILES ====================
+/**
+ * @brief Same staging as the device (sd_mmc.c): whole write_size blocks at
+ * multiples of write_size, so the access pattern the model sees matches.
+ */
+struct sd_file {
+    int fd;
+    uint8_t* stage;             /**< stage_size bytes */
+    size_t stage_size;          /**< Bytes per write */
+    uint64_t stage_pos;         /**< File offset of stage[0] */
+    size_t fill;                /**< Bytes staged */
+};
+
+sd_file_t* sd_file_create(const char* path, uint64_t prealloc)
+{
+    char p[256];
+    full_path(p, sizeof(p), path);
+
+    sd_file_t* file = calloc(1, sizeof(sd_file_t));
+    if (!file) return NULL;
+    file->stage_size = config.write_size;
+    file->stage = heap_caps_malloc(file->stage_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    file->fd = file->stage ? open(p, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    if (file->fd < 0) {
+        ESP_LOGE(TAG, "Cannot create %s (%s)", path, strerror(errno));
+        heap_caps_free(file->stage);
+        free(file);
+        return NULL;
+    }
+
+    if (prealloc > 0) {
+        int err = posix_fallocate(file->fd, 0, (off_t)prealloc);
+        if (err != 0) ESP_LOGW(TAG, "Cannot preallocate %llu bytes for %s (%s)",
+                               (unsigned long long)prealloc, path, strerror(err));
+    }
+    return file;
+}
+
+static bool sd_file_flush(sd_file_t* file, bool advance)
+{
+    if (!timed_pwrite(file->fd, file->stage, file->fill, file->stage_pos)) return false;
+    if (advance) {
+        file->stage_pos += file->fill;
+        file->fill = 0;
+    }
+    return true;
+}
+
+size_t sd_file_write(sd_file_t* file, const void* data, size_t len)
+{
+    const uint8_t* in = (const uint8_t*)data;
+    size_t done = 0;
+    while (done < len) {
+        size_t n = file->stage_size - file->fill;
+        if (n > len - done) n = len - done;
+        memcpy(file->stage + file->fill, in + done, n);
+        file->fill += n;
+        done += n;
+        if (file->fill == file->stage_size && !sd_file_flush(file, true)) {
+            file->fill -= n;
+            return done - n;
+        }
+    }
+    return done;
+}
+
+bool sd_file_patch(sd_file_t* file, uint64_t offset, const void* data, size_t len)
+{
+    if (offset + len > file->stage_pos + file->fill) return false;
+
+    const uint8_t* in = (const uint8_t*)data;
+    if (offset < file->stage_pos) {
+        size_t n = (offset + len > file->stage_pos) ? (size_t)(file->stage_pos - offset) : len;
+        if (!timed_pwrite(file->fd, in, n, offset)) return false;
+        in += n;
+        offset += n;
+        len -= n;
+    }
+    memcpy(file->stage + (offset - file->stage_pos), in, len);
+    return true;
+}
+
+bool sd_file_sync(sd_file_t* file)
+{
+    if (file->fill > 0 && !sd_file_flush(file, false)) return false;
+    timed_sync();
+    return true;
+}
+
+bool sd_file_close(sd_file_t* file)
+{
+    bool ok = (file->fill == 0) || sd_file_flush(file, true);
+    ok = (ftruncate(file->fd, (off_t)file->stage_pos) == 0) && ok;     // Drop unused preallocation
+    ok = (close(file->fd) == 0) && ok;
+    heap_caps_free(file->stage);
+    free(file);
+    return ok;
+}
@@ -0,0 +1,400 @@
+// audio_bench.c
+#include "audio_bench.h"
+#include "audio_kernels.h"
+#include "ima_adpcm.h"
+#include "audio_resampler.h"
+#include "audio_biquad.h"
+#include "audio_spectrum.h"
+#include "audio_meter.h"
+#include "esp_log.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "esp_cpu.h"
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+static const char* TAG = "AUDIO_BENCH";
+
+#define BENCH_FRAMES 1024   // One capture block (2 DMA buffers)
+#define BENCH_REPEAT 64
+#define BENCH_ADPCM_ALIGN 1024      // Mono block at 44.1 kHz: 2041 frames
+#define BENCH_BIQUAD_MAX_ERR 4.0    // Fixed-point 3-section cascade vs double precision, in LSB
+#if AUDIO_KERNELS_PIE
+#define BENCH_EXTRACT_MAX_CYCLES 2.0    // PIE extract_left: 4 instructions per 8 samples, well under the word-wise loop
+#else
+#define BENCH_EXTRACT_MAX_CYCLES 6.0    // Word-wise extract_left
+#endif
+
+static int16_t bench_in[2 * BENCH_FRAMES] __attribute__((aligned(16)));
+static int16_t bench_out[BENCH_FRAMES] __attribute__((aligned(16)));
+static int16_t bench_ref[BENCH_FRAMES] __attribute__((aligned(16)));
+static int16_t bench_pcm[2 * BENCH_FRAMES];
+static uint8_t bench_adpcm[BENCH_ADPCM_ALIGN];
+static audio_biquad_t bench_bq;
+static audio_biquad_t bench_bq_ref;
+static double bench_last;   /**< Cycles/sample of the last BENCH run */
+
+/**
+ * @brief Read the cycle counter (TSC on x86 hosts, nanoseconds elsewhere off-target).
+ */
+static inline uint32_t bench_cycles(void)
+{
+#if defined(ESP_PLATFORM)
+    return (uint32_t)esp_cpu_get_cycle_count();
+#elif defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+/**
+ * @brief Report the best-of-BENCH_REPEAT cost of a kernel in cycles per output sample.
+ * @param name Kernel name for the log
+ * @param cycles Best run, in cycles
+ * @param samples Output samples per run
+ */
+static void bench_report(const char* name, uint32_t cycles, uint32_t samples)
+{
+    bench_last = (double)cycles / samples;
+    ESP_LOGI(TAG, "%-22s %6.2f cycles/sample", name, bench_last);
+}
+
+#define BENCH_N(name, samples, call)                        \
+    do {                                                    \
+        uint32_t best = UINT32_MAX;                         \
+        for (int r = 0; r < BENCH_REPEAT; r++) {            \
+            uint32_t t0 = bench_cycles();                   \
+            call;                                           \
+            uint32_t dt = bench_cycles() - t0;              \
+            if (dt < best) best = dt;                       \
+        }                                                   \
+        bench_report(name, best, samples);                  \
+    } while (0)
+
+#define BENCH(name, call) BENCH_N(name, BENCH_FRAMES, call)
+
+/** A dispatched capture kernel and its portable version */
+typedef struct {
+    const char* name;
+    void (*fast)(int16_t* dst, const int16_t* src, size_t n);
+    void (*generic)(int16_t* dst, const int16_t* src, size_t n);
+    size_t lane;        /**< Output i is 16-bit input sample 2 * i + lane */
+    size_t src_align;   /**< Input offsets must be a multiple of this, in 16-bit samples */
+} bench_kernel_t;
+
+static void bench_narrow(int16_t* dst, const int16_t* src, size_t n)
+{
+    audio_narrow_s32_s16(dst, (const int32_t*)src, n);
+}
+
+static void bench_narrow_generic(int16_t* dst, const int16_t* src, size_t n)
+{
+    audio_narrow_s32_s16_generic(dst, (const int32_t*)src, n);
+}
+
+/**
+ * @brief Check the dispatched capture kernels against their portable versions.
+ *
+ * Every kernel runs on 16-byte aligned and misaligned buffers and on
+ * lengths that are not a multiple of the PIE step (8), so the SIMD bulk,
+ * its generic tail and the unaligned fallbacks are all compared. Both
+ * outputs must hold exactly the expected input lanes and leave the
+ * samples around them untouched.
+ *
+ * @return true if every output matches
+ */
+static bool bench_kernels_exact(void)
+{
+    static const bench_kernel_t kernels[] = {
+        { "extract_left",  audio_extract_left_s16,  audio_extract_left_s16_generic,  0, 1 },
+        { "extract_right", audio_extract_right_s16, audio_extract_right_s16_generic, 1, 1 },
+        { "narrow_s32",    bench_narrow,            bench_narrow_generic,            1, 2 },
+    };
+    static const size_t src_offsets[] = { 0, 1, 2, 8 };     // Aligned, odd sample, odd word, next 16 bytes
+    static const size_t dst_offsets[] = { 0, 1, 8 };
+    static const size_t lengths[] = { 0, 1, 7, 8, 13, BENCH_FRAMES - 16, BENCH_FRAMES - 9 };
+    const int16_t canary = 0x5A5A;
+
+    for (int i = 0; i < 2 * BENCH_FRAMES; i++) bench_in[i] = (int16_t)rand();
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        for (size_t s = 0; s < sizeof(src_offsets) / sizeof(src_offsets[0]); s++) {
+            if (src_offsets[s] % kernels[k].src_align) continue;
+            const int16_t* src = bench_in + src_offsets[s];
+            for (size_t d = 0; d < sizeof(dst_offsets) / sizeof(dst_offsets[0]); d++) {
+                for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+                    size_t first = dst_offsets[d], n = lengths[l];
+                    memset(bench_out, 0x5A, sizeof(bench_out));
+                    memset(bench_ref, 0x5A, sizeof(bench_ref));
+                    kernels[k].fast(bench_out + first, src, n);
+                    kernels[k].generic(bench_ref + first, src, n);
+
+                    for (size_t i = 0; i < BENCH_FRAMES; i++) {
+                        int16_t want = i >= first && i < first + n ? src[2 * (i - first) + kernels[k].lane] : canary;
+                        if (bench_out[i] != want || bench_ref[i] != want) {
+                            ESP_LOGE(TAG, "%s mismatch (src +%u, dst +%u, %u samples) at %u: %d, generic %d, expected %d",
+                                     kernels[k].name, (unsigned)src_offsets[s], (unsigned)first, (unsigned)n,
+                                     (unsigned)i, bench_out[i], bench_ref[i], want);
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    ESP_LOGI(TAG, "Capture kernels match their generic versions");
+    return true;
+}
+
+/**
+ * @brief Encode and decode a tone through IMA ADPCM and check the SNR.
+ *
+ * The second block is measured so the quantizer has adapted, as it has
+ * in a running recording.
+ *
+ * @return true if the round trip reaches AUDIO_BENCH_ADPCM_MIN_SNR
+ */
+static bool bench_adpcm_roundtrip(uint32_t spb)
+{
+    int8_t index = 0;
+    double signal = 0.0, noise = 0.0;
+
+    for (int block = 0; block < 2; block++) {
+        for (uint32_t i = 0; i < spb; i++) {
+            uint32_t n = block * spb + i;
+            bench_in[i] = (int16_t)(16384.0f * sinf(2.0f * (float)M_PI * 1000.0f * n / 44100.0f) + (rand() % 64 - 32));
+        }
+        ima_adpcm_encode_block(bench_in, bench_adpcm, 1, spb, &index);
+        ima_adpcm_decode_block(bench_adpcm, bench_pcm, 1, spb);
+    }
+
+    for (uint32_t i = 0; i < spb; i++) {
+        double e = (double)bench_in[i] - bench_pcm[i];
+        signal += (double)bench_in[i] * bench_in[i];
+        noise += e * e;
+    }
+
+    double snr = 10.0 * log10(signal / (noise > 0.0 ? noise : 1.0));
+    bool ok = snr >= AUDIO_BENCH_ADPCM_MIN_SNR;
+    if (ok) ESP_LOGI(TAG, "ima_adpcm round trip: SNR %.1f dB", snr);
+    else ESP_LOGE(TAG, "ima_adpcm round trip: SNR %.1f dB, below %.0f dB", snr, AUDIO_BENCH_ADPCM_MIN_SNR);
+    return ok;
+}
+
+/**
+ * @brief Run a stereo cascade through the block kernel and the reference and compare.
+ *
+ * The input has DC, a low tone and noise near full scale, and is fed in
+ * uneven pieces so block boundaries and state hand-over are exercised.
+ *
+ * @return true if both outputs are identical
+ */
+static bool bench_biquad_exact(const audio_biquad_coeffs_t* coeffs, uint8_t sections)
+{
+    audio_biquad_init(&bench_bq, coeffs, sections, 2);
+    audio_biquad_init(&bench_bq_ref, coeffs, sections, 2);
+
+    for (int pass = 0; pass < 8; pass++) {
+        for (int i = 0; i < 2 * BENCH_FRAMES; i++) {
+            float tone = 20000.0f * sinf(2.0f * (float)M_PI * 50.0f * (pass * BENCH_FRAMES + i / 2) / 44100.0f);
+            bench_in[i] = (int16_t)(tone + 4000 + (rand() % 16384 - 8192));
+        }
+
+        for (int done = 0; done < BENCH_FRAMES;) {
+            int n = 1 + rand() % 700;
+            if (n > BENCH_FRAMES - done) n = BENCH_FRAMES - done;
+            audio_biquad_process_s16(&bench_bq, bench_in + 2 * done, bench_pcm + 2 * done, n);
+            done += n;
+        }
+        audio_biquad_process_s16_ref(&bench_bq_ref, bench_in, bench_in, BENCH_FRAMES);
+
+        for (int i = 0; i < 2 * BENCH_FRAMES; i++) {
+            if (bench_pcm[i] != bench_in[i]) {
+                ESP_LOGE(TAG, "biquad mismatch at pass %d sample %d: %d vs %d", pass, i, bench_pcm[i], bench_in[i]);
+                return false;
+            }
+        }
+    }
+    ESP_LOGI(TAG, "biquad block kernel matches the reference");
+    return true;
+}
+
+/** Analog prototype of a reference section (Butterworth-style, Q given) */
+typedef struct {
+    bool highpass;
+    double fc;
+    double q;
+} bench_section_t;
+
+/**
+ * @brief Check the fixed-point cascade against a double-precision one designed independently.
+ *
+ * The reference sections come from the analog prototypes
+ * s^2 / (s^2 + s wc/Q + wc^2) and wc^2 / (s^2 + s wc/Q + wc^2) through the
+ * bilinear transform with the corner pre-warped, and run in transposed
+ * direct form II in double. The fixed-point output may only differ by
+ * coefficient quantization and the truncation noise of each section
+ * (about 1 LSB each); a filter that is wrong misses by far more.
+ *
+ * @return true if no output sample is further than BENCH_BIQUAD_MAX_ERR from the reference
+ */
+static bool bench_biquad_accuracy(const audio_biquad_coeffs_t* coeffs, const bench_section_t* proto,
+                                  uint8_t sections, uint32_t sample_rate)
+{
+    double b[AUDIO_BIQUAD_MAX_SECTIONS][3], a[AUDIO_BIQUAD_MAX_SECTIONS][2];
+    double z[AUDIO_BIQUAD_MAX_SECTIONS][2] = { { 0 } };
+    for (uint8_t s = 0; s < sections; s++) {
+        double k = tan(M_PI * proto[s].fc / sample_rate);     // Pre-warped corner, bilinear constant 1
+        double a0 = 1.0 + k / proto[s].q + k * k;
+        double g = proto[s].highpass ? 1.0 / a0 : k * k / a0;
+        b[s][0] = g;
+        b[s][1] = proto[s].highpass ? -2.0 * g : 2.0 * g;
+        b[s][2] = g;
+        a[s][0] = (2.0 * k * k - 2.0) / a0;
+        a[s][1] = (1.0 - k / proto[s].q + k * k) / a0;
+    }
+
+    audio_biquad_init(&bench_bq, coeffs, sections, 1);
+    double max_err = 0.0;
+    for (int pass = 0; pass < 8; pass++) {
+        // DC, a low tone and noise, kept below full scale so neither side clips
+        for (int i = 0; i < BENCH_FRAMES; i++) {
+            float tone = 12000.0f * sinf(2.0f * (float)M_PI * 50.0f * (pass * BENCH_FRAMES + i) / sample_rate);
+            bench_in[i] = (int16_t)(tone + 2000 + (rand() % 8192 - 4096));
+        }
+        audio_biquad_process_s16(&bench_bq, bench_in, bench_pcm, BENCH_FRAMES);
+
+        for (int i = 0; i < BENCH_FRAMES; i++) {
+            double v = bench_in[i];
+            for (uint8_t s = 0; s < sections; s++) {
+                double y = b[s][0] * v + z[s][0];
+                z[s][0] = b[s][1] * v - a[s][0] * y + z[s][1];
+                z[s][1] = b[s][2] * v - a[s][1] * y;
+                v = y;
+            }
+            double e = fabs(bench_pcm[i] - v);
+            if (e > max_err) max_err = e;
+        }
+    }
+
+    bool ok = max_err <= BENCH_BIQUAD_MAX_ERR;
+    if (ok) ESP_LOGI(TAG, "biquad vs double reference: max error %.2f LSB", max_err);
+    else ESP_LOGE(TAG, "biquad vs double reference: max error %.2f LSB, above %.1f", max_err, BENCH_BIQUAD_MAX_ERR);
+    return ok;
+}
+
+/**
+ * @brief Analyze one block as the writer does, summarizing records as they complete.
+ */
+static void bench_spectrum(audio_spectrum_t* sp)
+{
+    audio_spectrum_record_t rec;
+    size_t done = 0;
+    while (done < BENCH_FRAMES) {
+        done += audio_spectrum_feed(sp, (const uint8_t*)(bench_in + done), BENCH_FRAMES - done);
+        if (audio_spectrum_record_ready(sp)) audio_spectrum_take(sp, &rec);
+    }
+}
+
+/**
+ * @brief Meter one stereo block as the writer does, closing intervals as they complete.
+ */
+static void bench_meter(audio_meter_t* meter)
+{
+    audio_meter_interval_t iv;
+    size_t done = 0;
+    while (done < BENCH_FRAMES) {
+        done += audio_meter_feed(meter, (const uint8_t*)(bench_in + 2 * done), BENCH_FRAMES - done);
+        if (audio_meter_interval_ready(meter)) audio_meter_take(meter, &iv);
+    }
+}
+
+/**
+ * @brief Benchmark the capture hot-path and codec kernels and log cycles/sample.
+ *
+ * Uses aligned buffers so the PIE paths are taken where available, and
+ * the best of several runs to hide cache warm-up and interrupts.
+ *
+ * @return false if a correctness check (capture kernels, ADPCM round trip,
+ *         biquad) failed or extract_left is slower than BENCH_EXTRACT_MAX_CYCLES
+ */
+bool audio_bench_run(void)
+{
+    bool ok = bench_kernels_exact();
+    for (int i = 0; i < 2 * BENCH_FRAMES; i++) bench_in[i] = (int16_t)rand();
+
+    ESP_LOGI(TAG, "Capture kernels, %d frames per call (PIE %s)", BENCH_FRAMES,
+             AUDIO_KERNELS_PIE ? "on" : "off");
+
+    // The polled hot path: its cost is held to a ceiling, not just logged
+    BENCH("extract_left",         audio_extract_left_s16(bench_out, bench_in, BENCH_FRAMES));
+    if (bench_last > BENCH_EXTRACT_MAX_CYCLES) {
+        ESP_LOGE(TAG, "extract_left takes %.2f cycles/sample, above %.1f", bench_last, BENCH_EXTRACT_MAX_CYCLES);
+        ok = false;
+    }
+    BENCH("extract_left_generic", audio_extract_left_s16_generic(bench_out, bench_in, BENCH_FRAMES));
+    BENCH("extract_right",        audio_extract_right_s16(bench_out, bench_in, BENCH_FRAMES));
+    BENCH("mixdown",              audio_mixdown_s16(bench_out, bench_in, BENCH_FRAMES));
+    BENCH("narrow_s32",           audio_narrow_s32_s16(bench_out, (const int32_t*)bench_in, BENCH_FRAMES));
+    BENCH("narrow_s32_generic",   audio_narrow_s32_s16_generic(bench_out, (const int32_t*)bench_in, BENCH_FRAMES));
+
+    uint32_t spb = ima_adpcm_samples_per_block(BENCH_ADPCM_ALIGN, 1);
+    int8_t index = 0;
+    ok = bench_adpcm_roundtrip(spb) && ok;
+    BENCH_N("ima_adpcm_encode", spb, ima_adpcm_encode_block(bench_in, bench_adpcm, 1, spb, &index));
+    BENCH_N("ima_adpcm_decode", spb, ima_adpcm_decode_block(bench_adpcm, bench_pcm, 1, spb));
+
+    // Cost per captured (input) sample: the figure that must fit the real-time budget
+    static const uint32_t rates[] = { 22050, 16000, 8000 };
+    static const char* names[] = { "decimate_44k_22k", "decimate_44k_16k", "decimate_44k_8k" };
+    for (int i = 0; i < 3; i++) {
+        audio_resampler_t rs;
+        if (!audio_resampler_init(&rs, 44100, rates[i], 1)) continue;
+        BENCH(names[i], audio_resampler_process(&rs, bench_in, BENCH_FRAMES, bench_out));
+        audio_resampler_free(&rs);
+    }
+
+    // DC blocker + rumble high-pass + band limit, as a typical field configuration
+    static const bench_section_t proto[3] = {
+        { true, 10.0, 0.7071 }, { true, 100.0, 0.7071 }, { false, 15000.0, 0.7071 },
+    };
+    audio_biquad_coeffs_t bq[3];
+    for (int i = 0; i < 3; i++) {
+        if (proto[i].highpass) audio_biquad_highpass(&bq[i], 44100, (float)proto[i].fc, (float)proto[i].q);
+        else audio_biquad_lowpass(&bq[i], 44100, (float)proto[i].fc, (float)proto[i].q);
+    }
+    ok = bench_biquad_exact(bq, 3) && ok;
+    ok = bench_biquad_accuracy(bq, proto, 3, 44100) && ok;
+    for (int i = 0; i < 2 * BENCH_FRAMES; i++) bench_in[i] = (int16_t)rand();
+    audio_biquad_init(&bench_bq, bq, 3, 1);
+    BENCH("biquad_x3",     audio_biquad_process_s16(&bench_bq, bench_in, bench_out, BENCH_FRAMES));
+    BENCH("biquad_x3_ref", audio_biquad_process_s16_ref(&bench_bq, bench_in, bench_out, BENCH_FRAMES));
+
+    // Spectral sidecar: FFT plus per-bin statistics, per analyzed sample
+    static audio_spectrum_t sp;
+    const wav_format_t mono = { .sample_rate = 44100, .channels = 1, .bits_per_sample = 16 };
+    if (audio_spectrum_init(&sp, &mono)) {
+        BENCH("spectrum", bench_spectrum(&sp));
+        audio_spectrum_free(&sp);
+    }
+
+    // Level meter: peak/clips on both channels, Z and A-weighted level on the first
+    static audio_meter_t meter;
+    const wav_format_t stereo = { .sample_rate = 44100, .channels = 2, .bits_per_sample = 16 };
+    audio_meter_init(&meter, &stereo, 1);
+    BENCH("meter_stereo", bench_meter(&meter));
+
+    if (!ok) ESP_LOGE(TAG, "Correctness checks failed");
+    return ok;
+}
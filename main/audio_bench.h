@@ -0,0 +1,20 @@
+#ifndef AUDIO_BENCH_H
+#define AUDIO_BENCH_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define AUDIO_BENCH_ADPCM_MIN_SNR 30.0  // Round-trip floor for a -6 dBFS tone, in dB
+
+// ==================== API PÚBLICA ====================
+bool audio_bench_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_BENCH_H
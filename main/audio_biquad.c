@@ -0,0 +1,178 @@
+// audio_biquad.c
+#include "audio_biquad.h"
+#include <math.h>
+#include <string.h>
+
+#define SAT16(v) ((v) > 32767 ? 32767 : ((v) < -32768 ? -32768 : (v)))
+
+// ==================== DESIGN ====================
+/**
+ * @brief Quantize normalized float coefficients (a0 = 1) to Q30.
+ */
+static void store_q30(audio_biquad_coeffs_t* c, double b0, double b1, double b2, double a1, double a2)
+{
+    const double one = (double)(1 << AUDIO_BIQUAD_Q);
+    c->b0 = (int32_t)lround(b0 * one);
+    c->b1 = (int32_t)lround(b1 * one);
+    c->b2 = (int32_t)lround(b2 * one);
+    c->a1 = (int32_t)lround(a1 * one);
+    c->a2 = (int32_t)lround(a2 * one);
+}
+
+/**
+ * @brief Second-order high-pass (bilinear transform, RBJ cookbook).
+ * @param c Output coefficients
+ * @param sample_rate Sample rate in Hz
+ * @param fc Corner frequency in Hz
+ * @param q Quality factor (0.7071 = Butterworth)
+ */
+void audio_biquad_highpass(audio_biquad_coeffs_t* c, uint32_t sample_rate, float fc, float q)
+{
+    double w0 = 2.0 * M_PI * fc / sample_rate;
+    double alpha = sin(w0) / (2.0 * q);
+    double cw = cos(w0);
+    double a0 = 1.0 + alpha;
+    store_q30(c, (1.0 + cw) / 2.0 / a0, -(1.0 + cw) / a0, (1.0 + cw) / 2.0 / a0,
+              -2.0 * cw / a0, (1.0 - alpha) / a0);
+}
+
+/**
+ * @brief Second-order low-pass (bilinear transform, RBJ cookbook).
+ * @param c Output coefficients
+ * @param sample_rate Sample rate in Hz
+ * @param fc Corner frequency in Hz
+ * @param q Quality factor (0.7071 = Butterworth)
+ */
+void audio_biquad_lowpass(audio_biquad_coeffs_t* c, uint32_t sample_rate, float fc, float q)
+{
+    double w0 = 2.0 * M_PI * fc / sample_rate;
+    double alpha = sin(w0) / (2.0 * q);
+    double cw = cos(w0);
+    double a0 = 1.0 + alpha;
+    store_q30(c, (1.0 - cw) / 2.0 / a0, (1.0 - cw) / a0, (1.0 - cw) / 2.0 / a0,
+              -2.0 * cw / a0, (1.0 - alpha) / a0);
+}
+
+// ==================== CASCADE ====================
+/**
+ * @brief Set up a cascade.
+ * @param bq Cascade
+ * @param coeffs Section coefficients, applied in order
+ * @param sections Number of sections (clamped to AUDIO_BIQUAD_MAX_SECTIONS)
+ * @param channels Interleaved channels (clamped to AUDIO_BIQUAD_MAX_CHANNELS)
+ */
+void audio_biquad_init(audio_biquad_t* bq, const audio_biquad_coeffs_t* coeffs, uint8_t sections, uint16_t channels)
+{
+    if (sections > AUDIO_BIQUAD_MAX_SECTIONS) sections = AUDIO_BIQUAD_MAX_SECTIONS;
+    if (channels > AUDIO_BIQUAD_MAX_CHANNELS) channels = AUDIO_BIQUAD_MAX_CHANNELS;
+
+    bq->sections = sections;
+    bq->channels = channels;
+    memcpy(bq->coeffs, coeffs, sections * sizeof(*coeffs));
+    for (uint8_t s = 0; s < sections; s++) {
+        const int64_t half = 1 << (AUDIO_BIQUAD_Q - 1);
+        bq->shape[s][0] = (int8_t)(((int64_t)coeffs[s].a1 + half) >> AUDIO_BIQUAD_Q);
+        bq->shape[s][1] = (int8_t)(((int64_t)coeffs[s].a2 + half) >> AUDIO_BIQUAD_Q);
+    }
+    audio_biquad_reset(bq);
+}
+
+/**
+ * @brief Clear the filter history.
+ */
+void audio_biquad_reset(audio_biquad_t* bq)
+{
+    memset(bq->state, 0, sizeof(bq->state));
+}
+
+/**
+ * @brief One DF1 step; the reference for the block kernel.
+ */
+static inline int32_t section_step(const audio_biquad_coeffs_t* c, const int8_t* shape,
+                                   audio_biquad_state_t* s, int32_t x)
+{
+    int64_t acc = (int64_t)c->b0 * x + (int64_t)c->b1 * s->x1 + (int64_t)c->b2 * s->x2
+                - (int64_t)c->a1 * s->y1 - (int64_t)c->a2 * s->y2
+                - (int64_t)shape[0] * s->e1 - (int64_t)shape[1] * s->e2;
+    int32_t y = (int32_t)(acc >> AUDIO_BIQUAD_Q);
+    s->e2 = s->e1;
+    s->e1 = (int32_t)(acc - ((int64_t)y << AUDIO_BIQUAD_Q));
+    s->x2 = s->x1;
+    s->x1 = x;
+    s->y2 = s->y1;
+    s->y1 = y;
+    return y;
+}
+
+/**
+ * @brief Run one section over a channel block, state held in locals.
+ */
+static void section_run(const audio_biquad_coeffs_t* c, const int8_t* shape,
+                        audio_biquad_state_t* s, int32_t* x, size_t n)
+{
+    const int64_t b0 = c->b0, b1 = c->b1, b2 = c->b2, a1 = c->a1, a2 = c->a2;
+    const int64_t k1 = shape[0], k2 = shape[1];
+    int32_t x1 = s->x1, x2 = s->x2, y1 = s->y1, y2 = s->y2;
+    int64_t e1 = s->e1, e2 = s->e2;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t in = x[i];
+        int64_t acc = b0 * in + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2 - k1 * e1 - k2 * e2;
+        int32_t y = (int32_t)(acc >> AUDIO_BIQUAD_Q);
+        e2 = e1;
+        e1 = acc - ((int64_t)y << AUDIO_BIQUAD_Q);
+        x2 = x1; x1 = in;
+        y2 = y1; y1 = y;
+        x[i] = y;
+    }
+
+    s->x1 = x1; s->x2 = x2; s->y1 = y1; s->y2 = y2;
+    s->e1 = (int32_t)e1; s->e2 = (int32_t)e2;
+}
+
+/**
+ * @brief Filter interleaved 16-bit frames through the cascade.
+ *
+ * Section-major over blocks of one channel, so each section's state and
+ * coefficients stay in registers. The recursion has no parallelism across
+ * samples, so there is no PIE variant.
+ *
+ * @param bq Cascade
+ * @param in Input frames
+ * @param out Output frames (may equal in)
+ * @param frames Number of frames
+ */
+void audio_biquad_process_s16(audio_biquad_t* bq, const int16_t* in, int16_t* out, size_t frames)
+{
+    const uint16_t ch = bq->channels;
+
+    for (size_t done = 0; done < frames; done += AUDIO_BIQUAD_BLOCK) {
+        size_t n = frames - done;
+        if (n > AUDIO_BIQUAD_BLOCK) n = AUDIO_BIQUAD_BLOCK;
+
+        for (uint16_t c = 0; c < ch; c++) {
+            const int16_t* src = in + done * ch + c;
+            int16_t* dst = out + done * ch + c;
+
+            for (size_t i = 0; i < n; i++) bq->work[i] = src[i * ch];
+            for (uint8_t s = 0; s < bq->sections; s++) {
+                section_run(&bq->coeffs[s], bq->shape[s], &bq->state[c][s], bq->work, n);
+            }
+            for (size_t i = 0; i < n; i++) dst[i * ch] = (int16_t)SAT16(bq->work[i]);
+        }
+    }
+}
+
+/**
+ * @brief Sample-by-sample reference of audio_biquad_process_s16(), for bit-exact checks.
+ */
+void audio_biquad_process_s16_ref(audio_biquad_t* bq, const int16_t* in, int16_t* out, size_t frames)
+{
+    const uint16_t ch = bq->channels;
+
+    for (size_t i = 0; i < frames * ch; i++) {
+        int32_t v = in[i];
+        for (uint8_t s = 0; s < bq->sections; s++) v = section_step(&bq->coeffs[s], bq->shape[s], &bq->state[i % ch][s], v);
+        out[i] = (int16_t)SAT16(v);
+    }
+}
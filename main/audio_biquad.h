@@ -0,0 +1,61 @@
+#ifndef AUDIO_BIQUAD_H
+#define AUDIO_BIQUAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define AUDIO_BIQUAD_MAX_SECTIONS 4
+#define AUDIO_BIQUAD_MAX_CHANNELS 2
+#define AUDIO_BIQUAD_BLOCK 256              /**< Frames per internal pass */
+#define AUDIO_BIQUAD_Q 30                   /**< Coefficient fraction bits */
+
+/** Section coefficients in Q30: y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2 */
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;
+} audio_biquad_coeffs_t;
+
+/** Direct form I state of one section on one channel */
+typedef struct {
+    int32_t x1, x2, y1, y2;
+    int32_t e1, e2;     /**< Truncated accumulator fractions of the last two outputs, fed back */
+} audio_biquad_state_t;
+
+/**
+ * @brief Cascade of fixed-point biquads over interleaved 16-bit audio.
+ *
+ * Q30 coefficients cover |a1| < 2, which low-frequency high-passes (DC
+ * removal, rumble) need; products accumulate in 64 bits. The truncation
+ * error is fed back through a1 and a2 rounded to integers, so the error
+ * reaches the output nearly white instead of amplified by poles close to
+ * z = 1 (a 10 Hz high-pass at 44.1 kHz would otherwise add a wandering
+ * offset of a hundred LSB). Intermediate results stay 32-bit between
+ * sections; only the cascade output is saturated to 16 bits.
+ */
+typedef struct {
+    uint8_t sections;
+    uint16_t channels;
+    audio_biquad_coeffs_t coeffs[AUDIO_BIQUAD_MAX_SECTIONS];
+    int8_t shape[AUDIO_BIQUAD_MAX_SECTIONS][2];     /**< a1, a2 rounded to integers (error feedback) */
+    audio_biquad_state_t state[AUDIO_BIQUAD_MAX_CHANNELS][AUDIO_BIQUAD_MAX_SECTIONS];
+    int32_t work[AUDIO_BIQUAD_BLOCK];       /**< One channel of the current pass */
+} audio_biquad_t;
+
+// ==================== API PÚBLICA ====================
+void audio_biquad_highpass(audio_biquad_coeffs_t* c, uint32_t sample_rate, float fc, float q);
+void audio_biquad_lowpass(audio_biquad_coeffs_t* c, uint32_t sample_rate, float fc, float q);
+
+void audio_biquad_init(audio_biquad_t* bq, const audio_biquad_coeffs_t* coeffs, uint8_t sections, uint16_t channels);
+void audio_biquad_reset(audio_biquad_t* bq);
+void audio_biquad_process_s16(audio_biquad_t* bq, const int16_t* in, int16_t* out, size_t frames);
+void audio_biquad_process_s16_ref(audio_biquad_t* bq, const int16_t* in, int16_t* out, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_BIQUAD_H
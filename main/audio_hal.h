@@ -0,0 +1,50 @@
+// audio_hal.h
+#ifndef AUDIO_HAL_H
+#define AUDIO_HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+/**
+ * @brief Capture side of the I2S bus as the recorder uses it: stereo
+ * Philips frames, one slot width, delivered in DMA-buffer sized blocks.
+ *
+ * Implemented by audio_hal_i2s.c on the ESP32-S3 and by the simulator
+ * of the host build (host/audio_hal_sim.c).
+ */
+typedef struct {
+    uint32_t sample_rate;       /**< Frames per second */
+    uint8_t slot_bits;          /**< 16 or 32 (24-bit audio is MSB-aligned in 32-bit slots) */
+    uint32_t dma_desc_num;      /**< DMA buffers */
+    uint32_t dma_frame_num;     /**< Frames per DMA buffer */
+    bool callback_mode;         /**< Blocks go to on_recv instead of audio_hal_i2s_read() */
+} audio_hal_i2s_config_t;
+
+/**
+ * @brief A DMA buffer completed (callback mode). Runs in interrupt context;
+ * data is only valid during the call.
+ * @return true if a higher-priority task was woken
+ */
+typedef bool (*audio_hal_recv_cb_t)(const void* data, size_t size);
+
+/** A DMA buffer nobody read was dropped (polled mode). Interrupt context. */
+typedef void (*audio_hal_overflow_cb_t)(size_t size);
+
+// ==================== API PÚBLICA ====================
+bool audio_hal_i2s_init(const audio_hal_i2s_config_t* config,
+                        audio_hal_recv_cb_t on_recv, audio_hal_overflow_cb_t on_overflow);
+void audio_hal_i2s_deinit(void);
+esp_err_t audio_hal_i2s_read(void* buf, size_t size, size_t* bytes_read, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_HAL_H
@@ -0,0 +1,122 @@
+// audio_hal_i2s.c
+#include "audio_hal.h"
+#include "audio_recorder.h"
+#include "driver/i2s_std.h"
+#include "esp_log.h"
+
+static const char* TAG = "AUDIO_HAL";
+
+static i2s_chan_handle_t tx_handle = NULL;      /**< I2S TX handle */
+static i2s_chan_handle_t rx_handle = NULL;      /**< I2S RX handle */
+static audio_hal_recv_cb_t recv_cb = NULL;      /**< Recorder callback (callback mode) */
+static audio_hal_overflow_cb_t overflow_cb = NULL;  /**< Recorder callback (polled mode) */
+
+static bool i2s_on_recv(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx)
+{
+    return recv_cb(event->dma_buf, event->size);
+}
+
+static bool i2s_on_recv_q_ovf(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx)
+{
+    overflow_cb(event->size);
+    return false;
+}
+
+/**
+ * @brief Initialize I2S interface for TX/RX (PMOD I2S2, pins in audio_recorder.h).
+ * @param config Capture format and DMA layout
+ * @param on_recv Called per DMA buffer in callback mode
+ * @param on_overflow Called per dropped DMA buffer in polled mode, may be NULL
+ * @return true if successful, false otherwise
+ */
+bool audio_hal_i2s_init(const audio_hal_i2s_config_t* config,
+                        audio_hal_recv_cb_t on_recv, audio_hal_overflow_cb_t on_overflow)
+{
+    i2s_chan_config_t chan_cfg = {
+        .id = I2S_NUM_0,
+        .role = I2S_ROLE_MASTER,
+        .dma_desc_num = config->dma_desc_num,
+        .dma_frame_num = config->dma_frame_num,
+        .auto_clear_after_cb = config->callback_mode,   // TX is not fed: send silence
+        .auto_clear_before_cb = false,
+        .intr_priority = 7,
+    };
+
+    if (i2s_new_channel(&chan_cfg, &tx_handle, &rx_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot allocate the I2S channels");
+        return false;
+    }
+
+    i2s_std_clk_config_t clk_cfg = {
+        .sample_rate_hz = config->sample_rate,
+        .clk_src = I2S_CLK_SRC_DEFAULT,
+        .mclk_multiple = I2S_MCLK_MULTIPLE_384,
+    };
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = clk_cfg,
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(
+                        config->slot_bits == 16 ? I2S_DATA_BIT_WIDTH_16BIT : I2S_DATA_BIT_WIDTH_32BIT,
+                        I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .mclk = PM_MCK,
+            .bclk = PM_BCK,
+            .ws   = PM_WS,
+            .dout = PM_SDO,
+            .din  = PM_SDIN,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv   = false,
+            },
+        },
+    };
+
+    if (i2s_channel_init_std_mode(tx_handle, &std_cfg) != ESP_OK) return false;
+    if (i2s_channel_init_std_mode(rx_handle, &std_cfg) != ESP_OK) return false;
+
+    // In callback mode nothing reads the driver queue, so its overflow event carries no information
+    recv_cb = on_recv;
+    overflow_cb = on_overflow;
+    i2s_event_callbacks_t cbs = { 0 };
+    if (config->callback_mode) {
+        cbs.on_recv = i2s_on_recv;
+    } else if (on_overflow) {
+        cbs.on_recv_q_ovf = i2s_on_recv_q_ovf;
+    }
+    if (i2s_channel_register_event_callback(rx_handle, &cbs, NULL) != ESP_OK) return false;
+
+    i2s_channel_enable(tx_handle);
+    i2s_channel_enable(rx_handle);
+
+    return true;
+}
+
+/**
+ * @brief Deinitialize I2S interface and free resources
+ */
+void audio_hal_i2s_deinit(void)
+{
+    if (tx_handle) i2s_channel_disable(tx_handle);
+    if (rx_handle) i2s_channel_disable(rx_handle);
+    if (tx_handle) i2s_del_channel(tx_handle);
+    if (rx_handle) i2s_del_channel(rx_handle);
+    tx_handle = rx_handle = NULL;
+}
+
+/**
+ * @brief Read captured frames (polled mode) and echo them to the codec output.
+ * @param buf Destination
+ * @param size Bytes wanted, whole frames
+ * @param bytes_read Receives the bytes read, fewer on timeout
+ * @param timeout_ms Longest wait
+ * @return ESP_OK, or the driver error (ESP_ERR_TIMEOUT for a short read)
+ */
+esp_err_t audio_hal_i2s_read(void* buf, size_t size, size_t* bytes_read, uint32_t timeout_ms)
+{
+    size_t written = 0;
+    *bytes_read = 0;
+    esp_err_t err = i2s_channel_read(rx_handle, buf, size, bytes_read, timeout_ms);
+    i2s_channel_write(tx_handle, buf, *bytes_read, &written, 100);
+    return err;
+}
@@ -0,0 +1,253 @@
+// audio_kernels.c
+#include "audio_kernels.h"
+#include <stdbool.h>
+
+/** 32-bit word that may alias 16-bit sample buffers (little-endian layout) */
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+#define IS_ALIGNED(p, n) ((((uintptr_t)(p)) & ((n) - 1)) == 0)
+
+// ==================== GENERIC KERNELS ====================
+/**
+ * @brief Keep one 16-bit half of every 32-bit word, two words per store.
+ *
+ * The stereo extract and 32->16 narrowing kernels are all the same
+ * operation on little-endian words: left/low halves (high = false) or
+ * right/high halves (high = true).
+ *
+ * @param dst Output samples
+ * @param src Input words
+ * @param n Number of words (= output samples)
+ * @param high Select the high half of each word
+ */
+static void select_half16(int16_t* dst, const word_t* src, size_t n, bool high)
+{
+    const int shift = high ? 16 : 0;
+    size_t i = 0;
+
+    if (!IS_ALIGNED(src, 4)) {
+        // Unaligned source: plain scalar path
+        const int16_t* s = (const int16_t*)src + (high ? 1 : 0);
+        for (; i < n; i++) dst[i] = s[2 * i];
+        return;
+    }
+
+    if (!IS_ALIGNED(dst, 4) && n > 0) {
+        dst[0] = (int16_t)(src[0] >> shift);
+        i = 1;
+    }
+
+    word_t* out = (word_t*)(dst + i);
+    for (; i + 4 <= n; i += 4, out += 2) {
+        uint32_t w0 = src[i], w1 = src[i + 1], w2 = src[i + 2], w3 = src[i + 3];
+        if (high) {
+            out[0] = (w0 >> 16) | (w1 & 0xFFFF0000u);
+            out[1] = (w2 >> 16) | (w3 & 0xFFFF0000u);
+        } else {
+            out[0] = (w0 & 0xFFFFu) | (w1 << 16);
+            out[1] = (w2 & 0xFFFFu) | (w3 << 16);
+        }
+    }
+
+    for (; i < n; i++) dst[i] = (int16_t)(src[i] >> shift);
+}
+
+/**
+ * @brief Extract the left channel of interleaved 16-bit stereo frames (portable).
+ * @param dst Output, frames samples
+ * @param src Interleaved L/R input, 2 * frames samples
+ * @param frames Number of stereo frames
+ */
+void audio_extract_left_s16_generic(int16_t* dst, const int16_t* src, size_t frames)
+{
+    select_half16(dst, (const word_t*)src, frames, false);
+}
+
+/**
+ * @brief Extract the right channel of interleaved 16-bit stereo frames (portable).
+ * @param dst Output, frames samples
+ * @param src Interleaved L/R input, 2 * frames samples
+ * @param frames Number of stereo frames
+ */
+void audio_extract_right_s16_generic(int16_t* dst, const int16_t* src, size_t frames)
+{
+    select_half16(dst, (const word_t*)src, frames, true);
+}
+
+/**
+ * @brief Mix interleaved 16-bit stereo down to mono, (L + R) / 2 (portable).
+ * @param dst Output, frames samples
+ * @param src Interleaved L/R input, 2 * frames samples
+ * @param frames Number of stereo frames
+ */
+void audio_mixdown_s16_generic(int16_t* dst, const int16_t* src, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        dst[i]     = (int16_t)(((int32_t)src[2 * i]     + src[2 * i + 1]) >> 1);
+        dst[i + 1] = (int16_t)(((int32_t)src[2 * i + 2] + src[2 * i + 3]) >> 1);
+        dst[i + 2] = (int16_t)(((int32_t)src[2 * i + 4] + src[2 * i + 5]) >> 1);
+        dst[i + 3] = (int16_t)(((int32_t)src[2 * i + 6] + src[2 * i + 7]) >> 1);
+    }
+    for (; i < frames; i++) {
+        dst[i] = (int16_t)(((int32_t)src[2 * i] + src[2 * i + 1]) >> 1);
+    }
+}
+
+/**
+ * @brief Narrow 32-bit samples to 16 bits by keeping the upper half (portable).
+ * @param dst Output samples
+ * @param src Input samples
+ * @param samples Number of samples
+ */
+void audio_narrow_s32_s16_generic(int16_t* dst, const int32_t* src, size_t samples)
+{
+    select_half16(dst, (const word_t*)src, samples, true);
+}
+
+/**
+ * @brief Extract the left channel of interleaved 32-bit stereo frames.
+ *
+ * Plain word copies; safe in any context.
+ *
+ * @param dst Output, frames samples
+ * @param src Interleaved L/R input, 2 * frames samples
+ * @param frames Number of stereo frames
+ */
+void audio_extract_left_s32(int32_t* dst, const int32_t* src, size_t frames)
+{
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        dst[i]     = src[2 * i];
+        dst[i + 1] = src[2 * i + 2];
+        dst[i + 2] = src[2 * i + 4];
+        dst[i + 3] = src[2 * i + 6];
+    }
+    for (; i < frames; i++) dst[i] = src[2 * i];
+}
+
+/**
+ * @brief Pack the upper 24 bits of 32-bit samples into 3-byte little-endian samples.
+ *
+ * Safe in any context.
+ *
+ * @param dst Output, 3 * samples bytes
+ * @param src Input samples (MSB-aligned 24-bit data in 32-bit slots)
+ * @param samples Number of samples to pack
+ * @param stride Distance between consecutive input samples (1 = all, 2 = left only)
+ */
+void audio_pack_s32_s24(uint8_t* dst, const int32_t* src, size_t samples, size_t stride)
+{
+    for (size_t i = 0; i < samples; i++, src += stride, dst += 3) {
+        uint32_t v = (uint32_t)*src;
+        dst[0] = (uint8_t)(v >> 8);
+        dst[1] = (uint8_t)(v >> 16);
+        dst[2] = (uint8_t)(v >> 24);
+    }
+}
+
+// ==================== PIE KERNELS ====================
+#if AUDIO_KERNELS_PIE
+/**
+ * @brief Deinterleave 16-bit lanes with EE.VUNZIP.16, 8 output samples per step.
+ *
+ * Two 128-bit loads take 16 interleaved samples; VUNZIP leaves the even
+ * lanes in q0 and the odd lanes in q1. Both pointers must be 16-byte
+ * aligned (the low address bits are ignored by EE.VLD/EE.VST).
+ *
+ * @param dst Output, blocks * 8 samples
+ * @param src Input, blocks * 16 samples
+ * @param blocks Number of 8-sample output blocks
+ * @param odd Store the odd lanes instead of the even ones
+ */
+static void select_half16_pie(int16_t* dst, const int16_t* src, size_t blocks, bool odd)
+{
+    if (odd) {
+        for (size_t b = 0; b < blocks; b++) {
+            __asm__ volatile(
+                "ee.vld.128.ip q0, %0, 16\n\t"
+                "ee.vld.128.ip q1, %0, 16\n\t"
+                "ee.vunzip.16 q0, q1\n\t"
+                "ee.vst.128.ip q1, %1, 16\n\t"
+                : "+r"(src), "+r"(dst) :: "memory");
+        }
+    } else {
+        for (size_t b = 0; b < blocks; b++) {
+            __asm__ volatile(
+                "ee.vld.128.ip q0, %0, 16\n\t"
+                "ee.vld.128.ip q1, %0, 16\n\t"
+                "ee.vunzip.16 q0, q1\n\t"
+                "ee.vst.128.ip q0, %1, 16\n\t"
+                : "+r"(src), "+r"(dst) :: "memory");
+        }
+    }
+}
+
+/**
+ * @brief Run the PIE kernel on the aligned bulk and the generic one on the tail.
+ * @return Number of output samples already produced
+ */
+static size_t select_half16_fast(int16_t* dst, const int16_t* src, size_t n, bool odd)
+{
+    if (!IS_ALIGNED(dst, 16) || !IS_ALIGNED(src, 16)) return 0;
+
+    size_t blocks = n / 8;
+    select_half16_pie(dst, src, blocks, odd);
+    return blocks * 8;
+}
+#endif
+
+// ==================== DISPATCH ====================
+/**
+ * @brief Extract the left channel of interleaved 16-bit stereo frames.
+ *
+ * Not ISR-safe on ESP32-S3 (uses PIE); use the _generic variant there.
+ */
+void audio_extract_left_s16(int16_t* dst, const int16_t* src, size_t frames)
+{
+    size_t done = 0;
+#if AUDIO_KERNELS_PIE
+    done = select_half16_fast(dst, src, frames, false);
+#endif
+    audio_extract_left_s16_generic(dst + done, src + 2 * done, frames - done);
+}
+
+/**
+ * @brief Extract the right channel of interleaved 16-bit stereo frames.
+ *
+ * Not ISR-safe on ESP32-S3 (uses PIE); use the _generic variant there.
+ */
+void audio_extract_right_s16(int16_t* dst, const int16_t* src, size_t frames)
+{
+    size_t done = 0;
+#if AUDIO_KERNELS_PIE
+    done = select_half16_fast(dst, src, frames, true);
+#endif
+    audio_extract_right_s16_generic(dst + done, src + 2 * done, frames - done);
+}
+
+/**
+ * @brief Mix interleaved 16-bit stereo down to mono.
+ *
+ * PIE only offers saturating or lossy halving adds, so this stays on the
+ * generic path to keep (L + R) / 2 exact.
+ */
+void audio_mixdown_s16(int16_t* dst, const int16_t* src, size_t frames)
+{
+    audio_mixdown_s16_generic(dst, src, frames);
+}
+
+/**
+ * @brief Narrow 32-bit samples to 16 bits by keeping the upper half.
+ *
+ * Not ISR-safe on ESP32-S3 (uses PIE); use the _generic variant there.
+ */
+void audio_narrow_s32_s16(int16_t* dst, const int32_t* src, size_t samples)
+{
+    size_t done = 0;
+#if AUDIO_KERNELS_PIE
+    // Upper halves of little-endian words are the odd 16-bit lanes
+    done = select_half16_fast(dst, (const int16_t*)src, samples, true);
+#endif
+    audio_narrow_s32_s16_generic(dst + done, src + done, samples - done);
+}
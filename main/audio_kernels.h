@@ -0,0 +1,45 @@
+#ifndef AUDIO_KERNELS_H
+#define AUDIO_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+// ESP32-S3 PIE (128-bit SIMD) kernels. The PIE registers are a lazily
+// saved coprocessor that cannot be used from an ISR, so ISR code must
+// call the *_generic variants.
+#if defined(ESP_PLATFORM) && defined(__XTENSA__)
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_ESP32S3
+#define AUDIO_KERNELS_PIE 1
+#endif
+#endif
+
+#ifndef AUDIO_KERNELS_PIE
+#define AUDIO_KERNELS_PIE 0
+#endif
+
+// ==================== API PÚBLICA ====================
+// Best available implementation (PIE when buffers are 16-byte aligned)
+void audio_extract_left_s16(int16_t* dst, const int16_t* src, size_t frames);
+void audio_extract_right_s16(int16_t* dst, const int16_t* src, size_t frames);
+void audio_mixdown_s16(int16_t* dst, const int16_t* src, size_t frames);
+void audio_narrow_s32_s16(int16_t* dst, const int32_t* src, size_t samples);
+void audio_extract_left_s32(int32_t* dst, const int32_t* src, size_t frames);
+void audio_pack_s32_s24(uint8_t* dst, const int32_t* src, size_t samples, size_t stride);
+
+// Portable implementations, safe in any context
+void audio_extract_left_s16_generic(int16_t* dst, const int16_t* src, size_t frames);
+void audio_extract_right_s16_generic(int16_t* dst, const int16_t* src, size_t frames);
+void audio_mixdown_s16_generic(int16_t* dst, const int16_t* src, size_t frames);
+void audio_narrow_s32_s16_generic(int16_t* dst, const int32_t* src, size_t samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_KERNELS_H
@@ -0,0 +1,86 @@
+#ifndef AUDIO_METER_H
+#define AUDIO_METER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wav_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define AUDIO_METER_BLOCK_MS 125            /**< Block length ("fast" time weighting) */
+#define AUDIO_METER_FLOOR_DB (-120.0f)      /**< Level reported for digital silence */
+#define AUDIO_METER_CLIP_LEVEL 0x7FFE0000   /**< Left-justified |sample| counted as clipped */
+#define AUDIO_METER_MIN_RATE 44100          /**< Lowest rate with an accurate A-weighting (< 1 dB off) */
+#define AUDIO_METER_EXTENSION ".csv"
+#define AUDIO_METER_CSV_HEADER "time,seconds,laeq_db,leq_db,lafmax_db,peak_dbfs,clips\n"
+
+/** Levels of the last complete block */
+typedef struct {
+    float peak_dbfs;            /**< Sample peak, all channels */
+    float rms_dbfs;             /**< Unweighted level, first channel */
+    float la_dbfs;              /**< A-weighted level, first channel */
+    uint32_t clips;             /**< Samples at or above AUDIO_METER_CLIP_LEVEL, all channels */
+} audio_meter_block_t;
+
+/** Summary of one logging interval */
+typedef struct {
+    uint64_t start_frame;       /**< First frame of the interval since the last reset */
+    uint32_t frames;            /**< Frames in the interval (shorter at the end of a session) */
+    float laeq_dbfs;            /**< A-weighted equivalent level */
+    float leq_dbfs;             /**< Unweighted equivalent level */
+    float lamax_dbfs;           /**< Loudest A-weighted block */
+    float peak_dbfs;            /**< Sample peak */
+    uint32_t clips;             /**< Clipped samples */
+} audio_meter_interval_t;
+
+/**
+ * @brief Level meter state.
+ *
+ * Levels are mean squares relative to full scale (a full-scale square
+ * wave is 0 dB, a full-scale sine -3 dB). The A-weighting filter is the
+ * IEC 61672 analog response mapped with the bilinear transform (f4
+ * prewarped) and normalized to 0 dB at 1 kHz; it runs in float.
+ */
+typedef struct {
+    wav_format_t fmt;
+    float aw[3][5];             /**< A-weighting sections: b0, b1, b2, a1, a2 */
+    float az[3][2];             /**< Transposed direct form II state */
+    uint32_t block_frames;
+    uint32_t interval_frames;
+
+    uint32_t block_fill;
+    float block_sum_z;
+    float block_sum_a;
+    uint32_t block_peak;
+    uint32_t block_clips;
+
+    uint64_t frames_in;         /**< Frames fed since the last reset */
+    uint64_t interval_start;
+    uint32_t interval_fill;
+    double sum_z;
+    double sum_a;
+    float lamax_dbfs;
+    uint32_t peak;
+    uint32_t clips;
+
+    audio_meter_block_t last_block;
+    uint64_t clips_total;       /**< Clipped samples since the last reset */
+} audio_meter_t;
+
+// ==================== API PÚBLICA ====================
+void audio_meter_init(audio_meter_t* meter, const wav_format_t* fmt, uint32_t interval_s);
+void audio_meter_reset(audio_meter_t* meter);
+size_t audio_meter_feed(audio_meter_t* meter, const uint8_t* frames, size_t count);
+bool audio_meter_interval_ready(const audio_meter_t* meter);
+bool audio_meter_take(audio_meter_t* meter, audio_meter_interval_t* out);
+float audio_meter_a_response_db(const audio_meter_t* meter, float hz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_METER_H
@@ -1,292 +1,1740 @@
 // audio_recorder.c
 #include "audio_recorder.h"
-#include "driver/i2s_std.h"
+#include "audio_ring.h"
+#include "audio_kernels.h"
+#include "audio_trigger.h"
+#include "flac_encoder.h"
+#include "ima_adpcm.h"
+#include "audio_resampler.h"
+#include "audio_biquad.h"
+#include "audio_spectrum.h"
+#include "audio_meter.h"
+#include "wav_format.h"
+#include "raw_log.h"
+#include "latency_histogram.h"
+#include "audio_hal.h"
 #include "esp_heap_caps.h"
 #include "sd_mmc.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stdatomic.h>
 #include <string.h>
 #include <time.h>
 #include <stdio.h>
+#include <unistd.h>
 #include "esp_timer.h"
 #include "esp_task_wdt.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
 
 static const char* TAG = "AUDIO_RECORDER";   // <--- TAG para logging
 
 // ==================== GLOBAL VARIABLES ====================
-static i2s_chan_handle_t tx_handle = NULL;      /**< I2S TX handle */
-static i2s_chan_handle_t rx_handle = NULL;      /**< I2S RX handle */
-static uint16_t* psram_buffer = NULL;           /**< PSRAM buffer for audio samples */
-static uint16_t rx_buf[I2S_BUFFERSIZE];        /**< Temporary I2S buffer */
-
-static recorder_state_t current_state = RECORDER_STATE_IDLE; /**< Recorder state */
-static TaskHandle_t sd_task_handle = NULL;                  /**< SD write task handle */
-static FILE* audio_file = NULL;                             /**< Current audio file */
+static uint8_t* psram_buffer = NULL;            /**< PSRAM storage behind the audio ring */
+static uint32_t psram_buffer_size = 0;          /**< Ring capacity in bytes */
+static uint16_t rx_buf[I2S_BUFFERSIZE] __attribute__((aligned(16))); /**< Temporary I2S buffer */
+static audio_ring_t ring;                       /**< I2S -> SD sample ring */
+
+/** Moves frames from an I2S stereo buffer to the ring in the recorded format */
+typedef void (*capture_kernel_t)(uint8_t* dst, const uint8_t* src, size_t frames);
+
+static audio_recorder_config_t rec_config = AUDIO_RECORDER_DEFAULT_CONFIG(); /**< Active configuration */
+static wav_format_t wav_fmt;                    /**< Stored sample format (rate after decimation) */
+static size_t in_frame_bytes = 0;               /**< Bytes per I2S stereo frame */
+static size_t out_frame_bytes = 0;              /**< Bytes per recorded frame */
+static bool reserve_ds64 = false;               /**< WAV headers carry the RF64 placeholder */
+static uint64_t prealloc_bytes = 0;             /**< Contiguous space reserved per file, 0 = none */
+static capture_kernel_t capture_kernel = NULL;      /**< Task-context kernel */
+static capture_kernel_t capture_kernel_isr = NULL;  /**< ISR-safe kernel */
+static flac_encoder_t flac;                     /**< Encoder for AUDIO_FORMAT_FLAC */
+static ima_adpcm_encoder_t adpcm;               /**< Encoder for AUDIO_FORMAT_IMA_ADPCM */
+static audio_resampler_t resampler;             /**< Decimator when output_rate < sample_rate */
+static bool resampling = false;                 /**< resampler is active */
+static audio_biquad_t filter;                   /**< Biquad cascade at the capture rate */
+static bool filtering = false;                  /**< filter is active */
+static audio_spectrum_t spectrum;               /**< Sidecar analyzer when spectrum_enabled */
+static audio_meter_t meter;                     /**< Level meter at the capture rate */
+static bool metering = false;                   /**< meter is active */
+static audio_recorder_levels_t current_levels;  /**< Latest levels, published by the writer */
+static portMUX_TYPE levels_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile recorder_state_t current_state = RECORDER_STATE_IDLE; /**< Recorder state */
+static TaskHandle_t sd_task_handle = NULL;                  /**< SD writer task handle */
+static QueueHandle_t writer_queue = NULL;                   /**< Commands for the SD writer */
+static SemaphoreHandle_t writer_done = NULL;                /**< Signals a finished writer command */
+static volatile bool writer_ok = false;                     /**< Result of the last writer command */
+static volatile bool stop_requested = false;                /**< Set by audio_recorder_stop() or a write error */
+static volatile bool capture_active = false;                /**< DMA callback commits to the ring */
+static SemaphoreHandle_t capture_done = NULL;               /**< Given when the session frame count is reached or the writer fails */
+static time_t session_start_time = 0;                       /**< Wall-clock start of the session */
+static uint64_t session_frames = 0;                         /**< Frames to capture this session */
+static volatile uint64_t frames_captured = 0;               /**< Frames taken from I2S this session */
+static size_t notify_pending = 0;                           /**< Bytes captured since the writer was last woken */
+
+/** Why frames are missing from the ring */
+typedef enum {
+    GAP_SHORT_READ,         /**< audio_hal_i2s_read() timed out or failed (polled mode) */
+    GAP_DMA_OVERFLOW,       /**< The driver dropped DMA buffers nobody read (polled mode) */
+    GAP_RING_OVERRUN        /**< The ring was full */
+} gap_cause_t;
+
+/** A run of frames missing between two frames committed to the ring */
+typedef struct {
+    uint64_t position;      /**< Frames committed to the ring before the gap */
+    uint32_t frames;        /**< Missing frames */
+    uint8_t cause;          /**< gap_cause_t */
+} gap_event_t;
+
+#define GAP_QUEUE_LEN 32
+
+// Capture-side gap tracking (only touched by the capture context: ISR or polled loop)
+static QueueHandle_t gap_queue = NULL;                      /**< Gaps handed to the SD writer */
+static uint64_t frames_committed = 0;                       /**< Frames committed to the ring this session */
+static gap_event_t gap_open;                                /**< Gap still growing, not queued yet */
+static bool gap_pending = false;                            /**< gap_open is valid */
+static atomic_uint dma_overflow_bytes;                      /**< Bytes dropped by the driver, from its ISR */
+static volatile uint32_t gap_events = 0;                    /**< Gaps this session */
+static volatile uint64_t gap_frames = 0;                    /**< Missing frames this session */
+static volatile uint32_t short_reads = 0;                   /**< Short or failed polled reads */
+static volatile uint32_t dma_overflows = 0;                 /**< Driver receive queue overflows */
+static sd_file_t* audio_file = NULL;                        /**< Current audio file */
+static bool raw_open = false;                               /**< Session goes to the raw log instead of audio_file */
 static char current_filename[128] = {0};                    /**< Current filename */
 
-static unsigned long i2s_write_pos = 0; /**< Write position in PSRAM buffer */
-static unsigned long sd_write_pos = 0;  /**< Position for SD write */
-static unsigned long cycle_count = 0;   /**< I2S/SD cycle counter */
-static uint64_t time_recording = 0;     /**< Recording start time in ms */
+static bool i2s_on_recv(const void* data, size_t size);
+static void i2s_on_recv_q_ovf(size_t size);
+
+/**
+ * @brief Whether the session has somewhere to store audio.
+ */
+static inline bool output_open(void)
+{
+    return audio_file || raw_open;
+}
 
 // ==================== I2S FUNCTIONS ====================
 /**
- * @brief Initialize I2S interface for TX/RX.
+ * @brief Start capture through the I2S HAL (audio_hal.h).
  * @return true if successful, false otherwise
  */
 static bool init_i2s(void)
 {
-    i2s_chan_config_t chan_cfg = {
-        .id = I2S_NUM_0,
-        .role = I2S_ROLE_MASTER,
+    audio_hal_i2s_config_t cfg = {
+        .sample_rate = rec_config.sample_rate,
+        .slot_bits = rec_config.bits_per_sample == 16 ? 16 : 32,
         .dma_desc_num = BUF_COUNT,
         .dma_frame_num = BUF_LEN,
-        .auto_clear_after_cb = false,
-        .auto_clear_before_cb = false,
-        .intr_priority = 7,
+        .callback_mode = (rec_config.capture_mode == CAPTURE_MODE_DMA_CALLBACK),
     };
+    return audio_hal_i2s_init(&cfg, i2s_on_recv, i2s_on_recv_q_ovf);
+}
+
+// ==================== PSRAM FUNCTIONS ====================
+/**
+ * @brief Allocate PSRAM buffer for recording
+ * @return true if allocation succeeded
+ */
+static bool init_psram(void)
+{
+    // Smallest power of two holding PSRAM_BUFFER_SECONDS of audio, within bounds
+    // The ring holds audio at the capture rate, before any decimation
+    uint32_t wanted = rec_config.sample_rate * out_frame_bytes * PSRAM_BUFFER_SECONDS;
+    psram_buffer_size = PSRAM_BUFFER_MIN;
+    while (psram_buffer_size < wanted && psram_buffer_size < PSRAM_BUFFER_MAX) psram_buffer_size <<= 1;
+
+    psram_buffer = (uint8_t*)heap_caps_malloc(psram_buffer_size, MALLOC_CAP_SPIRAM);
+    if (!psram_buffer) return false;
+    return audio_ring_init(&ring, psram_buffer, psram_buffer_size, out_frame_bytes);
+}
+
+/**
+ * @brief Free PSRAM buffer
+ */
+static void deinit_psram(void)
+{
+    if (psram_buffer) {
+        free(psram_buffer);
+        psram_buffer = NULL;
+    }
+}
+
+// ==================== CAPTURE KERNELS ====================
+/** 16-bit mono (left channel), PIE where available */
+static void capture_s16_mono(uint8_t* dst, const uint8_t* src, size_t frames)
+{
+    audio_extract_left_s16((int16_t*)dst, (const int16_t*)src, frames);
+}
+
+/** 16-bit mono (left channel), ISR-safe */
+static void capture_s16_mono_isr(uint8_t* dst, const uint8_t* src, size_t frames)
+{
+    audio_extract_left_s16_generic((int16_t*)dst, (const int16_t*)src, frames);
+}
+
+/** 16/32-bit stereo: the I2S layout is already the file layout */
+static void capture_copy(uint8_t* dst, const uint8_t* src, size_t frames)
+{
+    memcpy(dst, src, frames * out_frame_bytes);
+}
+
+/** 32-bit mono (left channel) */
+static void capture_s32_mono(uint8_t* dst, const uint8_t* src, size_t frames)
+{
+    audio_extract_left_s32((int32_t*)dst, (const int32_t*)src, frames);
+}
+
+/** 24-bit mono (left channel) packed from 32-bit slots */
+static void capture_s24_mono(uint8_t* dst, const uint8_t* src, size_t frames)
+{
+    audio_pack_s32_s24(dst, (const int32_t*)src, frames, 2);
+}
+
+/** 24-bit stereo packed from 32-bit slots */
+static void capture_s24_stereo(uint8_t* dst, const uint8_t* src, size_t frames)
+{
+    audio_pack_s32_s24(dst, (const int32_t*)src, frames * 2, 1);
+}
 
-    if (i2s_new_channel(&chan_cfg, &tx_handle, &rx_handle) != ESP_OK) {
+/**
+ * @brief Validate the configuration and select the capture kernels for it.
+ * @param config Requested configuration
+ * @return false if the configuration is not supported
+ */
+static bool apply_config(const audio_recorder_config_t* config)
+{
+    if (config->sample_rate < 8000 || config->sample_rate > 96000) return false;
+    if (config->channels != 1 && config->channels != 2) return false;
+    if (config->format == AUDIO_FORMAT_FLAC && config->bits_per_sample != 16 && config->bits_per_sample != 24) {
         return false;
     }
+    if (config->format == AUDIO_FORMAT_IMA_ADPCM && config->bits_per_sample != 16) return false;
+    if (config->raw_log && config->format != AUDIO_FORMAT_WAV) return false;
 
-    i2s_std_clk_config_t clk_cfg = {
-        .sample_rate_hz = SAMPLERATE,
-        .clk_src = I2S_CLK_SRC_DEFAULT,
-        .mclk_multiple = I2S_MCLK_MULTIPLE_384,
-    };
+    resampling = config->output_rate != 0 && config->output_rate != config->sample_rate;
+    if (resampling && (config->output_rate < 4000 || config->output_rate > config->sample_rate ||
+                       config->bits_per_sample != 16)) {
+        return false;
+    }
+
+    metering = config->meter_interval_s > 0;
+    if (config->format == AUDIO_FORMAT_LOG_ONLY && !metering) return false;
+    if (metering && config->sample_rate < AUDIO_METER_MIN_RATE) {
+        ESP_LOGE(TAG, "Metering needs a capture rate of at least %u Hz for its A-weighting", AUDIO_METER_MIN_RATE);
+        return false;
+    }
+
+    filtering = config->highpass_hz || config->lowpass_hz || config->filter_sections;
+    if (filtering) {
+        uint32_t sections = config->filter_sections + (config->highpass_hz != 0) + (config->lowpass_hz != 0);
+        if (config->bits_per_sample != 16 || sections > AUDIO_BIQUAD_MAX_SECTIONS) return false;
+        if (config->filter_sections && !config->filter_coeffs) return false;
+        if (config->lowpass_hz * 2 >= config->sample_rate || config->highpass_hz * 2 >= config->sample_rate) return false;
+    }
+
+    rec_config = *config;
+    wav_fmt.sample_rate = resampling ? config->output_rate : config->sample_rate;
+    wav_fmt.channels = config->channels;
+    wav_fmt.bits_per_sample = config->bits_per_sample;
+    out_frame_bytes = wav_block_align(&wav_fmt);
 
-    i2s_std_config_t std_cfg = {
-        .clk_cfg = clk_cfg,
-        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(
-                        I2S_DATA_BIT_WIDTH_16BIT,
-                        I2S_SLOT_MODE_STEREO),
-        .gpio_cfg = {
-            .mclk = PM_MCK,
-            .bclk = PM_BCK,
-            .ws   = PM_WS,
-            .dout = PM_SDO,
-            .din  = PM_SDIN,
-            .invert_flags = {
-                .mclk_inv = false,
-                .bclk_inv = false,
-                .ws_inv   = false,
-            },
-        },
+    bool mono = (config->channels == 1);
+    switch (config->bits_per_sample) {
+        case 16:
+            in_frame_bytes = 2 * sizeof(int16_t);
+            capture_kernel = mono ? capture_s16_mono : capture_copy;
+            capture_kernel_isr = mono ? capture_s16_mono_isr : capture_copy;
+            break;
+        case 24:
+            in_frame_bytes = 2 * sizeof(int32_t);
+            capture_kernel = capture_kernel_isr = mono ? capture_s24_mono : capture_s24_stereo;
+            break;
+        case 32:
+            in_frame_bytes = 2 * sizeof(int32_t);
+            capture_kernel = capture_kernel_isr = mono ? capture_s32_mono : capture_copy;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+// ==================== AUDIO FILE FUNCTIONS ====================
+#define AUDIO_HEADER_MAX (WAV_IMA_HEADER_SIZE + WAV_DS64_CHUNK_SIZE)   // Largest of the per-format headers
+_Static_assert(sizeof(AUDIO_METER_CSV_HEADER) - 1 <= AUDIO_HEADER_MAX, "CSV header too long");
+
+/**
+ * @brief Build the file header for the configured format
+ * @param buf Output, AUDIO_HEADER_MAX bytes
+ * @param data_size Audio bytes after the header (PCM WAV)
+ * @param final Describe the finished stream; false writes the provisional header
+ * @return Header length in bytes
+ */
+static size_t build_header(uint8_t* buf, uint64_t data_size, bool final)
+{
+    switch (rec_config.format) {
+        case AUDIO_FORMAT_FLAC:
+            return flac_encoder_stream_header(&flac, buf, final);
+        case AUDIO_FORMAT_IMA_ADPCM:
+            return wav_build_ima_header(buf, &wav_fmt, adpcm.block_align, adpcm.samples_per_block,
+                                        final ? adpcm.total_frames : 0,
+                                        final ? (uint64_t)adpcm.blocks * adpcm.block_align : 0, reserve_ds64);
+        case AUDIO_FORMAT_LOG_ONLY:
+            memcpy(buf, AUDIO_METER_CSV_HEADER, sizeof(AUDIO_METER_CSV_HEADER) - 1);
+            return sizeof(AUDIO_METER_CSV_HEADER) - 1;
+        default:
+            return wav_build_header(buf, &wav_fmt, final ? data_size : 0, reserve_ds64);
+    }
+}
+
+/**
+ * @brief Allocate the encoder of the configured format, if it has one
+ * @return false if allocation failed
+ */
+static bool init_encoder(void)
+{
+    switch (rec_config.format) {
+        case AUDIO_FORMAT_FLAC:
+            return flac_encoder_init(&flac, &wav_fmt, FLAC_DEFAULT_BLOCK_SIZE);
+        case AUDIO_FORMAT_IMA_ADPCM:
+            return ima_adpcm_encoder_init(&adpcm, wav_fmt.channels,
+                                          ima_adpcm_block_align(wav_fmt.sample_rate, wav_fmt.channels));
+        default:
+            return true;
+    }
+}
+
+/**
+ * @brief Build the biquad cascade: custom sections first, then high-pass, then low-pass.
+ */
+static void init_filter(void)
+{
+    if (!filtering) return;
+
+    audio_biquad_coeffs_t coeffs[AUDIO_BIQUAD_MAX_SECTIONS];
+    uint8_t n = 0;
+    for (; n < rec_config.filter_sections; n++) coeffs[n] = rec_config.filter_coeffs[n];
+    if (rec_config.highpass_hz) audio_biquad_highpass(&coeffs[n++], rec_config.sample_rate, rec_config.highpass_hz, 0.7071f);
+    if (rec_config.lowpass_hz) audio_biquad_lowpass(&coeffs[n++], rec_config.sample_rate, rec_config.lowpass_hz, 0.7071f);
+    audio_biquad_init(&filter, coeffs, n, wav_fmt.channels);
+
+    ESP_LOGI(TAG, "Filter: %u sections, high-pass %lu Hz, low-pass %lu Hz", n,
+             (unsigned long)rec_config.highpass_hz, (unsigned long)rec_config.lowpass_hz);
+}
+
+/**
+ * @brief Set up the level meter on the captured (ring) format.
+ */
+static void init_meter(void)
+{
+    if (!metering) return;
+
+    const wav_format_t captured = {
+        .sample_rate = rec_config.sample_rate,
+        .channels = rec_config.channels,
+        .bits_per_sample = rec_config.bits_per_sample,
     };
+    audio_meter_init(&meter, &captured, rec_config.meter_interval_s);
+    ESP_LOGI(TAG, "Level log every %lu s, calibration %+.1f dB",
+             (unsigned long)rec_config.meter_interval_s, rec_config.meter_calibration_db);
+}
+
+/**
+ * @brief Bytes per second the configured format stores (an upper bound for FLAC).
+ */
+static uint64_t stored_bytes_per_second(void)
+{
+    switch (rec_config.format) {
+        case AUDIO_FORMAT_IMA_ADPCM: {
+            uint32_t align = ima_adpcm_block_align(wav_fmt.sample_rate, wav_fmt.channels);
+            uint32_t frames = ima_adpcm_samples_per_block(align, wav_fmt.channels);
+            return ((uint64_t)wav_fmt.sample_rate * align + frames - 1) / frames;
+        }
+        case AUDIO_FORMAT_LOG_ONLY:
+            return 0;
+        default:
+            return (uint64_t)wav_fmt.sample_rate * out_frame_bytes;
+    }
+}
+
+/**
+ * @brief Size the files of a session: RF64 room and contiguous preallocation
+ *
+ * Files that may outgrow a RIFF (4 GB) start with a JUNK chunk that the
+ * final header turns into ds64 if needed; smaller ones keep the canonical
+ * header. The projection uses the ring bytes, an upper bound of what is stored.
+ *
+ * With preallocate, each file is created with its projected size in
+ * consecutive clusters so FatFs never allocates while recording, and is
+ * truncated to what was written when it is closed. Until then its size on
+ * the card is the projected one (see sd_file_create()), so after a power
+ * loss everything past the last checkpoint is stale card data. WAV and IMA
+ * ADPCM readers stop at the checkpointed data chunk size; a FLAC decoder
+ * reads on into that data, so FLAC files are never preallocated.
+ *
+ * @param seconds Longest file of the session in seconds
+ */
+static void plan_file_size(uint64_t seconds)
+{
+    uint64_t bytes_per_second = (uint64_t)rec_config.sample_rate * out_frame_bytes;
+    reserve_ds64 = seconds > WAV_RIFF_MAX_DATA / bytes_per_second;
+    if (reserve_ds64) ESP_LOGI(TAG, "Files may exceed 4 GB, reserving an RF64 header");
+
+    prealloc_bytes = 0;
+    uint64_t stored = stored_bytes_per_second();
+    if (rec_config.preallocate && rec_config.format != AUDIO_FORMAT_FLAC && stored > 0) {
+        prealloc_bytes = (seconds < (UINT64_MAX - AUDIO_HEADER_MAX) / stored) ?
+                         seconds * stored + AUDIO_HEADER_MAX : UINT64_MAX;
+    }
+}
+
+/**
+ * @brief Create an audio file and write a provisional header for the configured format
+ * @param filename Path of the file
+ * @return Open file positioned after the header, NULL on failure
+ */
+static sd_file_t* create_audio_file(const char* filename)
+{
+    uint8_t header[AUDIO_HEADER_MAX];
+    size_t len = build_header(header, 0, false);
+
+    sd_file_t* file = sd_file_create(filename, prealloc_bytes);
+    if (!file) return NULL;
+
+    if (sd_file_write(file, header, len) != len) {
+        sd_file_close(file);
+        return NULL;
+    }
+    return file;
+}
+
+// ==================== SD WRITER TASK ====================
+#define WRITER_TASK_STACK 6144
+#define WRITER_TASK_PRIORITY 2
+#define WRITER_QUEUE_LEN 4
+
+/** Commands accepted by the SD writer task */
+typedef enum {
+    WRITER_CMD_OPEN,    /**< Acquire the card and create current_filename */
+    WRITER_CMD_CLOSE,   /**< Drain the ring, finalize the file(s) and release the card */
+    WRITER_CMD_EXIT     /**< Terminate the task */
+} writer_cmd_t;
+
+// Writer-owned file state (only touched by the writer task while a session runs)
+static uint64_t audio_data_bytes = 0;               /**< Audio bytes in audio_file */
+static uint64_t segment_consumed = 0;               /**< Ring bytes written, gated or lost in gaps since the segment began */
+static uint64_t gap_bytes = 0;                      /**< Bytes of recorded gaps not yet counted in segment_consumed */
+static uint64_t segment_bytes = 0;                  /**< Rollover size in bytes, 0 = single file */
+static uint32_t segment_seconds = 0;                /**< Rollover period in seconds */
+static audio_recorder_name_cb_t name_cb = NULL;     /**< Names rollover files, NULL = single file */
+static sd_file_t* next_file = NULL;                 /**< Pre-created file for the next segment */
+static char next_filename[128] = {0};               /**< Name of next_file */
+static time_t next_start_time = 0;                  /**< Recording start time of the next segment */
+
+// Writer-owned activity gate state
+static audio_trigger_t trigger;                     /**< Energy detector */
+static size_t trigger_block_bytes = 0;              /**< Analysis block (one DMA buffer) */
+static size_t pre_roll_bytes = 0;                   /**< Analyzed audio kept while the gate is closed */
+static size_t post_roll_bytes = 0;                  /**< Audio written after the last active block */
+static size_t scanned_bytes = 0;                    /**< Bytes after tail already analyzed */
+static size_t gate_bytes = 0;                       /**< Bytes after tail that must be written */
+static volatile uint32_t trigger_events = 0;        /**< Gate openings this session */
+static volatile uint64_t frames_gated = 0;          /**< Frames discarded by the gate this session */
+static uint8_t trigger_buf[BUF_LEN * 2 * sizeof(int32_t)]; /**< Copy of the block under analysis */
+// Writer-owned checkpoint state
+static int64_t last_checkpoint_us = 0;              /**< esp_timer time of the last header checkpoint */
+static volatile uint32_t checkpoints = 0;           /**< Checkpoints written this session */
+
+// Writer-owned I/O statistics
+#define SD_STALL_US 100000                          // A card access this slow counts as a stall
+#define IO_STATS_FILE "/io_stats.csv"               // One row appended per session
+static latency_histogram_t write_latency;           /**< Duration of every card access this session, us */
+static uint32_t cycles_per_us = 1;                  /**< CPU clock, for the write hook */
+static uint64_t io_bytes = 0;                       /**< Bytes written to the card this session, rewrites included */
+static uint64_t io_busy_us = 0;                     /**< Time spent inside card accesses */
+static volatile uint32_t io_stalls = 0;             /**< Accesses of SD_STALL_US or longer */
+static uint32_t stall_ring_max = 0;                 /**< Highest ring fill right after a stall */
+static int64_t io_start_us = 0;                     /**< esp_timer time the session opened */
+static int64_t io_end_us = 0;                       /**< esp_timer time it closed, 0 while open */
+
+// Writer-owned gap markers
+#define AUDIO_MAX_GAP_CUES 64                       // Cue points kept per file; later gaps are only counted
+static uint64_t ring_bytes_consumed = 0;            /**< Ring bytes written or gated this session */
+static wav_cue_t file_cues[AUDIO_MAX_GAP_CUES];     /**< Gaps in audio_file */
+static size_t file_cue_count = 0;                   /**< Entries in file_cues */
+
+// Writer-owned level log state
+static FILE* meter_file = NULL;                     /**< Level log (NULL for AUDIO_FORMAT_LOG_ONLY, which logs to audio_file) */
+static bool meter_failed = false;                   /**< Level log could not be written */
+
+// Writer-owned spectral sidecar state
+static FILE* spectrum_file = NULL;                  /**< Sidecar of audio_file, opened at its first record */
+static bool spectrum_failed = false;                /**< Sidecar of audio_file could not be written */
+
+static int16_t filter_buf[AUDIO_BIQUAD_BLOCK * AUDIO_BIQUAD_MAX_CHANNELS];           /**< Filter output */
+static int16_t resample_buf[(AUDIO_RESAMPLER_BLOCK + 1) * AUDIO_RESAMPLER_MAX_CHANNELS]; /**< Decimator output */
+
+/**
+ * @brief Append a contiguous block to the open audio file or raw log session.
+ *
+ * sd_file_write() stages it and writes whole aligned clusters through
+ * FatFs (raw_log_write() whole segments), so block sizes here do not matter.
+ *
+ * @return Bytes written (less than len on error)
+ */
+static size_t sd_write_block(const uint8_t* data, size_t len)
+{
+    size_t written = raw_open ? raw_log_write(data, len) : sd_file_write(audio_file, data, len);
+    if (written != len) {
+        ESP_LOGE(TAG, "SD write error: expected %u, wrote %u", (unsigned)len, (unsigned)written);
+    }
+    return written;
+}
+
+/**
+ * @brief Buffer frames in the encoder of the configured format.
+ * @return Frames taken (stops when the encoder block is full)
+ */
+static size_t encoder_feed(const uint8_t* pcm, size_t frames)
+{
+    switch (rec_config.format) {
+        case AUDIO_FORMAT_FLAC: return flac_encoder_feed(&flac, pcm, frames);
+        default:                return ima_adpcm_encoder_feed(&adpcm, (const int16_t*)pcm, frames);
+    }
+}
+
+/**
+ * @brief Whether the encoder of the configured format has a whole block buffered.
+ */
+static bool encoder_block_full(void)
+{
+    switch (rec_config.format) {
+        case AUDIO_FORMAT_FLAC: return flac_encoder_block_full(&flac);
+        default:                return ima_adpcm_encoder_block_full(&adpcm);
+    }
+}
+
+/**
+ * @brief Encode the frames buffered in the encoder and write them.
+ * @return false on write error
+ */
+static bool flush_encoder(void)
+{
+    const uint8_t* out;
+    size_t len;
+    switch (rec_config.format) {
+        case AUDIO_FORMAT_FLAC: len = flac_encoder_encode(&flac, &out); break;
+        default:                len = ima_adpcm_encoder_encode(&adpcm, &out); break;
+    }
+    return sd_write_block(out, len) == len;
+}
+
+/**
+ * @brief Sidecar path for an audio file: same name with another extension.
+ */
+static void sidecar_filename(char* buf, size_t size, const char* audio_name, const char* extension)
+{
+    const char* dot = strrchr(audio_name, '.');
+    int stem = dot ? (int)(dot - audio_name) : (int)strlen(audio_name);
+    snprintf(buf, size, "%.*s%s", stem, audio_name, extension);
+}
+
+/**
+ * @brief Append a record to the sidecar of the current file, creating it on first use.
+ *
+ * Sidecar errors are logged and stop the sidecar for this file only; the
+ * recording itself carries on.
+ */
+static void spectrum_write(const audio_spectrum_record_t* rec)
+{
+    if (spectrum_failed) return;
+
+    if (!spectrum_file) {
+        char name[sizeof(current_filename)];
+        audio_spectrum_header_t hdr;
+        sidecar_filename(name, sizeof(name), current_filename, AUDIO_SPECTRUM_EXTENSION);
+        audio_spectrum_header(&spectrum, &hdr);
+        spectrum_file = sd_card_open(name, "wb");
+        if (!spectrum_file || fwrite(&hdr, sizeof(hdr), 1, spectrum_file) != 1) {
+            ESP_LOGE(TAG, "Cannot create %s", name);
+            spectrum_failed = true;
+            return;
+        }
+    }
+
+    if (fwrite(rec, sizeof(*rec), 1, spectrum_file) != 1) {
+        ESP_LOGE(TAG, "Spectrum sidecar write error");
+        spectrum_failed = true;
+    }
+}
+
+/**
+ * @brief Analyze stored frames and write every completed record.
+ */
+static void spectrum_store(const uint8_t* data, size_t len)
+{
+    size_t frames = len / out_frame_bytes;
+    while (frames > 0) {
+        size_t n = audio_spectrum_feed(&spectrum, data, frames);
+        data += n * out_frame_bytes;
+        frames -= n;
+
+        audio_spectrum_record_t rec;
+        if (audio_spectrum_record_ready(&spectrum) && audio_spectrum_take(&spectrum, &rec)) spectrum_write(&rec);
+    }
+}
+
+/**
+ * @brief Write the last partial record and close the sidecar of the current file.
+ */
+static void close_spectrum_file(void)
+{
+    audio_spectrum_record_t rec;
+    if (audio_spectrum_take(&spectrum, &rec)) spectrum_write(&rec);
+
+    if (spectrum_file) fclose(spectrum_file);
+    spectrum_file = NULL;
+    spectrum_failed = false;
+    audio_spectrum_reset(&spectrum);
+}
+
+/**
+ * @brief Append one interval to the level log.
+ *
+ * Log errors are reported once and stop the log; the recording carries on.
+ */
+static void meter_write_row(const audio_meter_interval_t* iv)
+{
+    bool in_audio = rec_config.format == AUDIO_FORMAT_LOG_ONLY;  // The log is the recording
+    if ((in_audio ? !audio_file : !meter_file) || meter_failed) return;
+
+    const float cal = rec_config.meter_calibration_db;
+    time_t t = session_start_time + (time_t)(iv->start_frame / rec_config.sample_rate);
+    struct tm tm;
+    char stamp[24];
+    char row[112];
+    localtime_r(&t, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    int len = snprintf(row, sizeof(row), "%s,%.3f,%.1f,%.1f,%.1f,%.1f,%lu\n", stamp,
+                       (double)iv->frames / rec_config.sample_rate, iv->laeq_dbfs + cal, iv->leq_dbfs + cal,
+                       iv->lamax_dbfs + cal, iv->peak_dbfs, (unsigned long)iv->clips);
+
+    bool ok = in_audio ? sd_file_write(audio_file, row, len) == (size_t)len
+                       : fwrite(row, 1, len, meter_file) == (size_t)len;
+    if (!ok) {
+        ESP_LOGE(TAG, "Level log write error");
+        meter_failed = true;
+        return;
+    }
+    if (in_audio) audio_data_bytes += len;
+}
+
+/**
+ * @brief Meter consumed frames, publish block levels and log finished intervals.
+ */
+static void meter_store(const uint8_t* data, size_t len)
+{
+    size_t frames = len / out_frame_bytes;
+    while (frames > 0) {
+        size_t n = audio_meter_feed(&meter, data, frames);
+        data += n * out_frame_bytes;
+        frames -= n;
+
+        audio_meter_interval_t iv;
+        bool logged = audio_meter_interval_ready(&meter) && audio_meter_take(&meter, &iv);
+        if (logged) meter_write_row(&iv);
 
-    if (i2s_channel_init_std_mode(tx_handle, &std_cfg) != ESP_OK) return false;
-    if (i2s_channel_init_std_mode(rx_handle, &std_cfg) != ESP_OK) return false;
+        taskENTER_CRITICAL(&levels_lock);
+        current_levels.block = meter.last_block;
+        current_levels.clips_total = meter.clips_total;
+        if (logged) current_levels.interval = iv;
+        taskEXIT_CRITICAL(&levels_lock);
+    }
+}
+
+/**
+ * @brief Start the level log of a session that has just opened audio_file.
+ */
+static void open_meter_file(void)
+{
+    if (!metering) return;
+
+    audio_meter_reset(&meter);
+    taskENTER_CRITICAL(&levels_lock);
+    memset(&current_levels, 0, sizeof(current_levels));
+    current_levels.block = meter.last_block;
+    taskEXIT_CRITICAL(&levels_lock);
+
+    meter_failed = false;
+    if (rec_config.format == AUDIO_FORMAT_LOG_ONLY) return;  // Rows go to audio_file
+
+    char name[sizeof(current_filename)];
+    sidecar_filename(name, sizeof(name), current_filename, AUDIO_METER_EXTENSION);
+    meter_file = sd_card_open(name, "w");
+    if (!meter_file || fputs(AUDIO_METER_CSV_HEADER, meter_file) < 0) {
+        ESP_LOGE(TAG, "Cannot create %s", name);
+        meter_failed = true;
+    }
+}
+
+/**
+ * @brief Log the last partial interval and close a separate level log.
+ */
+static void close_meter_file(void)
+{
+    if (!metering) return;
+
+    audio_meter_interval_t iv;
+    if (audio_meter_take(&meter, &iv)) {
+        meter_write_row(&iv);
+        taskENTER_CRITICAL(&levels_lock);
+        current_levels.interval = iv;
+        taskEXIT_CRITICAL(&levels_lock);
+    }
+    if (meter_file) fclose(meter_file);
+    meter_file = NULL;
+}
+
+/**
+ * @brief Store whole PCM frames at the output rate, encoding them if needed.
+ * @param data Frames in the stored format
+ * @param len Bytes, a multiple of out_frame_bytes for encoded formats
+ * @return false on write error
+ */
+static bool store_frames(const uint8_t* data, size_t len)
+{
+    if (rec_config.spectrum_enabled) spectrum_store(data, len);
+    if (rec_config.format == AUDIO_FORMAT_LOG_ONLY) return true;
 
-    i2s_channel_enable(tx_handle);
-    i2s_channel_enable(rx_handle);
+    audio_data_bytes += len;
+    if (rec_config.format == AUDIO_FORMAT_WAV) return sd_write_block(data, len) == len;
 
+    size_t frames = len / out_frame_bytes;
+    size_t done = 0;
+    while (done < frames) {
+        done += encoder_feed(data + done * out_frame_bytes, frames - done);
+        if (encoder_block_full() && !flush_encoder()) return false;
+    }
     return true;
 }
 
 /**
- * @brief Deinitialize I2S interface and free resources
+ * @brief Store whole captured frames, filtering and decimating them if configured.
+ * @param data Frames at the capture rate
+ * @param len Bytes, a multiple of out_frame_bytes when filtering, encoding or decimating
+ * @return false on write error
  */
-static void deinit_i2s(void)
+static bool store_audio(const uint8_t* data, size_t len)
 {
-    if (tx_handle) i2s_channel_disable(tx_handle);
-    if (rx_handle) i2s_channel_disable(rx_handle);
-    if (tx_handle) i2s_del_channel(tx_handle);
-    if (rx_handle) i2s_del_channel(rx_handle);
-    tx_handle = rx_handle = NULL;
+    if (!filtering && !resampling) return store_frames(data, len);
+
+    const int16_t* in = (const int16_t*)data;
+    size_t frames = len / out_frame_bytes;
+    while (frames > 0) {
+        size_t n = (frames > AUDIO_BIQUAD_BLOCK) ? AUDIO_BIQUAD_BLOCK : frames;
+        const int16_t* pcm = in;
+        if (filtering) {
+            audio_biquad_process_s16(&filter, in, filter_buf, n);
+            pcm = filter_buf;
+        }
+
+        bool ok;
+        if (resampling) {
+            size_t produced = audio_resampler_process(&resampler, pcm, n, resample_buf);
+            ok = store_frames((const uint8_t*)resample_buf, produced * out_frame_bytes);
+        } else {
+            ok = store_frames((const uint8_t*)pcm, n * out_frame_bytes);
+        }
+        if (!ok) return false;
+
+        in += n * wav_fmt.channels;
+        frames -= n;
+    }
+    return true;
 }
 
-// ==================== PSRAM FUNCTIONS ====================
 /**
- * @brief Allocate PSRAM buffer for recording
- * @return true if allocation succeeded
+ * @brief Append the gap markers of the file after its data chunk (WAV formats only).
+ *
+ * Adds a pad byte if the data chunk has an odd size, then the cue and
+ * LIST/adtl chunks, and grows the RIFF size in header accordingly.
+ *
+ * @param file Audio file, all data written
+ * @param header Final header, updated
+ * @return false on allocation or write error
  */
-static bool init_psram(void)
+static bool append_cue_chunks(sd_file_t* file, uint8_t* header)
 {
-    psram_buffer = (uint16_t*)heap_caps_malloc(PSRAM_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
-    return psram_buffer != NULL;
+    uint64_t data_chunk;
+    switch (rec_config.format) {
+        case AUDIO_FORMAT_WAV:       data_chunk = audio_data_bytes; break;
+        case AUDIO_FORMAT_IMA_ADPCM: data_chunk = (uint64_t)adpcm.blocks * adpcm.block_align; break;
+        default:                     return true;   // No place for markers
+    }
+
+    size_t size = wav_cue_chunks_size(file_cues, file_cue_count);
+    size_t pad = data_chunk & 1;
+    uint8_t* buf = malloc(pad + size);
+    if (!buf) return false;
+
+    buf[0] = 0;
+    wav_build_cue_chunks(buf + pad, file_cues, file_cue_count);
+    bool ok = sd_file_write(file, buf, pad + size) == pad + size;
+    free(buf);
+    if (ok) wav_extend_riff(header, (uint32_t)(pad + size));
+    return ok;
 }
 
 /**
- * @brief Free PSRAM buffer
+ * @brief Write the final header into an open audio file and close it
+ * @param file File returned by create_audio_file(), with all audio written
+ * @param data_size Audio bytes written after the header (PCM WAV)
+ * @return true if the header update succeeded
  */
-static void deinit_psram(void)
+static bool finalize_audio_file(sd_file_t* file, uint64_t data_size)
 {
-    if (psram_buffer) {
-        free(psram_buffer);
-        psram_buffer = NULL;
+    uint8_t header[AUDIO_HEADER_MAX];
+    size_t len = build_header(header, data_size, true);
+
+    bool ok = true;
+    if (file_cue_count > 0) ok = append_cue_chunks(file, header);
+    file_cue_count = 0;
+
+    ok = sd_file_patch(file, 0, header, len) && ok;
+    return sd_file_close(file) && ok;
+}
+
+/**
+ * @brief Flush pending encoded audio, finalize the header and close audio_file (or end the raw log session).
+ * @return false if the file could not be completed
+ */
+static bool close_audio_file(void)
+{
+    bool ok = true;
+    if (rec_config.format == AUDIO_FORMAT_FLAC || rec_config.format == AUDIO_FORMAT_IMA_ADPCM) ok = flush_encoder();
+    if (raw_open) {
+        ok = raw_log_end() && ok;
+        raw_open = false;
+    } else {
+        ok = finalize_audio_file(audio_file, audio_data_bytes) && ok;
+        audio_file = NULL;
     }
+    if (rec_config.spectrum_enabled) close_spectrum_file();
+
+    // The next file starts a new stream
+    flac_encoder_reset(&flac);
+    ima_adpcm_encoder_reset(&adpcm);
+    return ok;
 }
 
-// ==================== WAV HEADER FUNCTIONS ====================
 /**
- * @brief Create WAV file with standard header
- * @param filename Path of WAV file
- * @return true if header creation succeeded
+ * @brief Create the file for the next segment ahead of time.
+ *
+ * Runs in the writer right after a rollover so the FAT directory work is
+ * done while the ring buffers audio, not at the segment boundary.
  */
-static bool create_wav_header(const char* filename)
+static void prepare_next_file(void)
 {
-    uint8_t header[44] = {
-        'R','I','F','F', 0,0,0,0, 'W','A','V','E',
-        'f','m','t',' ', 16,0,0,0, 1,0, 1,0,
-        0x44,0xAC,0,0, 0x88,0x58,0x01,0, 2,0, 16,0,
-        'd','a','t','a', 0,0,0,0
-    };
+    if (!name_cb || next_file) return;
+
+    name_cb(next_filename, sizeof(next_filename), next_start_time);
+    if (rec_config.raw_log) return;     // Only the name: raw log sessions start at the rollover itself
+    next_file = create_audio_file(next_filename);
+    if (!next_file) ESP_LOGE(TAG, "Cannot pre-create %s", next_filename);
+}
+
+/**
+ * @brief Finalize the current segment and continue in the pre-created file.
+ *
+ * With the raw log each segment becomes a raw log session of its own,
+ * extracted later under the file name it would have had.
+ *
+ * @return false if the next file could not be opened
+ */
+static bool rollover_file(void)
+{
+    bool ok = close_audio_file();
+    ESP_LOGI(TAG, "Rollover: %s closed (%llu bytes)", current_filename, audio_data_bytes);
+    // With the activity gate a whole segment can pass without anything worth keeping
+    if (audio_data_bytes == 0 && !rec_config.raw_log) sd_card_remove(current_filename);
+
+    prepare_next_file();  // Normally already done; retry if it failed earlier
+    if (rec_config.raw_log) {
+        raw_open = raw_log_begin(next_filename, next_start_time, &wav_fmt);
+    } else {
+        audio_file = next_file;
+        next_file = NULL;
+    }
+    strcpy(current_filename, next_filename);
+    audio_data_bytes = 0;
+    segment_consumed = 0;
+    next_start_time += segment_seconds;
+    last_checkpoint_us = esp_timer_get_time();
+
+    prepare_next_file();
+    return ok && output_open();
+}
+
+/**
+ * @brief Mark a gap at the current position of audio_file.
+ *
+ * The position is where the next stored frame will go; with decimation
+ * the length is converted to stored frames.
+ */
+static void record_gap(const gap_event_t* ev)
+{
+    static const char* const causes[] = { "short I2S read", "I2S DMA overflow", "ring overrun" };
+    uint32_t position = (uint32_t)(audio_data_bytes / out_frame_bytes);
+    uint32_t length = (uint32_t)((uint64_t)ev->frames * wav_fmt.sample_rate / rec_config.sample_rate);
+
+    ESP_LOGW(TAG, "Gap of %lu frames (%s) at frame %lu of %s", (unsigned long)ev->frames, causes[ev->cause],
+             (unsigned long)position, current_filename);
+    if (!audio_file || file_cue_count == AUDIO_MAX_GAP_CUES) return;
+
+    wav_cue_t* cue = &file_cues[file_cue_count++];
+    cue->id = (uint32_t)file_cue_count;
+    cue->position = position;
+    cue->length = length;
+    snprintf(cue->label, sizeof(cue->label), "%s, %lu frames", causes[ev->cause], (unsigned long)ev->frames);
+}
 
-    sd_card_init();
-    FILE* file = sd_card_open(filename, "wb");
-    if (!file) { sd_card_deinit(); return false; }
+/**
+ * @brief Record gaps already reached and limit a read so it stops at the next one.
+ * @param available Bytes the caller wants to consume
+ * @return Bytes that can be consumed before the next gap
+ */
+static size_t gap_limit(size_t available)
+{
+    gap_event_t ev;
+    while (xQueuePeek(gap_queue, &ev, 0) == pdTRUE) {
+        uint64_t gap_byte = ev.position * out_frame_bytes;
+        if (gap_byte > ring_bytes_consumed) {
+            uint64_t room = gap_byte - ring_bytes_consumed;
+            return (room < available) ? (size_t)room : available;
+        }
+        xQueueReceive(gap_queue, &ev, 0);
+        record_gap(&ev);
+        gap_bytes += (uint64_t)ev.frames * out_frame_bytes;
+    }
+    return available;
+}
 
-    fwrite(header, 1, 44, file);
-    fclose(file);
-    sd_card_deinit();
+/**
+ * @brief Count bytes towards the segment, rolling over at every boundary reached.
+ *
+ * A gap may end the segment or span several: the file ends at the
+ * boundary, files of segments entirely inside the gap are removed empty
+ * by rollover_file(), and the rest counts towards the next segment.
+ *
+ * @param bytes Ring bytes consumed or lost since the last call
+ * @return false on rollover error
+ */
+static bool segment_advance(uint64_t bytes)
+{
+    if (!segment_bytes) return true;
+    segment_consumed += bytes;
+    while (segment_consumed >= segment_bytes) {
+        uint64_t carry = segment_consumed - segment_bytes;
+        if (!rollover_file()) return false;
+        segment_consumed = carry;
+    }
     return true;
 }
 
 /**
- * @brief Update WAV header with final file size
- * @param filename Path of WAV file
- * @return true if update succeeded
+ * @brief Take len bytes from the ring, writing or discarding them.
+ *
+ * Both count towards the segment length, and so do the frames of gaps
+ * (which never reached the ring), so rollover and file names stay on
+ * wall-clock boundaries even when the activity gate or an overrun drops audio.
+ *
+ * @param len Bytes to consume
+ * @param write Write the bytes to audio_file (false discards them)
+ * @return false on write or rollover error
  */
-static bool update_wav_header(const char* filename)
+static bool sd_consume(size_t len, bool write)
 {
-    sd_card_init();
-    FILE* file = sd_card_open(filename, "rb+");
-    if (!file) { sd_card_deinit(); return false; }
+    const uint8_t* data;
+    size_t available;
+    uint8_t frame[2 * sizeof(int32_t)];
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    if (file_size < 44) { fclose(file); sd_card_deinit(); return false; }
+    while (len > 0 && (available = audio_ring_read_ptr(&ring, &data)) > 0) {
+        if (available > len) available = len;
+        if (available > SD_CHUNK_SIZE) available = SD_CHUNK_SIZE;
+        available = gap_limit(available);   // Stop on the gap so its marker lands on the exact frame
+        uint64_t gap = gap_bytes;
+        gap_bytes = 0;
+        if (!segment_advance(gap)) return false;
+        if (segment_bytes && available > segment_bytes - segment_consumed) {
+            available = (size_t)(segment_bytes - segment_consumed);
+        }
 
-    uint32_t data_size = file_size - 44;
-    uint32_t riff_size = data_size + 36;
+        if (metering || (write && (rec_config.format != AUDIO_FORMAT_WAV || resampling || filtering || rec_config.spectrum_enabled))) {
+            // The meter, encoders, filters, the decimator and the analyzer take whole frames; a 24-bit frame can straddle the end of the ring
+            available -= available % out_frame_bytes;
+            if (available == 0) {
+                audio_ring_peek(&ring, 0, frame, out_frame_bytes);
+                data = frame;
+                available = out_frame_bytes;
+            }
+        }
 
-    fseek(file, 4, SEEK_SET);  fwrite(&riff_size, 1, 4, file);
-    fseek(file, 40, SEEK_SET); fwrite(&data_size, 1, 4, file);
+        if (metering) meter_store(data, available);   // Everything captured, including gated audio
+        bool stored = !write || store_audio(data, available);
+        ring_bytes_consumed += available;
+        audio_ring_release(&ring, available);
+        len -= available;
+        if (!stored || !segment_advance(available)) return false;
+    }
 
-    fclose(file);
-    sd_card_deinit();
     return true;
 }
 
-// ==================== SD TASKS ====================
 /**
- * @brief Task to initialize SD write
+ * @brief Write ring contents to the open audio file, rolling over at segment_bytes.
+ * @param min_bytes Do nothing while less than this many bytes are pending (1 drains everything)
+ * @return false on write error
+ */
+static bool sd_drain_ring(size_t min_bytes)
+{
+    size_t used = audio_ring_used(&ring);
+    if (used == 0 || used < min_bytes) return true;
+    return sd_consume(used, true);
+}
+
+/**
+ * @brief Convert the activity gate timings to ring byte counts.
+ *
+ * Must run after init_psram(): the pre-roll is held in the ring, so it is
+ * capped to half the ring to leave room for the writer to fall behind.
  */
-static void sd_init_task(void* parameter)
+static void init_trigger(void)
 {
-    sd_card_init();
-    audio_file = sd_card_open(current_filename, "ab");
-    if (!audio_file) { sd_card_deinit(); vTaskDelete(NULL); return; }
+    uint64_t rate = rec_config.sample_rate;
+    trigger_block_bytes = BUF_LEN * out_frame_bytes;
+    pre_roll_bytes = (size_t)(rec_config.pre_roll_ms * rate / 1000) * out_frame_bytes;
+    post_roll_bytes = (size_t)(rec_config.post_roll_ms * rate / 1000) * out_frame_bytes;
+
+    size_t max_pre_roll = (psram_buffer_size / 2) / out_frame_bytes * out_frame_bytes;
+    if (pre_roll_bytes > max_pre_roll) {
+        ESP_LOGW(TAG, "Pre-roll limited to %u ms by the ring size",
+                 (unsigned)((uint64_t)max_pre_roll / out_frame_bytes * 1000 / rec_config.sample_rate));
+        pre_roll_bytes = max_pre_roll;
+    }
 
-    current_state = RECORDER_STATE_RECORDING;
-    sd_write_pos = 0;
-    time_recording = esp_timer_get_time() / 1000;
+    if (rec_config.trigger_enabled) {
+        ESP_LOGI(TAG, "Activity gate: %.1f dBFS above %lu Hz, pre-roll %lu ms, post-roll %lu ms",
+                 rec_config.trigger_threshold_dbfs, (unsigned long)rec_config.trigger_highpass_hz,
+                 (unsigned long)rec_config.pre_roll_ms, (unsigned long)rec_config.post_roll_ms);
+    }
+}
 
-    vTaskDelete(NULL);
+/**
+ * @brief Reset the activity gate for a new session.
+ */
+static void gate_reset(void)
+{
+    audio_trigger_init(&trigger, rec_config.sample_rate, rec_config.trigger_highpass_hz);
+    scanned_bytes = 0;
+    gate_bytes = 0;
+    trigger_events = 0;
+    frames_gated = 0;
 }
 
 /**
- * @brief Task to write entire PSRAM buffer to SD card and measure elapsed time
+ * @brief Analyze new blocks and write only the audio around activity.
+ *
+ * The ring is split at tail + scanned_bytes: data before it has been
+ * analyzed, data after it has not. Every block above the threshold
+ * extends gate_bytes to the block end plus the post-roll. While the gate
+ * is closed, analyzed data older than the pre-roll is released unwritten,
+ * so the ring always holds the pre-roll that precedes the next trigger.
+ *
+ * @param flush Session end: decide on everything left in the ring
+ * @return false on write error
  */
-static void sd_write_task(void* parameter)
+static bool sd_gate_ring(bool flush)
 {
-    #define BLOCK_SD_WRITE (1024 * 3)  // 3 KB blocks like Arduino
+    size_t used = audio_ring_used(&ring);
+
+    while (used - scanned_bytes >= trigger_block_bytes) {
+        audio_ring_peek(&ring, scanned_bytes, trigger_buf, trigger_block_bytes);
+        float level = audio_trigger_level_dbfs(&trigger, trigger_buf, BUF_LEN, &wav_fmt);
+        scanned_bytes += trigger_block_bytes;
+
+        if (level >= rec_config.trigger_threshold_dbfs) {
+            if (gate_bytes == 0) {
+                trigger_events++;
+                ESP_LOGI(TAG, "Activity at %.1f dBFS, gate open", level);
+            }
+            gate_bytes = scanned_bytes + post_roll_bytes;
+        }
+    }
+    if (flush) scanned_bytes = used;  // The trailing partial block follows the current decision
 
-    size_t total_written = 0;
+    size_t to_write = (gate_bytes < scanned_bytes) ? gate_bytes : scanned_bytes;
+    if (to_write > 0) {
+        bool ok = sd_consume(to_write, true);
+        scanned_bytes -= to_write;
+        gate_bytes -= to_write;
+        if (!ok) return false;
+        if (gate_bytes == 0) ESP_LOGI(TAG, "Gate closed");
+    }
 
-    ESP_LOGI(TAG, "Starting SD write of PSRAM buffer (%u bytes)...", PSRAM_BUFFER_SIZE);
+    size_t keep = flush ? 0 : pre_roll_bytes;
+    if (gate_bytes == 0 && scanned_bytes > keep) {
+        size_t drop = scanned_bytes - keep;
+        bool ok = sd_consume(drop, false);
+        frames_gated += drop / out_frame_bytes;
+        scanned_bytes = keep;
+        if (!ok) return false;
+    }
 
-    while (sd_write_pos < PSRAM_BUFFER_SIZE) {
-        size_t available_bytes = PSRAM_BUFFER_SIZE - sd_write_pos;
-        size_t bytes_to_write = (available_bytes < BLOCK_SD_WRITE) ? available_bytes : BLOCK_SD_WRITE;
+    return true;
+}
 
-        size_t written = fwrite((uint8_t*)psram_buffer + sd_write_pos, 1, bytes_to_write, audio_file);
-        if (written != bytes_to_write) {
-            ESP_LOGE(TAG, "SD write error: expected %u, wrote %u", (unsigned)bytes_to_write, (unsigned)written);
-            break;
+/**
+ * @brief Move pending ring data to the file, through the activity gate if enabled.
+ * @param flush Session end: consume everything left in the ring
+ * @return false on write error
+ */
+static bool sd_process_ring(bool flush)
+{
+    if (rec_config.trigger_enabled) return sd_gate_ring(flush);
+    return sd_drain_ring(flush ? 1 : SD_CHUNK_SIZE);
+}
+
+/**
+ * @brief Flush a file's stdio buffer and commit it (data and FAT entry) to the card.
+ */
+static bool sync_file(FILE* file)
+{
+    return fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+/**
+ * @brief Make the open files valid as they stand, in case power is lost.
+ *
+ * Writes the header describing the audio stored so far over the
+ * provisional one on the open handle, then syncs the audio file and the
+ * sidecars. A raw log session writes its partial segment and superblock. Encoder input not yet encoded into a block is not covered.
+ * Gap markers are only appended at close.
+ *
+ * @return false if the audio file could not be updated
+ */
+static bool checkpoint_files(void)
+{
+    bool ok = true;
+    if (raw_open) {
+        ok = raw_log_checkpoint();
+    } else {
+        if (rec_config.format != AUDIO_FORMAT_LOG_ONLY) {
+            uint8_t header[AUDIO_HEADER_MAX];
+            size_t len = build_header(header, audio_data_bytes, true);
+            ok = sd_file_patch(audio_file, 0, header, len);
         }
+        ok = ok && sd_file_sync(audio_file);
+    }
+
+    if (meter_file) sync_file(meter_file);
+    if (spectrum_file) sync_file(spectrum_file);
+
+    last_checkpoint_us = esp_timer_get_time();
+    checkpoints++;
+    if (!ok) ESP_LOGE(TAG, "Header checkpoint of %s failed", current_filename);
+    return ok;
+}
+
+/**
+ * @brief Checkpoint the open files if checkpoint_interval_s has elapsed.
+ */
+static bool checkpoint_if_due(void)
+{
+    if (rec_config.checkpoint_interval_s == 0) return true;
+    if (esp_timer_get_time() - last_checkpoint_us < (int64_t)rec_config.checkpoint_interval_s * 1000000) return true;
+    return checkpoint_files();
+}
 
-        sd_write_pos += written;
-        total_written += written;
+// ==================== I/O STATISTICS ====================
+/**
+ * @brief sd_file_t write hook: time one card access.
+ *
+ * Runs on the writer task (core 1, so the cycle counter is the same one
+ * before and after the call). The ring fill right after a stall is the
+ * backlog the stall built up, i.e. how close it came to an overrun.
+ */
+static void on_card_write(size_t bytes, uint32_t cycles)
+{
+    uint32_t us = cycles / cycles_per_us;
+    latency_histogram_add(&write_latency, us);
+    io_bytes += bytes;
+    io_busy_us += us;
+    if (us >= SD_STALL_US) {
+        io_stalls++;
+        uint32_t fill = audio_ring_used(&ring);
+        if (fill > stall_ring_max) stall_ring_max = fill;
     }
+}
 
-    fflush(audio_file);
-    fclose(audio_file);
-    sd_card_deinit();
-    ESP_LOGI(TAG, "SD unmounted");
+static void reset_io_stats(void)
+{
+    latency_histogram_reset(&write_latency);
+    io_bytes = io_busy_us = 0;
+    io_stalls = stall_ring_max = 0;
+    io_start_us = esp_timer_get_time();
+    io_end_us = 0;
+}
 
-    // Reset state and positions (same as Arduino)
-    current_state = RECORDER_STATE_IDLE;
-    i2s_write_pos = 0;
-    sd_write_pos = 0;
-    cycle_count = 0;
+/**
+ * @brief Session length so far, or in full once closed.
+ */
+static int64_t io_elapsed_us(void)
+{
+    return (io_end_us ? io_end_us : esp_timer_get_time()) - io_start_us;
+}
+
+/**
+ * @brief Append the session's I/O record to IO_STATS_FILE.
+ *
+ * Written with stdio after the audio is closed, so it is not part of the
+ * figures it reports. A missing record is only logged.
+ */
+static void save_io_stats(void)
+{
+    audio_recorder_stats_t st;
+    audio_recorder_get_stats(&st);
+
+    bool exists = sd_card_exists(IO_STATS_FILE);
+    FILE* f = sd_card_open(IO_STATS_FILE, "a");
+    if (!f) {
+        ESP_LOGE(TAG, "Cannot open %s", IO_STATS_FILE);
+        return;
+    }
+    if (!exists) {
+        fputs("start,file,seconds,card_bytes,kbps,busy_kbps,writes,p50_us,p95_us,p99_us,max_us,"
+              "stalls,stall_ring_max,ring_size,ring_high_water,overrun_frames\n", f);
+    }
 
-    // Time taken to write PSRAM to SD
-    uint64_t write_time = (esp_timer_get_time() / 1000) - time_recording;
-    ESP_LOGI(TAG, "Finished SD write: %u bytes in %.2f seconds", (unsigned)total_written, write_time / 1000.0);
+    char start[24];
+    struct tm tm_info;
+    localtime_r(&session_start_time, &tm_info);
+    strftime(start, sizeof(start), "%Y-%m-%d %H:%M:%S", &tm_info);
+    uint32_t busy_kbps = (uint32_t)(io_bytes * 1000000 / 1024 / (io_busy_us + 1));
 
-    vTaskDelete(NULL);
+    int n = fprintf(f, "%s,%s,%.1f,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+                    start, current_filename, io_elapsed_us() / 1e6, st.card_bytes,
+                    (unsigned)st.write_kbps, (unsigned)busy_kbps, (unsigned)st.card_writes,
+                    (unsigned)st.write_p50_us, (unsigned)st.write_p95_us, (unsigned)st.write_p99_us,
+                    (unsigned)st.write_max_us, (unsigned)st.write_stalls, (unsigned)st.stall_ring_max,
+                    (unsigned)st.ring_size, (unsigned)st.ring_high_water, (unsigned)st.overrun_frames);
+    if (n < 0) ESP_LOGE(TAG, "Cannot write %s", IO_STATS_FILE);
+    sd_card_close(f);
 }
 
-// ==================== AUDIO LOGIC ====================
 /**
- * @brief Read samples from I2S into PSRAM
+ * @brief Finalize the current file, discard an unused pre-created one and release the card.
+ * @return false if the header could not be finalized
  */
-static void I2S_read(void)
+static bool close_session_files(void)
 {
-    size_t readsize = 0, written = 0;
-    i2s_channel_read(rx_handle, rx_buf, sizeof(rx_buf), &readsize, 1000);
-    i2s_channel_write(tx_handle, rx_buf, readsize, &written, 100);
+    bool ok = true;
 
-    for (size_t i = 0; i < readsize / 2; i += 2) {
-        psram_buffer[i2s_write_pos] = rx_buf[i];
-        if (++i2s_write_pos == PSRAM_BUFFER_SIZE / sizeof(uint16_t)) i2s_write_pos = 0;
+    close_meter_file();
+    if (output_open()) {
+        ok = close_audio_file();
+        // A continuous session that stopped exactly on a boundary leaves an empty segment
+        if (name_cb && audio_data_bytes == 0 && !rec_config.raw_log) sd_card_remove(current_filename);
+    }
+    if (next_file) {
+        sd_file_close(next_file);
+        next_file = NULL;
+        sd_card_remove(next_filename);
     }
+    io_end_us = esp_timer_get_time();
+    save_io_stats();
+    sd_card_release();
+    return ok;
 }
 
 /**
- * @brief Handle SD write based on recorder state
+ * @brief Long-lived task that drains the ring to SD in SD_CHUNK_SIZE chunks.
+ *
+ * Woken by task notifications from the capture loop every SD_CHUNK_SIZE
+ * bytes captured, and by writer commands posted to writer_queue.
  */
-static void SD_write(void)
+static void sd_writer_task(void* parameter)
 {
-    switch (current_state) {
-        case RECORDER_STATE_IDLE:
-            if (cycle_count == (MAX_CICLE_COUNT - 10)) {
-                xTaskCreatePinnedToCore(sd_init_task, "sd_init_task", 10000, NULL, 1, &sd_task_handle, 1);
+    bool write_error = false;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        writer_cmd_t cmd;
+        while (xQueueReceive(writer_queue, &cmd, 0) == pdTRUE) {
+            switch (cmd) {
+                case WRITER_CMD_OPEN:
+                    current_state = RECORDER_STATE_INIT_SD;
+                    sd_card_acquire();
+                    audio_data_bytes = 0;
+                    segment_consumed = 0;
+                    gap_bytes = 0;
+                    ring_bytes_consumed = 0;
+                    file_cue_count = 0;
+                    last_checkpoint_us = esp_timer_get_time();
+                    reset_io_stats();
+                    gate_reset();
+                    if (resampling) audio_resampler_reset(&resampler);
+                    if (filtering) audio_biquad_reset(&filter);
+                    if (rec_config.raw_log) raw_open = raw_log_begin(current_filename, session_start_time, &wav_fmt);
+                    else audio_file = create_audio_file(current_filename);
+                    if (!output_open()) {
+                        ESP_LOGE(TAG, "Cannot create %s", current_filename);
+                        sd_card_release();
+                    } else {
+                        open_meter_file();
+                        prepare_next_file();
+                    }
+                    writer_ok = output_open();
+                    write_error = false;
+                    current_state = writer_ok ? RECORDER_STATE_RECORDING : RECORDER_STATE_IDLE;
+                    xSemaphoreGive(writer_done);
+                    break;
+
+                case WRITER_CMD_CLOSE:
+                    writer_ok = !write_error;
+                    if (output_open()) {
+                        current_state = RECORDER_STATE_WRITING_SD;
+                        writer_ok = sd_process_ring(true) && writer_ok;
+                        gap_limit(SIZE_MAX);    // Gaps at the very end of the session
+                        writer_ok = close_session_files() && writer_ok;
+                    }
+                    current_state = RECORDER_STATE_IDLE;
+                    xSemaphoreGive(writer_done);
+                    break;
+
+                case WRITER_CMD_EXIT:
+                    xSemaphoreGive(writer_done);
+                    vTaskDelete(NULL);
+                    return;
             }
-            break;
+        }
 
-        case RECORDER_STATE_RECORDING:
-            xTaskCreatePinnedToCore(sd_write_task, "sd_write_task", 10000, NULL, 1, &sd_task_handle, 1);
+        if (output_open() && !(sd_process_ring(false) && checkpoint_if_due())) {
+            ESP_LOGE(TAG, "SD write failed, ending the session");
+            write_error = true;
+            close_session_files();
+            sd_card_unmount();          // Remount from scratch for the next session
             current_state = RECORDER_STATE_IDLE;
-            break;
+            // Nothing stores audio any more: hand control back to the caller of run_session()
+            stop_requested = true;
+            xSemaphoreGive(capture_done);
+        }
+    }
+}
+
+/**
+ * @brief Post a command to the SD writer and wait for it to complete.
+ * @param cmd Command to execute
+ * @return Result reported by the writer
+ */
+static bool writer_command(writer_cmd_t cmd)
+{
+    xQueueSend(writer_queue, &cmd, portMAX_DELAY);
+    xTaskNotifyGive(sd_task_handle);
+    xSemaphoreTake(writer_done, portMAX_DELAY);
+    return writer_ok;
+}
+
+/**
+ * @brief Create the SD writer task and its synchronization objects.
+ * @return true on success
+ */
+static bool init_writer(void)
+{
+    writer_queue = xQueueCreate(WRITER_QUEUE_LEN, sizeof(writer_cmd_t));
+    writer_done = xSemaphoreCreateBinary();
+    gap_queue = xQueueCreate(GAP_QUEUE_LEN, sizeof(gap_event_t));
+    if (!writer_queue || !writer_done || !gap_queue) return false;
+
+    cycles_per_us = esp_rom_get_cpu_ticks_per_us();
+    if (cycles_per_us == 0) cycles_per_us = 1;
+    sd_card_set_write_hook(on_card_write);
+
+    return xTaskCreatePinnedToCore(sd_writer_task, "sd_writer_task", WRITER_TASK_STACK, NULL,
+                                   WRITER_TASK_PRIORITY, &sd_task_handle, 1) == pdPASS;
+}
+
+/**
+ * @brief Stop the SD writer task and free its synchronization objects.
+ */
+static void deinit_writer(void)
+{
+    if (sd_task_handle) {
+        writer_command(WRITER_CMD_EXIT);
+        sd_task_handle = NULL;
+    }
+    sd_card_set_write_hook(NULL);
+    if (writer_queue) { vQueueDelete(writer_queue); writer_queue = NULL; }
+    if (writer_done) { vSemaphoreDelete(writer_done); writer_done = NULL; }
+    if (gap_queue) { vQueueDelete(gap_queue); gap_queue = NULL; }
+}
+
+// ==================== AUDIO LOGIC ====================
+/**
+ * @brief Queue the open gap for the SD writer.
+ *
+ * Must happen before any frame after the gap is committed, so the writer
+ * always learns about a gap before it reaches its position.
+ *
+ * @param woken Set if a higher-priority task was woken (ISR), NULL in task context
+ */
+static void flush_gap(BaseType_t* woken)
+{
+    if (!gap_pending) return;
+    gap_pending = false;
+
+    // If the queue is full the gap is still counted in the stats; only its marker is lost
+    if (woken) xQueueSendFromISR(gap_queue, &gap_open, woken);
+    else xQueueSend(gap_queue, &gap_open, 0);
+}
+
+/**
+ * @brief Record frames missing at the current ring position.
+ *
+ * Consecutive gaps of the same cause with nothing committed in between
+ * (a ring that stays full, a stalled bus) merge into one event.
+ *
+ * @param cause gap_cause_t
+ * @param frames Missing frames
+ * @param woken Set if a higher-priority task was woken (ISR), NULL in task context
+ */
+static void note_gap(gap_cause_t cause, uint32_t frames, BaseType_t* woken)
+{
+    if (frames == 0) return;
+    gap_frames += frames;
+
+    if (gap_pending && gap_open.position == frames_committed && gap_open.cause == cause) {
+        gap_open.frames += frames;
+        return;
+    }
+
+    flush_gap(woken);
+    gap_open = (gap_event_t){ .position = frames_committed, .frames = frames, .cause = (uint8_t)cause };
+    gap_pending = true;
+    gap_events++;
+}
+
+/**
+ * @brief Convert I2S stereo frames to the recorded format and commit them to the ring.
+ *
+ * Runs in task context (polled mode) or in the I2S ISR (DMA callback mode),
+ * where only the ISR-safe kernel may be used. Frames that do not fit are
+ * dropped, counted as overrun and recorded as a gap.
+ *
+ * @param src I2S stereo frames
+ * @param frames Number of frames in src
+ * @param from_isr Called from the I2S ISR
+ * @param woken Set if a higher-priority task was woken (ISR), NULL in task context
+ */
+static void push_frames(const uint8_t* src, size_t frames, bool from_isr, BaseType_t* woken)
+{
+    capture_kernel_t kernel = from_isr ? capture_kernel_isr : capture_kernel;
+
+    size_t dropped = 0;
+    size_t space = audio_ring_free(&ring) / out_frame_bytes;
+    if (frames > space) {
+        dropped = frames - space;
+        audio_ring_note_overrun(&ring, dropped);
+        frames = space;
+    }
+    if (frames > 0) flush_gap(woken);
+
+    size_t i = 0;
+    while (i < frames) {
+        uint8_t* ptr;
+        size_t chunk = audio_ring_write_ptr(&ring, &ptr) / out_frame_bytes;
+
+        if (chunk == 0) {
+            // 24-bit frames can straddle the end of the ring storage
+            uint8_t frame[2 * sizeof(int32_t)];
+            kernel(frame, src + i * in_frame_bytes, 1);
+            audio_ring_push(&ring, frame, out_frame_bytes);
+            i++;
+            continue;
+        }
+
+        if (chunk > frames - i) chunk = frames - i;
+        kernel(ptr, src + i * in_frame_bytes, chunk);
+        audio_ring_commit(&ring, chunk * out_frame_bytes);
+        i += chunk;
+    }
+
+    frames_committed += frames;
+    note_gap(GAP_RING_OVERRUN, dropped, woken);
+}
+
+/**
+ * @brief Take a block of I2S frames into the session, up to the session length.
+ *
+ * Frames past session_frames are discarded, so a session always ends on
+ * an exact frame count regardless of DMA block size or loop timing.
+ *
+ * @param src I2S stereo frames
+ * @param frames Number of frames in src
+ * @param from_isr Called from the I2S ISR
+ * @param woken Set if a higher-priority task was woken (ISR), NULL in task context
+ * @return true once the session frame count has been reached
+ */
+static bool capture_block(const uint8_t* src, size_t frames, bool from_isr, BaseType_t* woken)
+{
+    uint64_t remaining = session_frames - frames_captured;
+    if (frames > remaining) frames = (size_t)remaining;
+
+    push_frames(src, frames, from_isr, woken);
+    frames_captured += frames;
+    notify_pending += frames * out_frame_bytes;
+
+    return frames_captured >= session_frames;
+}
+
+/**
+ * @brief Whether another SD_CHUNK_SIZE bytes were captured since the last wake-up.
+ *
+ * Counting captured bytes rather than checking the fill level keeps the
+ * writer from being woken on every block when the ring intentionally holds
+ * data back (activity pre-roll) or the writer is behind.
+ */
+static bool writer_wake_due(void)
+{
+    if (notify_pending < SD_CHUNK_SIZE) return false;
+    notify_pending = 0;
+    return true;
+}
+
+/**
+ * @brief Read samples from I2S and push them into the ring
+ * @return true once the session frame count has been reached
+ */
+static bool I2S_read(void)
+{
+    size_t readsize = 0;
+    esp_err_t err = audio_hal_i2s_read(rx_buf, sizeof(rx_buf), &readsize, 1000);
+
+    // Buffers the driver dropped before this read are older than its data
+    uint32_t lost = atomic_exchange_explicit(&dma_overflow_bytes, 0, memory_order_relaxed);
+    note_gap(GAP_DMA_OVERFLOW, lost / in_frame_bytes, NULL);
+    if (err != ESP_OK || (readsize < sizeof(rx_buf) && !stop_requested)) {
+        // The rest of the buffer did not arrive within the timeout: at least that much is missing
+        // (a read that ends short with the session, as the host simulator's last one does, is not a gap)
+        short_reads++;
+        ESP_LOGW(TAG, "Short I2S read: %u of %u bytes (%s)", (unsigned)readsize, (unsigned)sizeof(rx_buf),
+                 esp_err_to_name(err));
+        note_gap(GAP_SHORT_READ, (sizeof(rx_buf) - readsize) / in_frame_bytes, NULL);
+    }
+
+    bool finished = capture_block((const uint8_t*)rx_buf, readsize / in_frame_bytes, false, NULL);
+
+    if (writer_wake_due()) {
+        xTaskNotifyGive(sd_task_handle);
+    }
+    return finished;
+}
+
+/**
+ * @brief I2S receive callback: convert frames straight from the DMA buffer.
+ *
+ * Called from the I2S ISR each time a DMA buffer (BUF_LEN frames) completes,
+ * so no rx_buf copy is made. The DMA buffer is only valid during the call.
+ * The ISR is not IRAM-safe (CONFIG_I2S_ISR_IRAM_SAFE off), which is what
+ * allows it to write into the PSRAM ring.
+ *
+ * @return true if the SD writer was woken and a context switch is needed
+ */
+static bool i2s_on_recv(const void* data, size_t size)
+{
+    if (!capture_active) return false;
+
+    BaseType_t woken = pdFALSE;
+    if (capture_block((const uint8_t*)data, size / in_frame_bytes, true, &woken)) {
+        capture_active = false;
+        xSemaphoreGiveFromISR(capture_done, &woken);
+    }
 
-        default: break;
+    if (writer_wake_due()) {
+        vTaskNotifyGiveFromISR(sd_task_handle, &woken);
     }
+    return woken == pdTRUE;
+}
+
+/**
+ * @brief I2S receive queue overflow (polled mode): the driver dropped a DMA buffer.
+ *
+ * Only accumulates the size; I2S_read() turns it into a gap so that all
+ * gap state stays in one context.
+ */
+static void i2s_on_recv_q_ovf(size_t size)
+{
+    atomic_fetch_add_explicit(&dma_overflow_bytes, size, memory_order_relaxed);
+    dma_overflows++;
 }
 
 // ==================== PUBLIC API ====================
+/**
+ * @brief Allocate the session resources in dependency order.
+ * @return false at the first failure; release_resources() frees what was allocated
+ */
+static bool init_resources(void)
+{
+    capture_done = xSemaphoreCreateBinary();
+    if (!capture_done) return false;
+
+    if (!init_psram()) return false;
+    init_trigger();
+    if (!init_encoder()) {
+        ESP_LOGE(TAG, "Cannot allocate the encoder");
+        return false;
+    }
+    init_filter();
+    init_meter();
+    if (resampling && !audio_resampler_init(&resampler, rec_config.sample_rate, wav_fmt.sample_rate, wav_fmt.channels)) {
+        ESP_LOGE(TAG, "Unsupported decimation %lu -> %lu Hz",
+                 (unsigned long)rec_config.sample_rate, (unsigned long)wav_fmt.sample_rate);
+        return false;
+    }
+    if (rec_config.spectrum_enabled && !audio_spectrum_init(&spectrum, &wav_fmt)) {
+        ESP_LOGE(TAG, "Cannot allocate the spectral analyzer");
+        return false;
+    }
+    return init_writer() && init_i2s();
+}
+
+/**
+ * @brief Free everything init_resources() allocates; safe after a partial init.
+ */
+static void release_resources(void)
+{
+    audio_hal_i2s_deinit();
+    deinit_writer();
+    deinit_psram();
+    flac_encoder_free(&flac);
+    ima_adpcm_encoder_free(&adpcm);
+    audio_resampler_free(&resampler);
+    audio_spectrum_free(&spectrum);
+    if (capture_done) { vSemaphoreDelete(capture_done); capture_done = NULL; }
+}
+
 /**
  * @brief Initialize audio recorder
+ * @param config Recording format and capture mode, NULL for AUDIO_RECORDER_DEFAULT_CONFIG()
  * @return true on success
  */
-bool audio_recorder_init(void)
+bool audio_recorder_init(const audio_recorder_config_t* config)
 {
-    if (!init_psram()) return false;
-    if (!init_i2s()) { deinit_psram(); return false; }
+    audio_recorder_config_t defaults = AUDIO_RECORDER_DEFAULT_CONFIG();
+    if (!apply_config(config ? config : &defaults)) {
+        ESP_LOGE(TAG, "Unsupported recorder configuration");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Recording %lu Hz, %u-bit, %u channel(s) to %s, stored at %lu Hz",
+             (unsigned long)rec_config.sample_rate, rec_config.bits_per_sample, rec_config.channels,
+             audio_recorder_file_extension(rec_config.format), (unsigned long)wav_fmt.sample_rate);
 
-    i2s_write_pos = sd_write_pos = cycle_count = 0;
+    if (!init_resources()) {
+        release_resources();
+        return false;
+    }
+
+    audio_ring_reset(&ring);
     current_state = RECORDER_STATE_IDLE;
     current_filename[0] = '\0';
     return true;
 }
 
+/**
+ * @brief Capture until session_frames have been taken or a stop is requested
+ */
+static void run_capture(void)
+{
+    if (rec_config.capture_mode == CAPTURE_MODE_DMA_CALLBACK) {
+        xSemaphoreTake(capture_done, 0);
+        capture_active = true;
+        while (!stop_requested && xSemaphoreTake(capture_done, pdMS_TO_TICKS(100)) != pdTRUE) {
+        }
+        capture_active = false;
+        // Let a callback that is already running finish its block
+        vTaskDelay(pdMS_TO_TICKS(BUF_LEN * 1000 / rec_config.sample_rate + 1));
+    } else {
+        while (!stop_requested && !I2S_read()) {
+        }
+    }
+}
+
+/**
+ * @brief Open the first file, capture, then flush and close.
+ * @param frames Frames to capture, UINT64_MAX to run until audio_recorder_stop()
+ * @return true on success
+ */
+static bool run_session(uint64_t frames)
+{
+    audio_ring_reset(&ring);
+    stop_requested = false;
+    session_start_time = time(NULL);
+    xQueueReset(gap_queue);
+    frames_committed = 0;
+    gap_pending = false;
+    gap_events = short_reads = dma_overflows = 0;
+    gap_frames = 0;
+    checkpoints = 0;
+    atomic_store(&dma_overflow_bytes, 0);
+    if (!writer_command(WRITER_CMD_OPEN)) return false;
+
+    session_frames = frames;
+    frames_captured = 0;
+    notify_pending = 0;
+    run_capture();
+    flush_gap(NULL);    // Capture has stopped: hand over a gap at the very end
+
+    bool flushed = writer_command(WRITER_CMD_CLOSE);
+
+    audio_recorder_stats_t stats;
+    audio_recorder_get_stats(&stats);
+    ESP_LOGI(TAG, "Captured %llu frames", stats.frames_captured);
+    ESP_LOGI(TAG, "Ring high-water: %u of %u bytes", (unsigned)stats.ring_high_water, (unsigned)stats.ring_size);
+    if (stats.overrun_frames > 0) {
+        ESP_LOGW(TAG, "Ring overrun: %u frames dropped", (unsigned)stats.overrun_frames);
+    }
+    if (stats.gap_events > 0) {
+        ESP_LOGW(TAG, "Gaps: %u, %llu frames missing (%u short reads, %u DMA overflows)",
+                 (unsigned)stats.gap_events, stats.gap_frames, (unsigned)stats.short_reads,
+                 (unsigned)stats.dma_overflows);
+    }
+    if (stats.card_writes > 0) {
+        ESP_LOGI(TAG, "SD: %llu bytes at %u KB/s, write p50/p95/p99/max %u/%u/%u/%u us",
+                 stats.card_bytes, (unsigned)stats.write_kbps, (unsigned)stats.write_p50_us,
+                 (unsigned)stats.write_p95_us, (unsigned)stats.write_p99_us, (unsigned)stats.write_max_us);
+    }
+    if (stats.write_stalls > 0) {
+        ESP_LOGW(TAG, "SD stalls: %u writes over %u ms, ring up to %u bytes after one",
+                 (unsigned)stats.write_stalls, SD_STALL_US / 1000, (unsigned)stats.stall_ring_max);
+    }
+    if (rec_config.trigger_enabled) {
+        ESP_LOGI(TAG, "Activity gate: %u events, %llu frames not stored",
+                 (unsigned)stats.trigger_events, stats.frames_gated);
+    }
+    audio_recorder_levels_t lv;
+    if (audio_recorder_get_levels(&lv) && lv.clips_total > 0) {
+        ESP_LOGW(TAG, "Input clipped: %llu samples", lv.clips_total);
+    }
+
+    return flushed;
+}
+
 /**
  * @brief Start recording audio to file
  * @param filename Output WAV filename
- * @param minutes Duration in minutes
+ * @param minutes Duration in minutes, converted to an exact number of sample frames
  * @return true on success
  */
 bool audio_recorder_start(const char* filename, uint64_t minutes)
@@ -296,26 +1744,39 @@ bool audio_recorder_start(const char* filename, uint64_t minutes)
     strncpy(current_filename, filename, sizeof(current_filename) - 1);
     current_filename[sizeof(current_filename)-1] = '\0';
 
-    if (!create_wav_header(filename)) return false;
-
-    current_state = RECORDER_STATE_IDLE;
-    cycle_count = i2s_write_pos = sd_write_pos = 0;
+    name_cb = NULL;
+    segment_bytes = 0;
+    plan_file_size(minutes * 60);
+    return run_session(minutes * 60 * rec_config.sample_rate);
+}
 
-    uint64_t start_time = esp_timer_get_time() / 1000;
-    uint64_t duration_ms = minutes * 60 * 1000;
+/**
+ * @brief Record continuously into consecutive files without gaps
+ *
+ * I2S keeps running across files; the writer closes each file after
+ * exactly minutes_per_file of frames and continues in the next one, which
+ * is created ahead of time. Returns after audio_recorder_stop() or on error.
+ *
+ * @param next_name Called to name each file from its recording start time
+ * @param minutes_per_file Length of each file in minutes
+ * @return true if stopped cleanly
+ */
+bool audio_recorder_start_continuous(audio_recorder_name_cb_t next_name, uint64_t minutes_per_file)
+{
+    if (!next_name || minutes_per_file == 0) return false;
 
-    while ((esp_timer_get_time() / 1000 - start_time) < duration_ms) {
-        I2S_read();
-        SD_write();
-        cycle_count++;
-    }
+    time_t now = time(NULL);
+    next_name(current_filename, sizeof(current_filename), now);
 
-    if (i2s_write_pos > 0 && current_state == RECORDER_STATE_RECORDING) {
-        sd_write_task(NULL);
-    }
+    name_cb = next_name;
+    segment_seconds = minutes_per_file * 60;
+    segment_bytes = (uint64_t)segment_seconds * rec_config.sample_rate * out_frame_bytes;
+    next_start_time = now + segment_seconds;
+    plan_file_size(segment_seconds);
 
-    update_wav_header(filename);
-    return true;
+    bool ok = run_session(UINT64_MAX);
+    name_cb = NULL;
+    return ok;
 }
 
 /**
@@ -323,8 +1784,74 @@ bool audio_recorder_start(const char* filename, uint64_t minutes)
  */
 void audio_recorder_stop(void)
 {
-    current_state = RECORDER_STATE_IDLE;
-    if (sd_task_handle) vTaskDelay(pdMS_TO_TICKS(50));
+    stop_requested = true;
+}
+
+/**
+ * @brief Get current recorder state
+ * @return Recorder state
+ */
+recorder_state_t audio_recorder_get_state(void)
+{
+    return current_state;
+}
+
+/**
+ * @brief Get ring buffer statistics for the current session
+ * @param stats Output statistics
+ */
+void audio_recorder_get_stats(audio_recorder_stats_t* stats)
+{
+    if (!stats) return;
+    stats->frames_captured = frames_captured;
+    stats->ring_size = psram_buffer_size;
+    stats->ring_high_water = psram_buffer ? audio_ring_high_water(&ring) : 0;
+    stats->overrun_frames = psram_buffer ? audio_ring_overrun_frames(&ring) : 0;
+    stats->trigger_events = trigger_events;
+    stats->frames_gated = frames_gated;
+    stats->gap_events = gap_events;
+    stats->gap_frames = gap_frames;
+    stats->short_reads = short_reads;
+    stats->dma_overflows = dma_overflows;
+    stats->checkpoints = checkpoints;
+    stats->card_bytes = io_bytes;
+    int64_t elapsed = io_elapsed_us();
+    stats->write_kbps = (elapsed > 0) ? (uint32_t)(io_bytes * 1000000 / 1024 / (uint64_t)elapsed) : 0;
+    stats->card_writes = write_latency.samples;
+    stats->write_p50_us = latency_histogram_percentile(&write_latency, 500);
+    stats->write_p95_us = latency_histogram_percentile(&write_latency, 950);
+    stats->write_p99_us = latency_histogram_percentile(&write_latency, 990);
+    stats->write_max_us = write_latency.max;
+    stats->write_stalls = io_stalls;
+    stats->stall_ring_max = stall_ring_max;
+}
+
+/**
+ * @brief Get the latest input levels
+ * @param levels Output: last block, last logged interval and session clip count
+ * @return false if metering is disabled
+ */
+bool audio_recorder_get_levels(audio_recorder_levels_t* levels)
+{
+    if (!levels || !metering) return false;
+    taskENTER_CRITICAL(&levels_lock);
+    *levels = current_levels;
+    taskEXIT_CRITICAL(&levels_lock);
+    return true;
+}
+
+/**
+ * @brief File name extension for a recording format
+ * @param format Recording format
+ * @return Extension including the dot
+ */
+const char* audio_recorder_file_extension(audio_format_t format)
+{
+    switch (format) {
+        case AUDIO_FORMAT_FLAC: return ".flac";
+        case AUDIO_FORMAT_LOG_ONLY: return AUDIO_METER_EXTENSION;
+        default:                return ".wav";   // PCM and IMA ADPCM
+    }
 }
 
 /**
@@ -333,6 +1860,5 @@ void audio_recorder_stop(void)
 void audio_recorder_deinit(void)
 {
     audio_recorder_stop();
-    deinit_i2s();
-    deinit_psram();
+    release_resources();
 }
@@ -2,7 +2,11 @@
 #define AUDIO_RECORDER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <time.h>
+#include "audio_biquad.h"
+#include "audio_meter.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,11 +22,13 @@ extern "C" {
 #define PM_SDIN 10
 
 // Buffers
-#define MAX_CICLE_COUNT 1000
 #define BUF_COUNT 16
 #define BUF_LEN 512
 #define I2S_BUFFERSIZE ((BUF_COUNT - 1) * BUF_LEN)
-#define PSRAM_BUFFER_SIZE (MAX_CICLE_COUNT * I2S_BUFFERSIZE)
+#define PSRAM_BUFFER_SECONDS 8               // Audio the ring must absorb during SD stalls
+#define PSRAM_BUFFER_MIN (256 * 1024)         // Ring capacity bounds (powers of two)
+#define PSRAM_BUFFER_MAX (4 * 1024 * 1024)
+#define SD_CHUNK_SIZE (32 * 1024)             // Ring fill handed to the SD writer at a time
 
 // Estados
 typedef enum {
@@ -32,14 +38,125 @@ typedef enum {
     RECORDER_STATE_WRITING_SD
 } recorder_state_t;
 
+// Modo de captura
+typedef enum {
+    CAPTURE_MODE_POLLED,        /**< audio_hal_i2s_read() into rx_buf, then copy to the ring */
+    CAPTURE_MODE_DMA_CALLBACK   /**< on_recv callback extracts straight from DMA buffers */
+} capture_mode_t;
+
+#define CAPTURE_MODE_DEFAULT CAPTURE_MODE_DMA_CALLBACK
+
+// Formato de archivo
+typedef enum {
+    AUDIO_FORMAT_WAV,           /**< Uncompressed PCM WAV */
+    AUDIO_FORMAT_FLAC,          /**< Lossless FLAC, encoded in the SD writer (16/24-bit) */
+    AUDIO_FORMAT_IMA_ADPCM,     /**< 4:1 IMA ADPCM WAV, encoded in the SD writer (16-bit) */
+    AUDIO_FORMAT_LOG_ONLY       /**< No audio, only the level log (.csv); needs meter_interval_s */
+} audio_format_t;
+
+// Configuración de grabación
+typedef struct {
+    uint32_t sample_rate;           /**< 8000..96000 Hz */
+    uint8_t bits_per_sample;        /**< 16, 24 or 32 */
+    uint8_t channels;               /**< 1 (left channel) or 2 */
+    uint32_t output_rate;           /**< Stored rate, 0 = sample_rate; lower rates are decimated (16-bit) */
+    capture_mode_t capture_mode;    /**< How samples reach the ring */
+    audio_format_t format;          /**< File format written to SD */
+    uint32_t checkpoint_interval_s; /**< Rewrite the header and fsync this often, 0 = only at close */
+    bool preallocate;               /**< Reserve each file's projected size contiguously (not FLAC); trades power-loss tidiness for latency */
+    bool raw_log;                   /**< Write PCM WAV audio to the raw log partition instead of files (raw_log_format.h) */
+
+    // Grabación por actividad
+    bool trigger_enabled;           /**< Only store audio around blocks above the threshold */
+    float trigger_threshold_dbfs;   /**< Block level (first channel) that opens the gate */
+    uint32_t trigger_highpass_hz;   /**< Detector band lower edge, 0 = DC removal only */
+    uint32_t pre_roll_ms;           /**< Audio kept from before the triggering block */
+    uint32_t post_roll_ms;          /**< Audio kept after the last block above threshold */
+
+    // Filtrado (16-bit, a la frecuencia de captura)
+    uint32_t highpass_hz;           /**< 2nd-order Butterworth high-pass (DC, rumble), 0 = off */
+    uint32_t lowpass_hz;            /**< 2nd-order Butterworth low-pass (band limit), 0 = off */
+    const audio_biquad_coeffs_t* filter_coeffs; /**< Extra Q30 sections run first, copied at init */
+    uint8_t filter_sections;        /**< Number of filter_coeffs entries */
+
+    // Resumen espectral
+    bool spectrum_enabled;          /**< Write a .spc band/index summary (first channel) next to each file */
+
+    // Medición de nivel
+    uint32_t meter_interval_s;      /**< Leq log interval in seconds, 0 = no metering (needs AUDIO_METER_MIN_RATE) */
+    float meter_calibration_db;     /**< Added to logged levels (dB SPL at 0 dBFS), 0 = log dBFS */
+} audio_recorder_config_t;
+
+#define AUDIO_RECORDER_DEFAULT_CONFIG() {   \
+    .sample_rate = SAMPLERATE,              \
+    .bits_per_sample = 16,                  \
+    .channels = 1,                          \
+    .output_rate = 0,                       \
+    .capture_mode = CAPTURE_MODE_DEFAULT,   \
+    .format = AUDIO_FORMAT_WAV,             \
+    .checkpoint_interval_s = 60,            \
+    .preallocate = true,                    \
+    .raw_log = false,                       \
+    .trigger_enabled = false,               \
+    .trigger_threshold_dbfs = -50.0f,       \
+    .trigger_highpass_hz = 200,             \
+    .pre_roll_ms = 1000,                    \
+    .post_roll_ms = 2000,                   \
+    .highpass_hz = 0,                       \
+    .lowpass_hz = 0,                        \
+    .filter_coeffs = NULL,                  \
+    .filter_sections = 0,                   \
+    .spectrum_enabled = false,              \
+    .meter_interval_s = 0,                  \
+    .meter_calibration_db = 0.0f,           \
+}
+
+// Estadísticas
+typedef struct {
+    uint64_t frames_captured;   /**< Frames taken from I2S this session */
+    uint32_t ring_size;         /**< Ring capacity in bytes */
+    uint32_t ring_high_water;   /**< Highest ring fill in bytes */
+    uint32_t overrun_frames;    /**< Frames dropped because the ring was full */
+    uint32_t trigger_events;    /**< Times the activity gate opened */
+    uint64_t frames_gated;      /**< Frames discarded while the gate was closed */
+    uint32_t gap_events;        /**< Gaps in the audio (each run of missing frames counts once) */
+    uint64_t gap_frames;        /**< Frames missing from the audio (a lower bound for short reads) */
+    uint32_t short_reads;       /**< Polled reads that timed out or failed */
+    uint32_t dma_overflows;     /**< I2S receive queue overflows (polled mode) */
+    uint32_t checkpoints;       /**< Periodic header checkpoints written */
+    uint64_t card_bytes;        /**< Bytes the card accepted, including rewrites (header patches, checkpoints) */
+    uint32_t write_kbps;        /**< card_bytes over the session time, KB/s */
+    uint32_t card_writes;       /**< Timed card accesses (f_write and f_sync) */
+    uint32_t write_p50_us;      /**< Card access latency percentiles (within 25%) */
+    uint32_t write_p95_us;
+    uint32_t write_p99_us;
+    uint32_t write_max_us;      /**< Slowest card access */
+    uint32_t write_stalls;      /**< Card accesses of 100 ms or more */
+    uint32_t stall_ring_max;    /**< Highest ring fill right after a stall, bytes */
+} audio_recorder_stats_t;
+
+// Niveles
+typedef struct {
+    audio_meter_block_t block;          /**< Last 125 ms block, dBFS */
+    audio_meter_interval_t interval;    /**< Last logged interval, dBFS */
+    uint64_t clips_total;               /**< Clipped samples this session */
+} audio_recorder_levels_t;
+
+/** Fills buffer with the filename for a recording starting at start */
+typedef void (*audio_recorder_name_cb_t)(char* buffer, size_t size, time_t start);
+
 // ==================== API PÚBLICA ====================
-bool audio_recorder_init(void);
+bool audio_recorder_init(const audio_recorder_config_t* config);
 bool audio_recorder_start(const char* filename, uint64_t minutes);
+bool audio_recorder_start_continuous(audio_recorder_name_cb_t next_name, uint64_t minutes_per_file);
 void audio_recorder_stop(void);
 void audio_recorder_deinit(void);
+const char* audio_recorder_file_extension(audio_format_t format);
 
 // Opcional: funciones para debug/monitoreo
 recorder_state_t audio_recorder_get_state(void);
+void audio_recorder_get_stats(audio_recorder_stats_t* stats);
+bool audio_recorder_get_levels(audio_recorder_levels_t* levels);
 
 #ifdef __cplusplus
 }
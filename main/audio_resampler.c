@@ -0,0 +1,188 @@
+// audio_resampler.c
+#include "audio_resampler.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RESAMPLER_TAPS_PER_M 27.5f   // Blackman, transition 0.2 * out_rate: K = 5.5 / 0.2 * M
+#define RESAMPLER_MAX_ABS_SUM 65000  // Q15 |h| per phase stays below 2.0 so int32 MACs cannot overflow
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief Q15 dot product of n samples (n a multiple of 4).
+ */
+static inline int32_t dot_q15(const int16_t* x, const int16_t* c, uint32_t n)
+{
+    int32_t acc0 = 0, acc1 = 0;
+    for (uint32_t k = 0; k < n; k += 4) {
+        acc0 += x[k] * c[k] + x[k + 2] * c[k + 2];
+        acc1 += x[k + 1] * c[k + 1] + x[k + 3] * c[k + 3];
+    }
+    return acc0 + acc1;
+}
+
+/**
+ * @brief Design the prototype low-pass and store it as reversed Q15 phases.
+ * @return false if the scratch buffer cannot be allocated
+ */
+static bool design_filter(audio_resampler_t* rs)
+{
+    const uint32_t L = rs->up, T = rs->taps, K = L * T;
+    const double fc = 0.5 / rs->down;           // Output Nyquist, in cycles per prototype sample
+    const double center = (K - 1) / 2.0;
+
+    double* h = malloc(T * sizeof(double));
+    if (!h) return false;
+
+    for (uint32_t p = 0; p < L; p++) {
+        int16_t* c = rs->coeffs + p * T;
+        double sum = 0.0;
+
+        for (uint32_t k = 0; k < T; k++) {
+            double n = (double)(p + k * L);
+            double t = n - center;
+            double sinc = (t == 0.0) ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+            double w = 0.42 - 0.5 * cos(2.0 * M_PI * n / (K - 1)) + 0.08 * cos(4.0 * M_PI * n / (K - 1));
+            h[k] = sinc * w * L;                // Each phase is a unity-gain sub-filter
+            sum += h[k];
+        }
+
+        // Normalize every phase to exactly unity DC gain, then bound the worst-case sum
+        double abs_sum = 0.0;
+        for (uint32_t k = 0; k < T; k++) {
+            h[k] /= sum;
+            abs_sum += fabs(h[k]);
+        }
+        double scale = 32768.0;
+        if (abs_sum * scale > RESAMPLER_MAX_ABS_SUM) scale = RESAMPLER_MAX_ABS_SUM / abs_sum;
+
+        for (uint32_t k = 0; k < T; k++) {
+            long q = lround(h[k] * scale);
+            c[T - 1 - k] = (int16_t)(q > 32767 ? 32767 : (q < -32768 ? -32768 : q));
+        }
+    }
+
+    free(h);
+    return true;
+}
+
+/**
+ * @brief Set up a decimator from in_rate to out_rate.
+ * @param rs Resampler
+ * @param in_rate Capture rate
+ * @param out_rate Stored rate, at most in_rate
+ * @param channels Interleaved channels
+ * @return false if the ratio is unsupported or allocation failed
+ */
+bool audio_resampler_init(audio_resampler_t* rs, uint32_t in_rate, uint32_t out_rate, uint16_t channels)
+{
+    memset(rs, 0, sizeof(*rs));
+    if (out_rate == 0 || out_rate >= in_rate) return false;
+    if (channels < 1 || channels > AUDIO_RESAMPLER_MAX_CHANNELS) return false;
+
+    uint32_t g = gcd(in_rate, out_rate);
+    rs->up = out_rate / g;
+    rs->down = in_rate / g;
+    rs->channels = channels;
+
+    uint32_t taps = (uint32_t)ceilf(RESAMPLER_TAPS_PER_M * rs->down / rs->up);
+    rs->taps = (taps + 3) & ~3u;
+    if ((uint64_t)rs->up * rs->taps > AUDIO_RESAMPLER_MAX_COEFFS) return false;
+
+    rs->coeffs = malloc((size_t)rs->up * rs->taps * sizeof(int16_t));
+    bool ok = rs->coeffs != NULL;
+    for (uint16_t c = 0; c < channels; c++) {
+        rs->line[c] = malloc((rs->taps - 1 + AUDIO_RESAMPLER_BLOCK) * sizeof(int16_t));
+        ok = ok && rs->line[c];
+    }
+    if (!ok || !design_filter(rs)) {
+        audio_resampler_free(rs);
+        return false;
+    }
+
+    audio_resampler_reset(rs);
+    return true;
+}
+
+/**
+ * @brief Release the resampler buffers.
+ */
+void audio_resampler_free(audio_resampler_t* rs)
+{
+    free(rs->coeffs);
+    rs->coeffs = NULL;
+    for (int c = 0; c < AUDIO_RESAMPLER_MAX_CHANNELS; c++) {
+        free(rs->line[c]);
+        rs->line[c] = NULL;
+    }
+}
+
+/**
+ * @brief Clear the history (silence) and restart at phase 0.
+ */
+void audio_resampler_reset(audio_resampler_t* rs)
+{
+    for (uint16_t c = 0; c < rs->channels; c++) {
+        memset(rs->line[c], 0, (rs->taps - 1) * sizeof(int16_t));
+    }
+    rs->phase = 0;
+    rs->pos = rs->taps - 1;
+}
+
+/**
+ * @brief Decimate interleaved 16-bit frames.
+ * @param rs Resampler
+ * @param in Input frames
+ * @param frames Number of input frames
+ * @param out Output frames, room for frames * L / M + 1
+ * @return Output frames produced
+ */
+size_t audio_resampler_process(audio_resampler_t* rs, const int16_t* in, size_t frames, int16_t* out)
+{
+    const uint32_t T = rs->taps, L = rs->up, M = rs->down;
+    const uint16_t channels = rs->channels;
+    size_t produced = 0;
+
+    while (frames > 0) {
+        uint32_t n = (frames > AUDIO_RESAMPLER_BLOCK) ? AUDIO_RESAMPLER_BLOCK : (uint32_t)frames;
+
+        for (uint16_t c = 0; c < channels; c++) {
+            int16_t* dst = rs->line[c] + T - 1;
+            for (uint32_t i = 0; i < n; i++) dst[i] = in[i * channels + c];
+        }
+
+        uint32_t end = T - 1 + n;
+        while (rs->pos < end) {
+            const int16_t* coeffs = rs->coeffs + rs->phase * T;
+            for (uint16_t c = 0; c < channels; c++) {
+                int32_t acc = dot_q15(rs->line[c] + rs->pos + 1 - T, coeffs, T);
+                acc = (acc + (1 << 14)) >> 15;
+                out[produced * channels + c] = (int16_t)(acc > 32767 ? 32767 : (acc < -32768 ? -32768 : acc));
+            }
+            produced++;
+
+            rs->phase += M;
+            rs->pos += rs->phase / L;
+            rs->phase %= L;
+        }
+
+        // Keep the last T - 1 inputs as history for the next pass
+        for (uint16_t c = 0; c < channels; c++) {
+            memmove(rs->line[c], rs->line[c] + n, (T - 1) * sizeof(int16_t));
+        }
+        rs->pos -= n;
+        in += n * channels;
+        frames -= n;
+    }
+
+    return produced;
+}
@@ -0,0 +1,48 @@
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define AUDIO_RESAMPLER_BLOCK 1024          /**< Max input frames per internal pass */
+#define AUDIO_RESAMPLER_MAX_CHANNELS 2
+#define AUDIO_RESAMPLER_MAX_COEFFS 16384    /**< Bound on L * taps (int16 each) */
+
+/**
+ * @brief Fixed-point rational polyphase decimator, out_rate = in_rate * L / M.
+ *
+ * A Blackman-windowed sinc prototype (cutoff at the output Nyquist,
+ * transition 0.4..0.6 of the output rate) is split into L phases of
+ * `taps` Q15 coefficients each, stored reversed so every output sample is
+ * a contiguous 16x16->32 dot product. The cost is `taps` MACs per output
+ * sample, which works out to about 28 MACs per input sample for every
+ * ratio (2x/3x/4x, 44.1k->16k, 44.1k->8k, ...). 16-bit samples only.
+ */
+typedef struct {
+    uint32_t up;                                /**< L */
+    uint32_t down;                              /**< M */
+    uint32_t taps;                              /**< Coefficients per phase */
+    uint16_t channels;                          /**< Interleaved channels */
+    uint32_t phase;                             /**< Next output phase, 0..L-1 */
+    uint32_t pos;                               /**< Line index of the newest input of the next output */
+    int16_t* coeffs;                            /**< L x taps, phase-major, reversed */
+    int16_t* line[AUDIO_RESAMPLER_MAX_CHANNELS];/**< taps - 1 history + one input block */
+} audio_resampler_t;
+
+// ==================== API PÚBLICA ====================
+bool audio_resampler_init(audio_resampler_t* rs, uint32_t in_rate, uint32_t out_rate, uint16_t channels);
+void audio_resampler_free(audio_resampler_t* rs);
+void audio_resampler_reset(audio_resampler_t* rs);
+size_t audio_resampler_process(audio_resampler_t* rs, const int16_t* in, size_t frames, int16_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_RESAMPLER_H
@@ -0,0 +1,205 @@
+// audio_ring.c
+#include "audio_ring.h"
+#include <string.h>
+
+/**
+ * @brief Initialize a ring over caller-provided storage.
+ * @param ring Ring to initialize
+ * @param storage Backing buffer of at least size bytes
+ * @param size Capacity in bytes, must be a power of two
+ * @param frame_bytes Bytes per sample frame
+ * @return true on success, false if arguments are invalid
+ */
+bool audio_ring_init(audio_ring_t* ring, void* storage, uint32_t size, uint32_t frame_bytes)
+{
+    if (!ring || !storage || size == 0 || (size & (size - 1)) != 0) return false;
+    if (frame_bytes == 0 || frame_bytes > size) return false;
+
+    ring->data = (uint8_t*)storage;
+    ring->size = size;
+    ring->mask = size - 1;
+    ring->frame_bytes = frame_bytes;
+    audio_ring_reset(ring);
+    return true;
+}
+
+/**
+ * @brief Empty the ring and clear its counters.
+ *
+ * Must only be called while neither producer nor consumer is running.
+ */
+void audio_ring_reset(audio_ring_t* ring)
+{
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->high_water, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->overrun_frames, 0, memory_order_relaxed);
+}
+
+/**
+ * @brief Number of bytes committed and not yet released.
+ */
+uint32_t audio_ring_used(const audio_ring_t* ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
+
+/**
+ * @brief Number of bytes the producer can still commit, rounded down to whole frames.
+ */
+uint32_t audio_ring_free(const audio_ring_t* ring)
+{
+    uint32_t space = ring->size - audio_ring_used(ring);
+    return space - (space % ring->frame_bytes);
+}
+
+// ==================== PRODUCER ====================
+/**
+ * @brief Get the contiguous writable region at head.
+ *
+ * The region may be shorter than audio_ring_free() when it reaches the
+ * end of the storage; the rest is available after committing.
+ *
+ * @param ring Ring
+ * @param ptr Receives the write address
+ * @return Contiguous writable bytes
+ */
+size_t audio_ring_write_ptr(audio_ring_t* ring, uint8_t** ptr)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t space = ring->size - (head - tail);
+    uint32_t offset = head & ring->mask;
+    uint32_t contiguous = ring->size - offset;
+
+    *ptr = ring->data + offset;
+    return (space < contiguous) ? space : contiguous;
+}
+
+/**
+ * @brief Publish len bytes written through audio_ring_write_ptr().
+ */
+void audio_ring_commit(audio_ring_t* ring, size_t len)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed) + (uint32_t)len;
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+
+    uint32_t used = head - atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (used > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, used, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Copy whole frames into the ring, dropping what does not fit.
+ *
+ * Dropped frames are added to the overrun counter.
+ *
+ * @param ring Ring
+ * @param src Source data
+ * @param len Bytes to copy, a multiple of frame_bytes
+ * @return Bytes actually stored
+ */
+size_t audio_ring_push(audio_ring_t* ring, const void* src, size_t len)
+{
+    size_t space = audio_ring_free(ring);
+    size_t to_copy = (len < space) ? len : space;
+    const uint8_t* in = (const uint8_t*)src;
+    size_t copied = 0;
+
+    while (copied < to_copy) {
+        uint8_t* dst;
+        size_t chunk = audio_ring_write_ptr(ring, &dst);
+        if (chunk > to_copy - copied) chunk = to_copy - copied;
+        memcpy(dst, in + copied, chunk);
+        audio_ring_commit(ring, chunk);
+        copied += chunk;
+    }
+
+    if (copied < len) {
+        audio_ring_note_overrun(ring, (uint32_t)((len - copied) / ring->frame_bytes));
+    }
+    return copied;
+}
+
+/**
+ * @brief Account frames the producer had to drop.
+ */
+void audio_ring_note_overrun(audio_ring_t* ring, uint32_t frames)
+{
+    atomic_fetch_add_explicit(&ring->overrun_frames, frames, memory_order_relaxed);
+}
+
+// ==================== CONSUMER ====================
+/**
+ * @brief Get the contiguous readable region at tail.
+ * @param ring Ring
+ * @param ptr Receives the read address
+ * @return Contiguous readable bytes
+ */
+size_t audio_ring_read_ptr(audio_ring_t* ring, const uint8_t** ptr)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t used = head - tail;
+    uint32_t offset = tail & ring->mask;
+    uint32_t contiguous = ring->size - offset;
+
+    *ptr = ring->data + offset;
+    return (used < contiguous) ? used : contiguous;
+}
+
+/**
+ * @brief Return len bytes obtained through audio_ring_read_ptr() to the producer.
+ */
+void audio_ring_release(audio_ring_t* ring, size_t len)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed) + (uint32_t)len;
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+/**
+ * @brief Copy committed data without releasing it.
+ *
+ * Lets the consumer look ahead of tail (e.g. to analyze audio it may
+ * still decide to discard) while the data stays owned by the ring.
+ *
+ * @param ring Ring
+ * @param offset Bytes after tail where the copy starts
+ * @param dst Destination buffer
+ * @param len Bytes to copy
+ * @return Bytes copied (less than len if not enough data is committed)
+ */
+size_t audio_ring_peek(const audio_ring_t* ring, size_t offset, void* dst, size_t len)
+{
+    uint32_t used = audio_ring_used(ring);
+    if (offset >= used) return 0;
+    if (len > used - offset) len = used - offset;
+
+    uint32_t start = (atomic_load_explicit(&ring->tail, memory_order_relaxed) + (uint32_t)offset) & ring->mask;
+    size_t first = ring->size - start;
+    if (first > len) first = len;
+
+    memcpy(dst, ring->data + start, first);
+    memcpy((uint8_t*)dst + first, ring->data, len - first);
+    return len;
+}
+
+// ==================== COUNTERS ====================
+/**
+ * @brief Highest fill level reached since the last reset, in bytes.
+ */
+uint32_t audio_ring_high_water(const audio_ring_t* ring)
+{
+    return atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+}
+
+/**
+ * @brief Frames dropped by the producer since the last reset.
+ */
+uint32_t audio_ring_overrun_frames(const audio_ring_t* ring)
+{
+    return atomic_load_explicit(&ring->overrun_frames, memory_order_relaxed);
+}
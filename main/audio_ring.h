@@ -0,0 +1,66 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define AUDIO_RING_CACHE_LINE 64   /**< Separation between producer and consumer indices */
+
+/**
+ * @brief Lock-free single-producer/single-consumer byte ring.
+ *
+ * The capacity must be a power of two. head and tail are free-running
+ * counters (they are only masked when indexing), so used = head - tail
+ * is valid across wrap-around. Each index lives on its own cache line
+ * so the producer (I2S) and consumer (SD writer) never share a line.
+ * Data is moved in whole frames of frame_bytes.
+ */
+typedef struct {
+    uint8_t* data;                  /**< Backing storage (PSRAM) */
+    uint32_t size;                  /**< Capacity in bytes, power of two */
+    uint32_t mask;                  /**< size - 1 */
+    uint32_t frame_bytes;           /**< Bytes per sample frame */
+
+    // Producer side
+    _Alignas(AUDIO_RING_CACHE_LINE) atomic_uint head;  /**< Total bytes committed */
+    atomic_uint high_water;         /**< Maximum fill level seen, in bytes */
+    atomic_uint overrun_frames;     /**< Frames dropped because the ring was full */
+
+    // Consumer side
+    _Alignas(AUDIO_RING_CACHE_LINE) atomic_uint tail;  /**< Total bytes released */
+} audio_ring_t;
+
+// ==================== API PÚBLICA ====================
+bool audio_ring_init(audio_ring_t* ring, void* storage, uint32_t size, uint32_t frame_bytes);
+void audio_ring_reset(audio_ring_t* ring);
+
+uint32_t audio_ring_used(const audio_ring_t* ring);
+uint32_t audio_ring_free(const audio_ring_t* ring);
+
+// Producer
+size_t audio_ring_write_ptr(audio_ring_t* ring, uint8_t** ptr);
+void audio_ring_commit(audio_ring_t* ring, size_t len);
+size_t audio_ring_push(audio_ring_t* ring, const void* src, size_t len);
+void audio_ring_note_overrun(audio_ring_t* ring, uint32_t frames);
+
+// Consumer
+size_t audio_ring_read_ptr(audio_ring_t* ring, const uint8_t** ptr);
+void audio_ring_release(audio_ring_t* ring, size_t len);
+size_t audio_ring_peek(const audio_ring_t* ring, size_t offset, void* dst, size_t len);
+
+// Counters
+uint32_t audio_ring_high_water(const audio_ring_t* ring);
+uint32_t audio_ring_overrun_frames(const audio_ring_t* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_RING_H
@@ -0,0 +1,330 @@
+// audio_spectrum.c
+#include "audio_spectrum.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N AUDIO_SPECTRUM_FFT_SIZE
+#define M (AUDIO_SPECTRUM_FFT_SIZE / 2)
+#define SPECTRUM_FIRST_BAND_HZ 125.0f
+#define SPECTRUM_ANTHRO_HZ 1000.0f          // NDSI anthrophony band: 1-2 kHz
+#define SPECTRUM_BIO_LO_HZ 2000.0f          // NDSI biophony band: 2-8 kHz
+#define SPECTRUM_BIO_HI_HZ 8000.0f
+
+/**
+ * @brief Read the first channel of a frame as a 32-bit left-justified sample.
+ */
+static inline int32_t first_sample(const uint8_t* p, uint16_t bits)
+{
+    switch (bits) {
+        case 16: return (int32_t)((uint32_t)p[0] << 16 | (uint32_t)p[1] << 24);
+        case 24: return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+        default: return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    }
+}
+
+/**
+ * @brief First FFT bin whose center frequency is at or above hz, capped at the Nyquist bin + 1.
+ */
+static uint16_t bin_at(uint32_t sample_rate, float hz)
+{
+    float bin = ceilf(hz * N / (float)sample_rate);
+    return (bin > M + 1) ? M + 1 : (uint16_t)bin;
+}
+
+static int16_t to_cdb(float power)
+{
+    if (power <= 0.0f) return AUDIO_SPECTRUM_FLOOR_CDB;
+    float cdb = 1000.0f * log10f(power);
+    return (cdb < AUDIO_SPECTRUM_FLOOR_CDB) ? AUDIO_SPECTRUM_FLOOR_CDB : (int16_t)lrintf(cdb);
+}
+
+// ==================== FFT ====================
+/**
+ * @brief In-place real FFT of N samples.
+ *
+ * Runs an N/2-point complex radix-2 FFT over the even/odd samples packed
+ * as (re, im) pairs, then splits it into the spectrum of the real input.
+ * Output packing: data[0] = X[0], data[1] = X[N/2] (both real),
+ * data[2k], data[2k+1] = Re, Im of X[k] for 0 < k < N/2.
+ *
+ * @param data N samples in, packed spectrum out
+ * @param twiddle e^(-2 pi i k / N) for k < N/2, as (re, im) pairs
+ */
+void audio_spectrum_rfft(float* data, const float* twiddle)
+{
+    // Bit-reversal permutation of the M complex points
+    for (uint32_t i = 0, j = 0; i < M; i++) {
+        if (i < j) {
+            float tr = data[2 * i], ti = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = tr;
+            data[2 * j + 1] = ti;
+        }
+        uint32_t bit = M >> 1;
+        while (j & bit) {
+            j ^= bit;
+            bit >>= 1;
+        }
+        j |= bit;
+    }
+
+    // Radix-2 butterflies; the M-point twiddles are every other entry of the N-point table
+    for (uint32_t len = 2; len <= M; len <<= 1) {
+        uint32_t half = len >> 1, step = 2 * (M / len);
+        for (uint32_t base = 0; base < M; base += len) {
+            for (uint32_t j = 0; j < half; j++) {
+                float wr = twiddle[2 * j * step], wi = twiddle[2 * j * step + 1];
+                float* a = data + 2 * (base + j);
+                float* b = a + 2 * half;
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+
+    // Split: X[k] = Fe[k] + W^k Fo[k], X[M-k] = conj(Fe[k] - W^k Fo[k])
+    float z0r = data[0], z0i = data[1];
+    data[0] = z0r + z0i;
+    data[1] = z0r - z0i;
+    for (uint32_t k = 1; k <= M / 2; k++) {
+        float* p = data + 2 * k;
+        float* q = data + 2 * (M - k);
+        float fer = 0.5f * (p[0] + q[0]), fei = 0.5f * (p[1] - q[1]);
+        float for_ = 0.5f * (p[1] + q[1]), foi = -0.5f * (p[0] - q[0]);
+        float wr = twiddle[2 * k], wi = twiddle[2 * k + 1];
+        float tr = wr * for_ - wi * foi, ti = wr * foi + wi * for_;
+        p[0] = fer + tr;
+        p[1] = fei + ti;
+        q[0] = fer - tr;
+        q[1] = ti - fei;
+    }
+}
+
+// ==================== ANALYZER ====================
+/**
+ * @brief Allocate an analyzer for the stored format.
+ * @param sp Analyzer
+ * @param fmt Format of the frames that will be fed (16/24/32-bit)
+ * @return false if allocation failed
+ */
+bool audio_spectrum_init(audio_spectrum_t* sp, const wav_format_t* fmt)
+{
+    memset(sp, 0, sizeof(*sp));
+    sp->fmt = *fmt;
+
+    float* mem = malloc((3 * N + 4 * (M + 1)) * sizeof(float));
+    if (!mem) return false;
+    sp->window = mem;
+    sp->twiddle = mem + N;
+    sp->frame = mem + 2 * N;
+    sp->power = mem + 3 * N;
+    sp->amp_sum = sp->power + (M + 1);
+    sp->amp_diff = sp->amp_sum + (M + 1);
+    sp->amp_prev = sp->amp_diff + (M + 1);
+
+    for (uint32_t i = 0; i < N; i++) sp->window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / N);
+    for (uint32_t k = 0; k < M; k++) {
+        sp->twiddle[2 * k] = cosf(2.0f * (float)M_PI * k / N);
+        sp->twiddle[2 * k + 1] = -sinf(2.0f * (float)M_PI * k / N);
+    }
+
+    for (int b = 0; b < AUDIO_SPECTRUM_BANDS; b++) {
+        float center = SPECTRUM_FIRST_BAND_HZ * (float)(1 << b);
+        sp->band_lo[b] = bin_at(fmt->sample_rate, center * (float)M_SQRT1_2);
+        sp->band_hi[b] = bin_at(fmt->sample_rate, center * (float)M_SQRT2);
+    }
+
+    uint32_t per_record = (fmt->sample_rate + N / 2) / N;
+    sp->fft_per_record = per_record ? (uint16_t)per_record : 1;
+
+    audio_spectrum_reset(sp);
+    return true;
+}
+
+/**
+ * @brief Release the analyzer buffers.
+ */
+void audio_spectrum_free(audio_spectrum_t* sp)
+{
+    free(sp->window);
+    sp->window = NULL;
+}
+
+/**
+ * @brief Discard the record in progress (e.g. at the start of a new audio file).
+ */
+static void clear_record(audio_spectrum_t* sp)
+{
+    memset(sp->power, 0, 4 * (M + 1) * sizeof(float));
+    sp->fft_frames = 0;
+    sp->energy_sum = 0.0f;
+    sp->energy_log_sum = 0.0f;
+}
+
+/**
+ * @brief Start a new audio file: frame positions restart at 0.
+ */
+void audio_spectrum_reset(audio_spectrum_t* sp)
+{
+    clear_record(sp);
+    sp->fill = 0;
+    sp->frames_in = 0;
+    sp->record_start = 0;
+}
+
+/**
+ * @brief Describe the sidecar contents.
+ */
+void audio_spectrum_header(const audio_spectrum_t* sp, audio_spectrum_header_t* hdr)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, AUDIO_SPECTRUM_MAGIC, 4);
+    hdr->version = AUDIO_SPECTRUM_VERSION;
+    hdr->header_size = sizeof(*hdr);
+    hdr->sample_rate = sp->fmt.sample_rate;
+    hdr->fft_size = N;
+    hdr->fft_per_record = sp->fft_per_record;
+    hdr->record_size = sizeof(audio_spectrum_record_t);
+    hdr->bands = AUDIO_SPECTRUM_BANDS;
+    for (int b = 0; b < AUDIO_SPECTRUM_BANDS; b++) {
+        hdr->band_center_hz[b] = (uint16_t)(SPECTRUM_FIRST_BAND_HZ * (float)(1 << b));
+    }
+}
+
+/**
+ * @brief Transform the buffered frame and add it to the record statistics.
+ *
+ * Bin powers are scaled so they sum to the mean square of the input for
+ * a stationary signal (Hann window power and one-sided spectrum folded in).
+ */
+static void analyze_frame(audio_spectrum_t* sp)
+{
+    static const float scale = 2.0f / (N * (N * 0.375f));   // sum(w^2) = 3N/8 for Hann
+    float* X = sp->frame;
+    audio_spectrum_rfft(X, sp->twiddle);
+
+    float energy = 0.0f;
+    bool first = (sp->fft_frames == 0);
+    for (uint32_t k = 0; k <= M; k++) {
+        float re, im;
+        if (k == 0) { re = X[0]; im = 0.0f; }
+        else if (k == M) { re = X[1]; im = 0.0f; }
+        else { re = X[2 * k]; im = X[2 * k + 1]; }
+
+        float mag2 = re * re + im * im;
+        float p = mag2 * ((k == 0 || k == M) ? 0.5f * scale : scale);
+        float amp = sqrtf(mag2);
+        sp->power[k] += p;
+        sp->amp_sum[k] += amp;
+        if (!first) sp->amp_diff[k] += fabsf(amp - sp->amp_prev[k]);
+        sp->amp_prev[k] = amp;
+        energy += p;
+    }
+
+    sp->energy_sum += energy;
+    if (energy > 0.0f) sp->energy_log_sum += energy * logf(energy);
+    sp->fft_frames++;
+}
+
+/**
+ * @brief Buffer frames and analyze every complete FFT frame.
+ * @param sp Analyzer
+ * @param frames Frames in the stored format
+ * @param count Number of frames
+ * @return Frames taken (stops when a record is ready)
+ */
+size_t audio_spectrum_feed(audio_spectrum_t* sp, const uint8_t* frames, size_t count)
+{
+    const size_t stride = wav_block_align(&sp->fmt);
+    const float scale = 1.0f / 2147483648.0f;
+    size_t done = 0;
+
+    while (done < count && !audio_spectrum_record_ready(sp)) {
+        if (sp->fill == 0 && sp->fft_frames == 0) sp->record_start = sp->frames_in;
+
+        size_t n = count - done;
+        if (n > N - sp->fill) n = N - sp->fill;
+        const uint8_t* p = frames + done * stride;
+        for (size_t i = 0; i < n; i++, p += stride) {
+            uint32_t j = sp->fill + i;
+            sp->frame[j] = (float)first_sample(p, sp->fmt.bits_per_sample) * scale * sp->window[j];
+        }
+
+        sp->fill += n;
+        sp->frames_in += n;
+        done += n;
+        if (sp->fill == N) {
+            analyze_frame(sp);
+            sp->fill = 0;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief Whether a full record is waiting for audio_spectrum_take().
+ */
+bool audio_spectrum_record_ready(const audio_spectrum_t* sp)
+{
+    return sp->fft_frames >= sp->fft_per_record;
+}
+
+/**
+ * @brief Summarize the FFT frames analyzed so far and start a new record.
+ * @param sp Analyzer
+ * @param rec Output record
+ * @return false if no complete FFT frame was analyzed since the last record
+ */
+bool audio_spectrum_take(audio_spectrum_t* sp, audio_spectrum_record_t* rec)
+{
+    if (sp->fft_frames == 0) return false;
+
+    const float inv = 1.0f / sp->fft_frames;
+    const uint32_t rate = sp->fmt.sample_rate;
+    memset(rec, 0, sizeof(*rec));
+    rec->start_frame = sp->record_start;
+    rec->fft_frames = sp->fft_frames;
+    rec->level_cdb = to_cdb(sp->energy_sum * inv);
+
+    for (int b = 0; b < AUDIO_SPECTRUM_BANDS; b++) {
+        float sum = 0.0f;
+        for (uint32_t k = sp->band_lo[b]; k < sp->band_hi[b]; k++) sum += sp->power[k];
+        rec->band_cdb[b] = (sp->band_lo[b] < sp->band_hi[b]) ? to_cdb(sum * inv) : AUDIO_SPECTRUM_FLOOR_CDB;
+    }
+
+    // ACI and spectral entropy over all bins but DC
+    float total = 0.0f;
+    for (uint32_t k = 1; k <= M; k++) {
+        if (sp->amp_sum[k] > 0.0f) rec->aci += sp->amp_diff[k] / sp->amp_sum[k];
+        total += sp->power[k];
+    }
+    if (total > 0.0f) {
+        float h = 0.0f;
+        for (uint32_t k = 1; k <= M; k++) {
+            float p = sp->power[k] / total;
+            if (p > 0.0f) h -= p * logf(p);
+        }
+        rec->spectral_entropy = h / logf((float)M);
+    }
+
+    // Entropy of the frame energy envelope: H = log(E) - sum(e log e) / E
+    if (sp->fft_frames > 1 && sp->energy_sum > 0.0f) {
+        float h = logf(sp->energy_sum) - sp->energy_log_sum / sp->energy_sum;
+        h /= logf((float)sp->fft_frames);
+        rec->temporal_entropy = (h < 0.0f) ? 0.0f : (h > 1.0f ? 1.0f : h);
+    }
+
+    float anthro = 0.0f, bio = 0.0f;
+    for (uint32_t k = bin_at(rate, SPECTRUM_ANTHRO_HZ); k < bin_at(rate, SPECTRUM_BIO_LO_HZ); k++) anthro += sp->power[k];
+    for (uint32_t k = bin_at(rate, SPECTRUM_BIO_LO_HZ); k < bin_at(rate, SPECTRUM_BIO_HI_HZ); k++) bio += sp->power[k];
+    if (anthro + bio > 0.0f) rec->ndsi = (bio - anthro) / (bio + anthro);
+
+    clear_record(sp);
+    return true;
+}
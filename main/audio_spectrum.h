@@ -0,0 +1,97 @@
+#ifndef AUDIO_SPECTRUM_H
+#define AUDIO_SPECTRUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wav_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define AUDIO_SPECTRUM_FFT_SIZE 1024        /**< Real FFT length (power of two) */
+#define AUDIO_SPECTRUM_BINS (AUDIO_SPECTRUM_FFT_SIZE / 2 + 1)
+#define AUDIO_SPECTRUM_BANDS 8              /**< Octave bands, 125 Hz .. 16 kHz */
+#define AUDIO_SPECTRUM_FLOOR_CDB (-12000)   /**< Level for empty bands and silence, 0.01 dB */
+#define AUDIO_SPECTRUM_MAGIC "ASPC"
+#define AUDIO_SPECTRUM_VERSION 2          /**< 2: 64-bit start_frame */
+#define AUDIO_SPECTRUM_EXTENSION ".spc"
+
+/**
+ * @brief Sidecar file header (little-endian).
+ *
+ * Followed by records of record_size bytes until the end of the file.
+ */
+typedef struct __attribute__((packed)) {
+    char magic[4];                  /**< AUDIO_SPECTRUM_MAGIC */
+    uint16_t version;               /**< AUDIO_SPECTRUM_VERSION */
+    uint16_t header_size;           /**< sizeof(audio_spectrum_header_t) */
+    uint32_t sample_rate;           /**< Rate of the analyzed (stored) audio */
+    uint16_t fft_size;              /**< AUDIO_SPECTRUM_FFT_SIZE, Hann window, no overlap */
+    uint16_t fft_per_record;        /**< FFT frames summarized by a full record (about one second) */
+    uint16_t record_size;           /**< sizeof(audio_spectrum_record_t) */
+    uint16_t bands;                 /**< AUDIO_SPECTRUM_BANDS */
+    uint16_t band_center_hz[AUDIO_SPECTRUM_BANDS]; /**< Octave band centers */
+} audio_spectrum_header_t;
+
+/**
+ * @brief Summary of about one second of audio (first channel).
+ *
+ * Levels are mean powers in 0.01 dB relative to full scale (a full-scale
+ * square wave is 0 dB). The indices follow the usual soundscape
+ * definitions computed from the FFT frames of the record.
+ */
+typedef struct __attribute__((packed)) {
+    uint64_t start_frame;           /**< First frame of the record in the audio file */
+    uint16_t fft_frames;            /**< FFT frames summarized (fft_per_record except at file end) */
+    int16_t level_cdb;              /**< Broadband level */
+    int16_t band_cdb[AUDIO_SPECTRUM_BANDS]; /**< Octave band levels */
+    float aci;                      /**< Acoustic complexity index (sum over bins) */
+    float spectral_entropy;         /**< Hf of the mean spectrum, 0..1 */
+    float temporal_entropy;         /**< Ht of the frame energies, 0..1 */
+    float ndsi;                     /**< (bio - anthro) / (bio + anthro): 2-8 kHz vs 1-2 kHz, -1..1 */
+} audio_spectrum_record_t;
+
+/**
+ * @brief Streaming spectral analyzer.
+ *
+ * Buffers the first channel into FFT frames, and accumulates per-bin
+ * power and amplitude statistics until a record is complete.
+ */
+typedef struct {
+    wav_format_t fmt;
+    uint16_t fft_per_record;
+    uint32_t fill;                  /**< Samples buffered in frame */
+    uint64_t frames_in;             /**< Frames fed since the last reset */
+    uint64_t record_start;          /**< start_frame of the record being built */
+    uint16_t fft_frames;            /**< FFT frames in the record being built */
+    float energy_sum;               /**< Sum of FFT frame energies */
+    float energy_log_sum;           /**< Sum of e * log(e) of FFT frame energies */
+    uint16_t band_lo[AUDIO_SPECTRUM_BANDS]; /**< First bin of each band */
+    uint16_t band_hi[AUDIO_SPECTRUM_BANDS]; /**< One past the last bin of each band */
+    float* window;                  /**< Hann window, FFT_SIZE */
+    float* twiddle;                 /**< cos/sin pairs of e^(-2 pi i k / N), FFT_SIZE / 2 */
+    float* frame;                   /**< Time samples, then FFT output in place */
+    float* power;                   /**< Per-bin power sum over the record */
+    float* amp_sum;                 /**< Per-bin amplitude sum */
+    float* amp_diff;                /**< Per-bin sum of |amplitude change| between frames */
+    float* amp_prev;                /**< Amplitudes of the previous frame */
+} audio_spectrum_t;
+
+// ==================== API PÚBLICA ====================
+bool audio_spectrum_init(audio_spectrum_t* sp, const wav_format_t* fmt);
+void audio_spectrum_free(audio_spectrum_t* sp);
+void audio_spectrum_reset(audio_spectrum_t* sp);
+void audio_spectrum_header(const audio_spectrum_t* sp, audio_spectrum_header_t* hdr);
+size_t audio_spectrum_feed(audio_spectrum_t* sp, const uint8_t* frames, size_t count);
+bool audio_spectrum_record_ready(const audio_spectrum_t* sp);
+bool audio_spectrum_take(audio_spectrum_t* sp, audio_spectrum_record_t* rec);
+void audio_spectrum_rfft(float* data, const float* twiddle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_SPECTRUM_H
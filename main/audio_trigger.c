@@ -0,0 +1,64 @@
+// audio_trigger.c
+#include "audio_trigger.h"
+#include <math.h>
+
+/**
+ * @brief Read the first channel of a frame as a 32-bit left-justified sample.
+ */
+static inline int32_t first_sample(const uint8_t* p, uint16_t bits)
+{
+    switch (bits) {
+        case 16: return (int32_t)((uint32_t)p[0] << 16 | (uint32_t)p[1] << 24);
+        case 24: return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+        default: return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+    }
+}
+
+/**
+ * @brief Reset the detector.
+ * @param trig Detector
+ * @param sample_rate Frames per second
+ * @param highpass_hz Lower band edge, 0 for a plain DC blocker
+ */
+void audio_trigger_init(audio_trigger_t* trig, uint32_t sample_rate, uint32_t highpass_hz)
+{
+    if (highpass_hz == 0) highpass_hz = AUDIO_TRIGGER_DC_HZ;
+    trig->coeff = expf(-2.0f * (float)M_PI * (float)highpass_hz / (float)sample_rate);
+    trig->prev_x = 0.0f;
+    trig->prev_y = 0.0f;
+}
+
+/**
+ * @brief High-passed mean-square level of a block, in dB relative to full scale.
+ *
+ * 0 dBFS is a full-scale square wave (a full-scale sine reads -3 dBFS).
+ *
+ * @param trig Detector
+ * @param frames Frames in the recorded format
+ * @param count Number of frames
+ * @param fmt Recorded format
+ * @return Block level, AUDIO_TRIGGER_FLOOR_DBFS for silence
+ */
+float audio_trigger_level_dbfs(audio_trigger_t* trig, const uint8_t* frames, size_t count,
+                               const wav_format_t* fmt)
+{
+    const size_t stride = wav_block_align(fmt);
+    const float scale = 1.0f / 2147483648.0f;
+    float a = trig->coeff, x1 = trig->prev_x, y1 = trig->prev_y;
+    float acc = 0.0f;
+
+    for (size_t i = 0; i < count; i++, frames += stride) {
+        float x = (float)first_sample(frames, fmt->bits_per_sample) * scale;
+        float y = a * (y1 + x - x1);
+        acc += y * y;
+        x1 = x;
+        y1 = y;
+    }
+
+    trig->prev_x = x1;
+    trig->prev_y = y1;
+
+    if (count == 0 || acc <= 0.0f) return AUDIO_TRIGGER_FLOOR_DBFS;
+    float level = 10.0f * log10f(acc / (float)count);
+    return (level < AUDIO_TRIGGER_FLOOR_DBFS) ? AUDIO_TRIGGER_FLOOR_DBFS : level;
+}
@@ -0,0 +1,38 @@
+#ifndef AUDIO_TRIGGER_H
+#define AUDIO_TRIGGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "wav_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define AUDIO_TRIGGER_FLOOR_DBFS (-120.0f)   /**< Level reported for digital silence */
+#define AUDIO_TRIGGER_DC_HZ 20               /**< High-pass corner when no band limit is set */
+
+/**
+ * @brief Short-term energy detector state.
+ *
+ * Runs a one-pole high-pass over the first channel (removes DC and, with a
+ * higher corner, wind/handling rumble) and reports the mean-square level of
+ * each block. The filter state carries across blocks.
+ */
+typedef struct {
+    float coeff;        /**< High-pass pole */
+    float prev_x;       /**< Last input sample */
+    float prev_y;       /**< Last output sample */
+} audio_trigger_t;
+
+// ==================== API PÚBLICA ====================
+void audio_trigger_init(audio_trigger_t* trig, uint32_t sample_rate, uint32_t highpass_hz);
+float audio_trigger_level_dbfs(audio_trigger_t* trig, const uint8_t* frames, size_t count,
+                               const wav_format_t* fmt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIO_TRIGGER_H
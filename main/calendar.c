@@ -21,6 +21,9 @@ typedef struct {
 
 static calendar_internal_t g_calendar;
 
+/** Recording format used for every session */
+static const audio_recorder_config_t g_recorder_config = AUDIO_RECORDER_DEFAULT_CONFIG();
+
 /**
  * @brief Create a default calendar file on the SD card.
  *
@@ -108,7 +111,7 @@ static void enter_deep_sleep(uint64_t minutes)
 {
     ESP_LOGI(TAG, "Entering deep sleep for %llu minutes...", minutes);
 
-    sd_card_deinit();
+    sd_card_unmount();
     audio_recorder_deinit();
 
     esp_sleep_enable_timer_wakeup(minutes * 60 * 1000000ULL);
@@ -122,21 +125,21 @@ static void enter_deep_sleep(uint64_t minutes)
  *
  * @param buffer Buffer to store the filename
  * @param size Buffer size
+ * @param start Recording start time used for the name
  */
-static void generate_filename(char* buffer, size_t size)
+static void generate_filename(char* buffer, size_t size, time_t start)
 {
-    time_t now;
     struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
+    localtime_r(&start, &timeinfo);
 
-    snprintf(buffer, size, "/%04d%02d%02d_%02d-%02d-%02d.wav",
+    snprintf(buffer, size, "/%04d%02d%02d_%02d-%02d-%02d%s",
              timeinfo.tm_year + 1900,
              timeinfo.tm_mon + 1,
              timeinfo.tm_mday,
              timeinfo.tm_hour,
              timeinfo.tm_min,
-             timeinfo.tm_sec);
+             timeinfo.tm_sec,
+             audio_recorder_file_extension(g_recorder_config.format));
 }
 
 /**
@@ -154,7 +157,7 @@ static bool execute_recording_session(const char* filename, uint64_t minutes, bo
     ESP_LOGI(TAG, "Duration: %llu minutes", minutes);
     ESP_LOGI(TAG, "Mode: %s", continuous_mode ? "CONTINUOUS" : "NORMAL");
 
-    if (!audio_recorder_init()) {
+    if (!audio_recorder_init(&g_recorder_config)) {
         ESP_LOGE(TAG, "Failed to initialize recorder");
         return false;
     }
@@ -174,6 +177,27 @@ static bool execute_recording_session(const char* filename, uint64_t minutes, bo
     return success;
 }
 
+/**
+ * @brief Record continuously, one file per hour, without gaps between files.
+ *
+ * The recorder is initialized once; I2S keeps running across files.
+ *
+ * @return false on failure (returns on error or after audio_recorder_stop())
+ */
+static bool execute_continuous_recording(void)
+{
+    ESP_LOGI(TAG, "\n=== STARTING CONTINUOUS RECORDING ===");
+
+    if (!audio_recorder_init(&g_recorder_config)) {
+        ESP_LOGE(TAG, "Failed to initialize recorder");
+        return false;
+    }
+
+    bool success = audio_recorder_start_continuous(generate_filename, 60);
+    audio_recorder_deinit();
+    return success;
+}
+
 /**
  * @brief Check the recording calendar and execute scheduled recordings.
  *
@@ -183,14 +207,14 @@ static bool execute_recording_session(const char* filename, uint64_t minutes, bo
 void check_calendar(void)
 {
     const char* filename = "/Calendar.csv";
-    sd_card_init();
+    sd_card_acquire();
 
     // ------------------- Create calendar if it does not exist -------------------
     if (!sd_card_exists(filename)) {
         ESP_LOGI(TAG, "Calendar.csv does not exist, creating default...");
         if (!create_default_calendar(filename)) {
             ESP_LOGE(TAG, "Failed to create Calendar.csv");
-            sd_card_deinit();
+            sd_card_unmount();
             while(1) { vTaskDelay(pdMS_TO_TICKS(1000)); }
         }
     }
@@ -257,27 +281,26 @@ void check_calendar(void)
         ESP_LOGI(TAG, "Next recording change is immediate");
     }
 
-    sd_card_deinit();
+    sd_card_release();  // The recorder reuses the mount
 
     // ------------------- Execute recording or enter deep sleep -------------------
     if (current_value == RECORD_MODE) {
         char wav_filename[64];
-        generate_filename(wav_filename, sizeof(wav_filename));
+        generate_filename(wav_filename, sizeof(wav_filename), time(NULL));
         if (next_change == 0) {
-            // Continuous recording
-            while (1) {
-                if (!execute_recording_session(wav_filename, 60, true)) {
-                    ESP_LOGE(TAG, "Continuous recording failed");
-                    while(1) { vTaskDelay(pdMS_TO_TICKS(1000)); }
+            // Continuous recording with gapless hourly rollover; each retry remounts the card
+            for (int attempt = 1; !execute_continuous_recording(); attempt++) {
+                ESP_LOGE(TAG, "Continuous recording failed (attempt %d of %d)", attempt, RECORD_RETRIES);
+                if (attempt == RECORD_RETRIES) {
+                    enter_deep_sleep(RETRY_SLEEP_MINUTES); // Reboot and start over from the calendar
                 }
-                generate_filename(wav_filename, sizeof(wav_filename));
                 vTaskDelay(pdMS_TO_TICKS(1000));
             }
         } else {
             // Scheduled recording
             if (!execute_recording_session(wav_filename, next_change, false)) {
                 ESP_LOGE(TAG, "Recording failed");
-                while(1) { vTaskDelay(pdMS_TO_TICKS(1000)); }
+                enter_deep_sleep(RETRY_SLEEP_MINUTES); // The next wake records what is left of the slot
             }
             enter_deep_sleep(60); // Sleep 60 minutes
         }
@@ -7,6 +7,10 @@
 #define DAYS_IN_WEEK  7
 #define RECORD_MODE   1
 
+// Recuperación de fallos de grabación
+#define RECORD_RETRIES        3   // Consecutive continuous sessions tried before rebooting
+#define RETRY_SLEEP_MINUTES   1   // Deep sleep that reboots after a failed recording
+
 // Función pública
 void check_calendar(void);
 
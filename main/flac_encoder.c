@@ -0,0 +1,542 @@
+// flac_encoder.c
+#include "flac_encoder.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FLAC_MAX_RICE_PARAM 14      /**< Largest parameter of the 4-bit Rice coding method */
+
+static uint8_t crc8_table[256];
+static uint16_t crc16_table[256];
+static bool crc_ready = false;
+
+// ==================== CRC ====================
+/**
+ * @brief Build the frame header (CRC-8, poly 0x07) and frame (CRC-16, poly 0x8005) tables.
+ */
+static void crc_init(void)
+{
+    for (unsigned i = 0; i < 256; i++) {
+        uint8_t c8 = (uint8_t)i;
+        uint16_t c16 = (uint16_t)(i << 8);
+        for (int b = 0; b < 8; b++) {
+            c8 = (c8 & 0x80) ? (uint8_t)((c8 << 1) ^ 0x07) : (uint8_t)(c8 << 1);
+            c16 = (c16 & 0x8000) ? (uint16_t)((c16 << 1) ^ 0x8005) : (uint16_t)(c16 << 1);
+        }
+        crc8_table[i] = c8;
+        crc16_table[i] = c16;
+    }
+    crc_ready = true;
+}
+
+static uint8_t crc8(const uint8_t* p, size_t n)
+{
+    uint8_t c = 0;
+    while (n--) c = crc8_table[c ^ *p++];
+    return c;
+}
+
+static uint16_t crc16(const uint8_t* p, size_t n)
+{
+    uint16_t c = 0;
+    while (n--) c = (uint16_t)((c << 8) ^ crc16_table[(c >> 8) ^ *p++]);
+    return c;
+}
+
+// ==================== BIT WRITER ====================
+/** MSB-first bit packer */
+typedef struct {
+    uint8_t* buf;
+    size_t pos;         /**< Whole bytes written */
+    uint64_t acc;       /**< Pending bits (low `bits` bits are valid) */
+    unsigned bits;
+} bitwriter_t;
+
+/**
+ * @brief Append the low n bits of v (n <= 32).
+ */
+static inline void bw_put(bitwriter_t* bw, uint32_t v, unsigned n)
+{
+    if (n == 0) return;
+    bw->acc = (bw->acc << n) | (n < 32 ? (v & ((1u << n) - 1)) : v);
+    bw->bits += n;
+    while (bw->bits >= 8) {
+        bw->bits -= 8;
+        bw->buf[bw->pos++] = (uint8_t)(bw->acc >> bw->bits);
+    }
+}
+
+/**
+ * @brief Append a Rice code: (u >> k) zeros, a one, then the low k bits of u.
+ */
+static inline void bw_put_rice(bitwriter_t* bw, uint32_t u, unsigned k)
+{
+    uint32_t q = u >> k;
+    while (q > 31) {
+        bw_put(bw, 0, 31);
+        q -= 31;
+    }
+    bw_put(bw, 1, q + 1);
+    bw_put(bw, u, k);
+}
+
+/**
+ * @brief Append a frame number in FLAC's UTF-8-like variable-length code.
+ */
+static void bw_put_utf8(bitwriter_t* bw, uint32_t v)
+{
+    if (v < 0x80) {
+        bw_put(bw, v, 8);
+        return;
+    }
+
+    unsigned n = (v < 0x800) ? 2 : (v < 0x10000) ? 3 : (v < 0x200000) ? 4 : (v < 0x4000000) ? 5 : 6;
+    bw_put(bw, ((0xFF00u >> n) & 0xFF) | (v >> (6 * (n - 1))), 8);
+    for (int i = (int)n - 2; i >= 0; i--) bw_put(bw, 0x80 | ((v >> (6 * i)) & 0x3F), 8);
+}
+
+/**
+ * @brief Pad to the next byte boundary with zeros.
+ */
+static void bw_align(bitwriter_t* bw)
+{
+    if (bw->bits) bw_put(bw, 0, 8 - bw->bits);
+}
+
+// ==================== FRAME HEADER CODES ====================
+/**
+ * @brief Frame header sample-rate code, with the trailing field it needs.
+ * @param rate Sample rate in Hz
+ * @param extra Receives the value of the trailing field
+ * @param extra_bits Receives the width of the trailing field (0 = none)
+ */
+static unsigned rate_code(uint32_t rate, uint32_t* extra, unsigned* extra_bits)
+{
+    static const uint32_t rates[] = { 0, 88200, 176400, 192000, 8000, 16000, 22050,
+                                      24000, 32000, 44100, 48000, 96000 };
+    *extra = 0;
+    *extra_bits = 0;
+    for (unsigned i = 1; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i] == rate) return i;
+    }
+    if (rate % 1000 == 0 && rate / 1000 <= 255) { *extra = rate / 1000; *extra_bits = 8; return 12; }
+    if (rate <= 65535) { *extra = rate; *extra_bits = 16; return 13; }
+    if (rate % 10 == 0 && rate / 10 <= 65535) { *extra = rate / 10; *extra_bits = 16; return 14; }
+    return 0;   // Taken from STREAMINFO
+}
+
+/**
+ * @brief Frame header sample-size code.
+ */
+static unsigned size_code(unsigned bps)
+{
+    switch (bps) {
+        case 8:  return 1;
+        case 12: return 2;
+        case 16: return 4;
+        case 20: return 5;
+        case 24: return 6;
+        default: return 0;
+    }
+}
+
+// ==================== PREDICTION ====================
+/**
+ * @brief Pick the fixed predictor order with the smallest absolute residual.
+ * @param x Samples
+ * @param n Number of samples
+ * @param cost Receives the absolute residual sum of the chosen order
+ * @return Predictor order (0..FLAC_MAX_FIXED_ORDER)
+ */
+static unsigned fixed_select(const int32_t* x, uint32_t n, uint64_t* cost)
+{
+    uint64_t sum[FLAC_MAX_FIXED_ORDER + 1] = {0};
+
+    if (n <= FLAC_MAX_FIXED_ORDER) {
+        for (uint32_t i = 0; i < n; i++) sum[0] += (uint64_t)llabs(x[i]);
+        *cost = sum[0];
+        return 0;
+    }
+
+    // Successive differences of the last samples, carried across iterations
+    int32_t last0 = x[3];
+    int32_t last1 = x[3] - x[2];
+    int32_t last2 = last1 - (x[2] - x[1]);
+    int32_t last3 = last2 - (x[2] - x[1] - (x[1] - x[0]));
+
+    for (uint32_t i = FLAC_MAX_FIXED_ORDER; i < n; i++) {
+        int32_t e0 = x[i];
+        int32_t e1 = e0 - last0;
+        int32_t e2 = e1 - last1;
+        int32_t e3 = e2 - last2;
+        int32_t e4 = e3 - last3;
+        sum[0] += (uint32_t)abs(e0);
+        sum[1] += (uint32_t)abs(e1);
+        sum[2] += (uint32_t)abs(e2);
+        sum[3] += (uint32_t)abs(e3);
+        sum[4] += (uint32_t)abs(e4);
+        last0 = e0; last1 = e1; last2 = e2; last3 = e3;
+    }
+
+    unsigned order = 0;
+    for (unsigned o = 1; o <= FLAC_MAX_FIXED_ORDER; o++) {
+        if (sum[o] < sum[order]) order = o;
+    }
+    *cost = sum[order];
+    return order;
+}
+
+/**
+ * @brief Fixed predictor residuals, zigzag-mapped to unsigned, from index order on.
+ */
+static void fixed_residual(uint32_t* u, const int32_t* x, uint32_t n, unsigned order)
+{
+    for (uint32_t i = order; i < n; i++) {
+        int32_t r;
+        switch (order) {
+            case 0:  r = x[i]; break;
+            case 1:  r = x[i] - x[i - 1]; break;
+            case 2:  r = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+            case 3:  r = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+            default: r = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+        u[i] = ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+    }
+}
+
+// ==================== RICE CODING ====================
+/**
+ * @brief Rice parameter for a partition, from the sum of its zigzag residuals.
+ */
+static unsigned rice_param(uint64_t sum, uint32_t count)
+{
+    unsigned k = 0;
+    while (k < FLAC_MAX_RICE_PARAM && ((uint64_t)count << (k + 1)) < sum) k++;
+    return k;
+}
+
+/**
+ * @brief Choose the partition order and per-partition Rice parameters.
+ *
+ * Sums are computed once at the finest usable partition order and merged
+ * pairwise for each coarser order. The bit counts are upper bounds of the
+ * coded size (sum >> k >= sum of u >> k).
+ *
+ * @param enc Encoder (provides the partition sum scratch)
+ * @param u Zigzag residuals, valid from index order
+ * @param n Block size
+ * @param order Predictor order
+ * @param params Receives the Rice parameter of each partition
+ * @param porder Receives the partition order
+ * @return Bits needed for the partitions (parameters and codes)
+ */
+static uint64_t rice_plan(flac_encoder_t* enc, const uint32_t* u, uint32_t n, unsigned order,
+                          uint8_t* params, unsigned* porder)
+{
+    unsigned max_p = 0;
+    while (max_p < FLAC_MAX_PARTITION_ORDER && (n % (2u << max_p)) == 0 && (n >> (max_p + 1)) > order) {
+        max_p++;
+    }
+
+    uint64_t* sums = enc->part_sums;
+    uint32_t psize = n >> max_p;
+    for (uint32_t p = 0; p < (1u << max_p); p++) {
+        uint64_t s = 0;
+        for (uint32_t i = (p == 0) ? order : p * psize; i < (p + 1) * psize; i++) s += u[i];
+        sums[p] = s;
+    }
+
+    uint64_t best = UINT64_MAX;
+    uint8_t k[1 << FLAC_MAX_PARTITION_ORDER];
+    for (int po = (int)max_p; po >= 0; po--) {
+        uint32_t parts = 1u << po;
+        uint64_t bits = 0;
+        for (uint32_t j = 0; j < parts; j++) {
+            uint32_t count = (n >> po) - (j == 0 ? order : 0);
+            k[j] = (uint8_t)rice_param(sums[j], count);
+            bits += 4 + (uint64_t)count * (k[j] + 1) + (sums[j] >> k[j]);
+        }
+        if (bits < best) {
+            best = bits;
+            *porder = (unsigned)po;
+            memcpy(params, k, parts);
+        }
+        for (uint32_t j = 0; j < parts / 2; j++) sums[j] = sums[2 * j] + sums[2 * j + 1];
+    }
+    return best;
+}
+
+// ==================== SUBFRAMES ====================
+/**
+ * @brief Encode one channel of the block as the smallest of constant, fixed or verbatim.
+ */
+static void encode_subframe(flac_encoder_t* enc, bitwriter_t* bw, const int32_t* x, uint32_t n, unsigned bps)
+{
+    uint32_t i = 1;
+    while (i < n && x[i] == x[0]) i++;
+    if (i == n) {
+        bw_put(bw, 0x00, 8);            // Constant
+        bw_put(bw, (uint32_t)x[0], bps);
+        return;
+    }
+
+    uint64_t cost;
+    unsigned order = fixed_select(x, n, &cost);
+    fixed_residual(enc->residual, x, n, order);
+
+    uint8_t params[1 << FLAC_MAX_PARTITION_ORDER];
+    unsigned porder = 0;
+    uint64_t bits = 6 + (uint64_t)order * bps + rice_plan(enc, enc->residual, n, order, params, &porder);
+
+    if (bits >= (uint64_t)n * bps) {
+        bw_put(bw, 0x02, 8);            // Verbatim
+        for (i = 0; i < n; i++) bw_put(bw, (uint32_t)x[i], bps);
+        return;
+    }
+
+    bw_put(bw, (0x08 | order) << 1, 8); // Fixed, order in the low type bits
+    for (i = 0; i < order; i++) bw_put(bw, (uint32_t)x[i], bps);
+
+    bw_put(bw, 0, 2);                   // Rice coding, 4-bit parameters
+    bw_put(bw, porder, 4);
+    uint32_t psize = n >> porder;
+    for (uint32_t p = 0; p < (1u << porder); p++) {
+        unsigned k = params[p];
+        bw_put(bw, k, 4);
+        for (i = (p == 0) ? order : p * psize; i < (p + 1) * psize; i++) bw_put_rice(bw, enc->residual[i], k);
+    }
+}
+
+/**
+ * @brief Pick the stereo decorrelation with the smallest estimated residual.
+ * @param ch Receives the two channel buffers to encode
+ * @param ch_bps Receives their sample sizes (side needs one extra bit)
+ * @return Frame header channel assignment code
+ */
+static unsigned choose_stereo(flac_encoder_t* enc, uint32_t n, const int32_t* ch[2], unsigned ch_bps[2])
+{
+    const int32_t* l = enc->samples[0];
+    const int32_t* r = enc->samples[1];
+    for (uint32_t i = 0; i < n; i++) {
+        enc->side[i] = l[i] - r[i];
+        enc->mid[i] = (l[i] + r[i]) >> 1;
+    }
+
+    uint64_t cl, cr, cm, cs;
+    fixed_select(l, n, &cl);
+    fixed_select(r, n, &cr);
+    fixed_select(enc->mid, n, &cm);
+    fixed_select(enc->side, n, &cs);
+
+    unsigned bps = enc->fmt.bits_per_sample;
+    uint64_t best = cl + cr;
+    unsigned code = 1;
+    ch[0] = l; ch[1] = r; ch_bps[0] = bps; ch_bps[1] = bps;
+
+    if (cl + cs < best) { best = cl + cs; code = 8;  ch[0] = l;         ch[1] = enc->side; ch_bps[0] = bps;     ch_bps[1] = bps + 1; }
+    if (cs + cr < best) { best = cs + cr; code = 9;  ch[0] = enc->side; ch[1] = r;         ch_bps[0] = bps + 1; ch_bps[1] = bps; }
+    if (cm + cs < best) { best = cm + cs; code = 10; ch[0] = enc->mid;  ch[1] = enc->side; ch_bps[0] = bps;     ch_bps[1] = bps + 1; }
+    return code;
+}
+
+// ==================== API ====================
+/**
+ * @brief Allocate an encoder for the given PCM format.
+ * @param enc Encoder
+ * @param fmt Input format (16/24-bit, 1-2 channels)
+ * @param block_size Frames per FLAC frame (16..65535)
+ * @return false if the format is unsupported or allocation failed
+ */
+bool flac_encoder_init(flac_encoder_t* enc, const wav_format_t* fmt, uint32_t block_size)
+{
+    memset(enc, 0, sizeof(*enc));
+    if (fmt->bits_per_sample != 16 && fmt->bits_per_sample != 24) return false;
+    if (fmt->channels < 1 || fmt->channels > FLAC_MAX_CHANNELS) return false;
+    if (block_size < 16 || block_size > 65535) return false;
+    if (!crc_ready) crc_init();
+
+    enc->fmt = *fmt;
+    enc->block_size = block_size;
+
+    // Worst case is verbatim: frame header, one extra bit per side sample, CRC
+    enc->out_size = 18 + fmt->channels * (((size_t)block_size * (fmt->bits_per_sample + 1) + 7) / 8 + 1) + 2;
+    enc->out = malloc(enc->out_size);
+    enc->residual = malloc(block_size * sizeof(uint32_t));
+    bool ok = enc->out && enc->residual;
+
+    for (unsigned c = 0; c < fmt->channels; c++) {
+        enc->samples[c] = malloc(block_size * sizeof(int32_t));
+        ok = ok && enc->samples[c];
+    }
+    if (fmt->channels == 2) {
+        enc->mid = malloc(block_size * sizeof(int32_t));
+        enc->side = malloc(block_size * sizeof(int32_t));
+        ok = ok && enc->mid && enc->side;
+    }
+
+    if (!ok) {
+        flac_encoder_free(enc);
+        return false;
+    }
+    flac_encoder_reset(enc);
+    return true;
+}
+
+/**
+ * @brief Release the encoder buffers.
+ */
+void flac_encoder_free(flac_encoder_t* enc)
+{
+    for (unsigned c = 0; c < FLAC_MAX_CHANNELS; c++) {
+        free(enc->samples[c]);
+        enc->samples[c] = NULL;
+    }
+    free(enc->mid);
+    free(enc->side);
+    free(enc->residual);
+    free(enc->out);
+    enc->mid = enc->side = NULL;
+    enc->residual = NULL;
+    enc->out = NULL;
+}
+
+/**
+ * @brief Start a new stream (frame numbers and statistics restart at zero).
+ */
+void flac_encoder_reset(flac_encoder_t* enc)
+{
+    enc->fill = 0;
+    enc->frame_number = 0;
+    enc->total_samples = 0;
+    enc->min_frame_bytes = UINT32_MAX;
+    enc->max_frame_bytes = 0;
+}
+
+/**
+ * @brief Build the stream marker and STREAMINFO block.
+ *
+ * Written with final = false when the file is created, then rewritten in
+ * place with final = true once the stream is complete.
+ *
+ * @param enc Encoder
+ * @param buf Output, FLAC_STREAM_HEADER_SIZE bytes
+ * @param final Fill in the frame sizes and total sample count
+ * @return FLAC_STREAM_HEADER_SIZE
+ */
+size_t flac_encoder_stream_header(const flac_encoder_t* enc, uint8_t* buf, bool final)
+{
+    uint64_t total = final ? enc->total_samples : 0;
+    uint32_t min_frame = (final && enc->max_frame_bytes) ? enc->min_frame_bytes : 0;
+    uint32_t max_frame = final ? enc->max_frame_bytes : 0;
+
+    memcpy(buf, "fLaC", 4);
+    buf[4] = 0x80;                      // Last metadata block, type STREAMINFO
+    buf[5] = 0;
+    buf[6] = 0;
+    buf[7] = 34;
+
+    bitwriter_t bw = { buf + 8, 0, 0, 0 };
+    bw_put(&bw, enc->block_size, 16);
+    bw_put(&bw, enc->block_size, 16);
+    bw_put(&bw, min_frame, 24);
+    bw_put(&bw, max_frame, 24);
+    bw_put(&bw, enc->fmt.sample_rate, 20);
+    bw_put(&bw, enc->fmt.channels - 1, 3);
+    bw_put(&bw, enc->fmt.bits_per_sample - 1, 5);
+    bw_put(&bw, (uint32_t)(total >> 32), 4);
+    bw_put(&bw, (uint32_t)total, 32);
+    memset(buf + 8 + bw.pos, 0, 16);    // MD5 not computed
+    return FLAC_STREAM_HEADER_SIZE;
+}
+
+/**
+ * @brief Buffer interleaved little-endian PCM frames for the next FLAC frame.
+ * @param enc Encoder
+ * @param pcm Frames in the input format
+ * @param frames Number of frames available
+ * @return Frames taken (stops when the block is full)
+ */
+size_t flac_encoder_feed(flac_encoder_t* enc, const uint8_t* pcm, size_t frames)
+{
+    size_t room = enc->block_size - enc->fill;
+    if (frames > room) frames = room;
+
+    unsigned channels = enc->fmt.channels;
+    uint32_t pos = enc->fill;
+    if (enc->fmt.bits_per_sample == 16) {
+        for (size_t f = 0; f < frames; f++, pos++) {
+            for (unsigned c = 0; c < channels; c++, pcm += 2) {
+                enc->samples[c][pos] = (int16_t)(pcm[0] | pcm[1] << 8);
+            }
+        }
+    } else {
+        for (size_t f = 0; f < frames; f++, pos++) {
+            for (unsigned c = 0; c < channels; c++, pcm += 3) {
+                enc->samples[c][pos] = (int32_t)((uint32_t)pcm[0] << 8 | (uint32_t)pcm[1] << 16 |
+                                                 (uint32_t)pcm[2] << 24) >> 8;
+            }
+        }
+    }
+
+    enc->fill = pos;
+    return frames;
+}
+
+/**
+ * @brief Whether a whole block is buffered and should be encoded.
+ */
+bool flac_encoder_block_full(const flac_encoder_t* enc)
+{
+    return enc->fill == enc->block_size;
+}
+
+/**
+ * @brief Encode the buffered frames as one FLAC frame.
+ *
+ * Call when flac_encoder_block_full(), and once more at the end of the
+ * stream for the final short block.
+ *
+ * @param enc Encoder
+ * @param out Receives the encoded frame (valid until the next call)
+ * @return Encoded bytes, 0 if nothing was buffered
+ */
+size_t flac_encoder_encode(flac_encoder_t* enc, const uint8_t** out)
+{
+    uint32_t n = enc->fill;
+    if (n == 0) return 0;
+
+    unsigned bps = enc->fmt.bits_per_sample;
+    const int32_t* ch[FLAC_MAX_CHANNELS] = { enc->samples[0], enc->samples[1] };
+    unsigned ch_bps[FLAC_MAX_CHANNELS] = { bps, bps };
+    unsigned assignment = enc->fmt.channels - 1;
+    if (enc->fmt.channels == 2) assignment = choose_stereo(enc, n, ch, ch_bps);
+
+    uint32_t rate_extra;
+    unsigned rate_extra_bits;
+    unsigned rate = rate_code(enc->fmt.sample_rate, &rate_extra, &rate_extra_bits);
+
+    bitwriter_t bw = { enc->out, 0, 0, 0 };
+    bw_put(&bw, 0xFFF8, 16);            // Sync, fixed block size
+    bw_put(&bw, 7, 4);                  // Block size - 1 follows as 16 bits
+    bw_put(&bw, rate, 4);
+    bw_put(&bw, assignment, 4);
+    bw_put(&bw, size_code(bps), 3);
+    bw_put(&bw, 0, 1);
+    bw_put_utf8(&bw, enc->frame_number);
+    bw_put(&bw, n - 1, 16);
+    bw_put(&bw, rate_extra, rate_extra_bits);
+    bw_put(&bw, crc8(enc->out, bw.pos), 8);
+
+    for (unsigned c = 0; c < enc->fmt.channels; c++) encode_subframe(enc, &bw, ch[c], n, ch_bps[c]);
+
+    bw_align(&bw);
+    bw_put(&bw, crc16(enc->out, bw.pos), 16);
+
+    if (bw.pos < enc->min_frame_bytes) enc->min_frame_bytes = (uint32_t)bw.pos;
+    if (bw.pos > enc->max_frame_bytes) enc->max_frame_bytes = (uint32_t)bw.pos;
+    enc->frame_number++;
+    enc->total_samples += n;
+    enc->fill = 0;
+
+    *out = enc->out;
+    return bw.pos;
+}
@@ -0,0 +1,60 @@
+#ifndef FLAC_ENCODER_H
+#define FLAC_ENCODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "wav_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define FLAC_STREAM_HEADER_SIZE 42          /**< "fLaC" + STREAMINFO block */
+#define FLAC_DEFAULT_BLOCK_SIZE 4096        /**< Frames per FLAC frame */
+#define FLAC_MAX_CHANNELS 2
+#define FLAC_MAX_FIXED_ORDER 4
+#define FLAC_MAX_PARTITION_ORDER 8
+
+/**
+ * @brief Streaming FLAC encoder state.
+ *
+ * Buffers one block of PCM, then encodes it as a FLAC frame using the
+ * fixed polynomial predictors (orders 0-4), partitioned Rice coding and,
+ * for stereo, the cheapest of independent/left-side/side-right/mid-side
+ * channel coding. 16- and 24-bit input only. The MD5 signature in
+ * STREAMINFO is left zero ("not computed"), which decoders accept.
+ */
+typedef struct {
+    wav_format_t fmt;                           /**< Input PCM format */
+    uint32_t block_size;                        /**< Frames per FLAC frame */
+    uint32_t fill;                              /**< Frames buffered for the next frame */
+    uint32_t frame_number;                      /**< Index of the next FLAC frame */
+    uint64_t total_samples;                     /**< Frames encoded so far */
+    uint32_t min_frame_bytes;                   /**< Smallest encoded frame */
+    uint32_t max_frame_bytes;                   /**< Largest encoded frame */
+    int32_t* samples[FLAC_MAX_CHANNELS];        /**< Deinterleaved block */
+    int32_t* mid;                               /**< Mid channel scratch (stereo) */
+    int32_t* side;                              /**< Side channel scratch (stereo) */
+    uint32_t* residual;                         /**< Zigzag residual scratch */
+    uint64_t part_sums[1 << FLAC_MAX_PARTITION_ORDER]; /**< Rice partition sums */
+    uint8_t* out;                               /**< Encoded frame */
+    size_t out_size;                            /**< Capacity of out */
+} flac_encoder_t;
+
+// ==================== API PÚBLICA ====================
+bool flac_encoder_init(flac_encoder_t* enc, const wav_format_t* fmt, uint32_t block_size);
+void flac_encoder_free(flac_encoder_t* enc);
+void flac_encoder_reset(flac_encoder_t* enc);
+
+size_t flac_encoder_stream_header(const flac_encoder_t* enc, uint8_t* buf, bool final);
+size_t flac_encoder_feed(flac_encoder_t* enc, const uint8_t* pcm, size_t frames);
+bool flac_encoder_block_full(const flac_encoder_t* enc);
+size_t flac_encoder_encode(flac_encoder_t* enc, const uint8_t** out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLAC_ENCODER_H
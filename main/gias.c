@@ -9,6 +9,8 @@
 #include "calendar.h"
 #include "rtc_updater.h"
 #include "esp_log.h"
+#include "gias.h"
+#include "audio_bench.h"
 
 static const char *TAG = "GIAS";  // Log tag
 
@@ -54,25 +56,31 @@ static bool ensure_config_file(const char *path)
  */
 void check_configuration(void)
 {
-    sd_card_init();
+    sd_card_acquire();
+
+    // Reformat aligned to the card's AU if asked to (config.txt and Calendar.csv are kept).
+    // The request is consumed either way; a card that was not formatted is used as it is
+    if (sd_card_exists(SD_PREPARE_FILE) && !sd_card_prepare()) {
+        ESP_LOGE(TAG, "Card preparation failed. Continuing with the card as it is");
+    }
 
     // Ensure configuration file exists
     if (!ensure_config_file("/config.txt")) {
-        sd_card_deinit();
+        sd_card_unmount();
         while(1) { vTaskDelay(pdMS_TO_TICKS(1000)); }
     }
 
     wifi_config_t config;
     if (!read_config_file("/config.txt", &config)) {
         ESP_LOGE(TAG, "Failed to read /config.txt");
-        sd_card_deinit();
+        sd_card_unmount();
         while(1) { vTaskDelay(pdMS_TO_TICKS(1000)); }
     }
 
     // Check for default/invalid credentials
     if (strcmp(config.ssid, "YOUR_SSID") == 0 || strcmp(config.password, "YOUR_SSID_PASSWORD") == 0) {
         ESP_LOGE(TAG, "SSID or password not set. Halting...");
-        sd_card_deinit();
+        sd_card_unmount();
         while(1) { vTaskDelay(pdMS_TO_TICKS(1000)); }
     }
 
@@ -82,7 +90,7 @@ void check_configuration(void)
     strcpy(creds.password, config.password);
     update_rtc_via_wifi(&creds);
 
-    sd_card_deinit();
+    sd_card_release();  // Stays mounted for check_calendar()
 }
 
 /**
@@ -91,6 +99,9 @@ void check_configuration(void)
 void gias(void)
 {
     print_cpu_info();  // Debug CPU frequency
+#if GIAS_RUN_BENCHMARKS
+    audio_bench_run(); // Capture kernel costs
+#endif
     led_init();        // Initialize LEDs
     init_nvs();        // Initialize NVS (WiFi and RTC)
 
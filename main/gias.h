@@ -6,6 +6,9 @@
 #include "freertos/task.h"
 #include "sd_mmc.h"
 
+// Set to 1 to log capture kernel costs (cycles/sample) at boot
+#define GIAS_RUN_BENCHMARKS 0
+
 /**
  * @brief Main GIAS function to initialize and run the system.
  */
@@ -0,0 +1,249 @@
+// ima_adpcm.c
+#include "ima_adpcm.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+    12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+#define CLAMP(v, lo, hi) ((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+// ==================== KERNELS ====================
+/**
+ * @brief Quantize one sample to a 4-bit code and update the predictor.
+ *
+ * Successive approximation against step, step/2 and step/4 written with
+ * masks instead of branches, so it compiles to conditional moves. vpdiff
+ * is accumulated exactly as the decoder reconstructs it, keeping encoder
+ * and decoder predictors in lockstep.
+ */
+static inline uint8_t encode_sample(int32_t* pred, int32_t* index, int32_t sample)
+{
+    int32_t step = step_table[*index];
+    int32_t diff = sample - *pred;
+    int32_t sign = diff >> 31;                  // 0 or -1
+    uint32_t code = (uint32_t)sign & 8;
+    diff = (diff ^ sign) - sign;
+
+    int32_t vpdiff = step >> 3;
+    int32_t m;
+    m = -(int32_t)(diff >= step); code |= 4 & m; diff -= step & m; vpdiff += step & m;
+    step >>= 1;
+    m = -(int32_t)(diff >= step); code |= 2 & m; diff -= step & m; vpdiff += step & m;
+    step >>= 1;
+    m = -(int32_t)(diff >= step); code |= 1 & m;                   vpdiff += step & m;
+
+    int32_t p = *pred + ((vpdiff ^ sign) - sign);
+    *pred = CLAMP(p, -32768, 32767);
+    int32_t i = *index + index_table[code];
+    *index = CLAMP(i, 0, 88);
+    return (uint8_t)code;
+}
+
+/**
+ * @brief Reconstruct one sample from its 4-bit code and update the predictor.
+ */
+static inline int16_t decode_sample(int32_t* pred, int32_t* index, uint8_t code)
+{
+    int32_t step = step_table[*index];
+    int32_t vpdiff = step >> 3;
+    if (code & 4) vpdiff += step;
+    if (code & 2) vpdiff += step >> 1;
+    if (code & 1) vpdiff += step >> 2;
+
+    int32_t p = (code & 8) ? *pred - vpdiff : *pred + vpdiff;
+    *pred = CLAMP(p, -32768, 32767);
+    int32_t i = *index + index_table[code];
+    *index = CLAMP(i, 0, 88);
+    return (int16_t)*pred;
+}
+
+/**
+ * @brief Byte holding samples j and j+1 (j even, counted after the header sample).
+ *
+ * Data follows the block headers as groups of 8 samples (4 bytes) per
+ * channel, channels interleaved group by group; low nibble first.
+ */
+static inline size_t nibble_byte(uint32_t j, uint16_t channels, uint16_t c)
+{
+    return 4u * channels + (j >> 3) * 4u * channels + c * 4u + ((j & 7) >> 1);
+}
+
+/**
+ * @brief Encode one block.
+ * @param pcm Interleaved input, samples_per_block frames
+ * @param out Output, block_align bytes
+ * @param channels Interleaved channels
+ * @param samples_per_block Frames per block
+ * @param step_index Per-channel quantizer state, updated
+ */
+void ima_adpcm_encode_block(const int16_t* pcm, uint8_t* out, uint16_t channels,
+                            uint32_t samples_per_block, int8_t* step_index)
+{
+    for (uint16_t c = 0; c < channels; c++) {
+        int32_t pred = pcm[c];
+        int32_t index = step_index[c];
+
+        uint8_t* hdr = out + 4 * c;
+        hdr[0] = (uint8_t)pred;
+        hdr[1] = (uint8_t)(pred >> 8);
+        hdr[2] = (uint8_t)index;
+        hdr[3] = 0;
+
+        const int16_t* x = pcm + channels + c;
+        for (uint32_t j = 0; j + 1 < samples_per_block; j += 2, x += 2 * channels) {
+            uint8_t lo = encode_sample(&pred, &index, x[0]);
+            uint8_t hi = encode_sample(&pred, &index, x[channels]);
+            out[nibble_byte(j, channels, c)] = (uint8_t)(lo | (hi << 4));
+        }
+        step_index[c] = (int8_t)index;
+    }
+}
+
+/**
+ * @brief Decode one block.
+ * @param in Encoded block
+ * @param pcm Interleaved output, samples_per_block frames
+ * @param channels Interleaved channels
+ * @param samples_per_block Frames per block
+ */
+void ima_adpcm_decode_block(const uint8_t* in, int16_t* pcm, uint16_t channels, uint32_t samples_per_block)
+{
+    for (uint16_t c = 0; c < channels; c++) {
+        const uint8_t* hdr = in + 4 * c;
+        int32_t pred = (int16_t)(hdr[0] | hdr[1] << 8);
+        int32_t index = CLAMP(hdr[2], 0, 88);
+        pcm[c] = (int16_t)pred;
+
+        int16_t* x = pcm + channels + c;
+        for (uint32_t j = 0; j + 1 < samples_per_block; j += 2, x += 2 * channels) {
+            uint8_t b = in[nibble_byte(j, channels, c)];
+            x[0] = decode_sample(&pred, &index, b & 0x0F);
+            x[channels] = decode_sample(&pred, &index, b >> 4);
+        }
+    }
+}
+
+// ==================== BLOCK GEOMETRY ====================
+/**
+ * @brief Conventional block size for a sample rate (256/512/1024 bytes per channel).
+ */
+uint32_t ima_adpcm_block_align(uint32_t sample_rate, uint16_t channels)
+{
+    uint32_t per_channel = (sample_rate <= 11025) ? 256 : (sample_rate <= 22050) ? 512 : 1024;
+    return per_channel * channels;
+}
+
+/**
+ * @brief Frames held by a block: the header sample plus two per data byte.
+ */
+uint32_t ima_adpcm_samples_per_block(uint32_t block_align, uint16_t channels)
+{
+    return (block_align - 4u * channels) * 2u / channels + 1u;
+}
+
+// ==================== STREAMING ENCODER ====================
+/**
+ * @brief Allocate an encoder.
+ * @param enc Encoder
+ * @param channels 1 or 2
+ * @param block_align Bytes per block, a multiple of 4 * channels
+ * @return false if the parameters are invalid or allocation failed
+ */
+bool ima_adpcm_encoder_init(ima_adpcm_encoder_t* enc, uint16_t channels, uint32_t block_align)
+{
+    memset(enc, 0, sizeof(*enc));
+    if (channels < 1 || channels > IMA_ADPCM_MAX_CHANNELS) return false;
+    if (block_align <= 4u * channels || block_align % (4u * channels) != 0) return false;
+
+    enc->channels = channels;
+    enc->block_align = block_align;
+    enc->samples_per_block = ima_adpcm_samples_per_block(block_align, channels);
+    enc->pcm = malloc(enc->samples_per_block * channels * sizeof(int16_t));
+    enc->out = malloc(block_align);
+    if (!enc->pcm || !enc->out) {
+        ima_adpcm_encoder_free(enc);
+        return false;
+    }
+    ima_adpcm_encoder_reset(enc);
+    return true;
+}
+
+/**
+ * @brief Release the encoder buffers.
+ */
+void ima_adpcm_encoder_free(ima_adpcm_encoder_t* enc)
+{
+    free(enc->pcm);
+    free(enc->out);
+    enc->pcm = NULL;
+    enc->out = NULL;
+}
+
+/**
+ * @brief Start a new stream.
+ */
+void ima_adpcm_encoder_reset(ima_adpcm_encoder_t* enc)
+{
+    enc->fill = 0;
+    enc->total_frames = 0;
+    enc->blocks = 0;
+    memset(enc->step_index, 0, sizeof(enc->step_index));
+}
+
+/**
+ * @brief Buffer interleaved 16-bit frames for the next block.
+ * @return Frames taken (stops when the block is full)
+ */
+size_t ima_adpcm_encoder_feed(ima_adpcm_encoder_t* enc, const int16_t* pcm, size_t frames)
+{
+    size_t room = enc->samples_per_block - enc->fill;
+    if (frames > room) frames = room;
+
+    memcpy(enc->pcm + (size_t)enc->fill * enc->channels, pcm, frames * enc->channels * sizeof(int16_t));
+    enc->fill += (uint32_t)frames;
+    return frames;
+}
+
+/**
+ * @brief Whether a whole block is buffered and should be encoded.
+ */
+bool ima_adpcm_encoder_block_full(const ima_adpcm_encoder_t* enc)
+{
+    return enc->fill == enc->samples_per_block;
+}
+
+/**
+ * @brief Encode the buffered frames as one block, padding a short final block.
+ * @param enc Encoder
+ * @param out Receives the block (valid until the next call)
+ * @return block_align, or 0 if nothing was buffered
+ */
+size_t ima_adpcm_encoder_encode(ima_adpcm_encoder_t* enc, const uint8_t** out)
+{
+    if (enc->fill == 0) return 0;
+
+    const size_t ch = enc->channels;
+    for (uint32_t f = enc->fill; f < enc->samples_per_block; f++) {
+        memcpy(enc->pcm + f * ch, enc->pcm + (enc->fill - 1) * ch, ch * sizeof(int16_t));
+    }
+
+    ima_adpcm_encode_block(enc->pcm, enc->out, enc->channels, enc->samples_per_block, enc->step_index);
+    enc->total_frames += enc->fill;
+    enc->blocks++;
+    enc->fill = 0;
+
+    *out = enc->out;
+    return enc->block_align;
+}
@@ -0,0 +1,55 @@
+#ifndef IMA_ADPCM_H
+#define IMA_ADPCM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define IMA_ADPCM_MAX_CHANNELS 2
+
+/**
+ * @brief Block-based IMA ADPCM encoder (WAV format tag 0x0011).
+ *
+ * 16-bit PCM in, 4 bits per sample out. Each block starts with a 4-byte
+ * header per channel (first sample + step index), so blocks decode
+ * independently; the step index carries across blocks. The final block
+ * is padded by repeating the last frame; the real length goes in the
+ * WAV fact chunk.
+ */
+typedef struct {
+    uint16_t channels;                          /**< Interleaved channels */
+    uint32_t block_align;                       /**< Bytes per encoded block */
+    uint32_t samples_per_block;                 /**< Frames per encoded block */
+    uint32_t fill;                              /**< Frames buffered for the next block */
+    uint64_t total_frames;                      /**< Real frames encoded (padding excluded) */
+    uint32_t blocks;                            /**< Blocks encoded */
+    int8_t step_index[IMA_ADPCM_MAX_CHANNELS];  /**< Quantizer state per channel */
+    int16_t* pcm;                               /**< Interleaved input block */
+    uint8_t* out;                               /**< Encoded block */
+} ima_adpcm_encoder_t;
+
+// ==================== API PÚBLICA ====================
+uint32_t ima_adpcm_block_align(uint32_t sample_rate, uint16_t channels);
+uint32_t ima_adpcm_samples_per_block(uint32_t block_align, uint16_t channels);
+
+bool ima_adpcm_encoder_init(ima_adpcm_encoder_t* enc, uint16_t channels, uint32_t block_align);
+void ima_adpcm_encoder_free(ima_adpcm_encoder_t* enc);
+void ima_adpcm_encoder_reset(ima_adpcm_encoder_t* enc);
+size_t ima_adpcm_encoder_feed(ima_adpcm_encoder_t* enc, const int16_t* pcm, size_t frames);
+bool ima_adpcm_encoder_block_full(const ima_adpcm_encoder_t* enc);
+size_t ima_adpcm_encoder_encode(ima_adpcm_encoder_t* enc, const uint8_t** out);
+
+void ima_adpcm_encode_block(const int16_t* pcm, uint8_t* out, uint16_t channels,
+                            uint32_t samples_per_block, int8_t* step_index);
+void ima_adpcm_decode_block(const uint8_t* in, int16_t* pcm, uint16_t channels, uint32_t samples_per_block);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMA_ADPCM_H
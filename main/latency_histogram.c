@@ -0,0 +1,74 @@
+// latency_histogram.c
+#include "latency_histogram.h"
+#include <string.h>
+
+#define SUB_BITS 2      // log2(LATENCY_HISTOGRAM_SUB)
+
+/**
+ * @brief Bucket of a value: the power of two above the sub-range, then the next SUB_BITS bits.
+ */
+static uint32_t bucket_of(uint32_t value)
+{
+    if (value < LATENCY_HISTOGRAM_SUB) return value;
+    uint32_t octave = 31 - (uint32_t)__builtin_clz(value);
+    uint32_t sub = (value >> (octave - SUB_BITS)) & (LATENCY_HISTOGRAM_SUB - 1);
+    return (octave - SUB_BITS + 1) * LATENCY_HISTOGRAM_SUB + sub;
+}
+
+/**
+ * @brief Largest value that falls in a bucket.
+ */
+static uint32_t bucket_upper(uint32_t bucket)
+{
+    if (bucket < LATENCY_HISTOGRAM_SUB) return bucket;
+    uint32_t shift = bucket / LATENCY_HISTOGRAM_SUB - 1;
+    uint32_t sub = bucket % LATENCY_HISTOGRAM_SUB;
+    uint64_t lower = (uint64_t)(LATENCY_HISTOGRAM_SUB + sub) << shift;
+    return (uint32_t)(lower + ((uint64_t)1 << shift) - 1);
+}
+
+/**
+ * @brief Clear the histogram.
+ */
+void latency_histogram_reset(latency_histogram_t* hist)
+{
+    memset(hist, 0, sizeof(*hist));
+}
+
+/**
+ * @brief Count one duration.
+ */
+void latency_histogram_add(latency_histogram_t* hist, uint32_t value)
+{
+    hist->counts[bucket_of(value)]++;
+    hist->samples++;
+    hist->sum += value;
+    if (value > hist->max) hist->max = value;
+}
+
+/**
+ * @brief Value below which per_mille of the samples fall.
+ *
+ * Returns the upper edge of the bucket holding that rank (never more
+ * than the maximum seen), so the estimate errs on the slow side.
+ *
+ * @param hist Histogram
+ * @param per_mille Rank, e.g. 500 for the median or 990 for p99
+ * @return Percentile, 0 if the histogram is empty
+ */
+uint32_t latency_histogram_percentile(const latency_histogram_t* hist, uint32_t per_mille)
+{
+    if (hist->samples == 0) return 0;
+    uint64_t rank = ((uint64_t)hist->samples * per_mille + 999) / 1000;
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < LATENCY_HISTOGRAM_BUCKETS; b++) {
+        seen += hist->counts[b];
+        if (seen >= rank) {
+            uint32_t upper = bucket_upper(b);
+            return (upper < hist->max) ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
@@ -0,0 +1,38 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define LATENCY_HISTOGRAM_SUB 4                             /**< Buckets per power of two */
+#define LATENCY_HISTOGRAM_BUCKETS (32 * LATENCY_HISTOGRAM_SUB)  /**< Covers the whole uint32_t range */
+
+/**
+ * @brief Log-bucketed histogram of durations.
+ *
+ * Values below LATENCY_HISTOGRAM_SUB get a bucket each; above that every
+ * power of two is split into LATENCY_HISTOGRAM_SUB equal buckets, so a
+ * percentile is resolved to within 25% of its value whatever the range,
+ * in a fixed 512-byte table that is cheap to update.
+ */
+typedef struct {
+    uint32_t counts[LATENCY_HISTOGRAM_BUCKETS];
+    uint32_t samples;           /**< Values added */
+    uint32_t max;               /**< Largest value added */
+    uint64_t sum;               /**< Sum of the values */
+} latency_histogram_t;
+
+// ==================== API PÚBLICA ====================
+void latency_histogram_reset(latency_histogram_t* hist);
+void latency_histogram_add(latency_histogram_t* hist, uint32_t value);
+uint32_t latency_histogram_percentile(const latency_histogram_t* hist, uint32_t per_mille);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_HISTOGRAM_H
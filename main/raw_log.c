@@ -0,0 +1,258 @@
+// raw_log.c
+#include "raw_log.h"
+#include "raw_log_format.h"
+#include "sd_mmc.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char* TAG = "RAW_LOG";
+
+#define SEGMENT_BYTES (RAW_LOG_SEGMENT_SECTORS * RAW_LOG_SECTOR_SIZE)
+
+// Session state (one writer: the recorder's SD task)
+static uint8_t* segment = NULL;         /**< Slot image: header sector, then payload; DMA-capable */
+static uint32_t part_first = 0;         /**< Card sector of the partition */
+static raw_log_super_t super;           /**< Superblock; head_slot and next_sequence are live */
+static raw_log_segment_t current;       /**< Header of the segment being filled */
+
+/**
+ * @brief Card sector of a slot.
+ */
+static uint32_t slot_sector(uint32_t slot)
+{
+    return part_first + super.first_sector + slot * super.segment_sectors;
+}
+
+/**
+ * @brief Record head_slot, next_sequence and next_session in sector 0 of the partition.
+ *
+ * Uses the header sector of the slot image, which is only filled when a
+ * segment is written.
+ */
+static bool write_super(void)
+{
+    raw_log_seal_super(&super);
+    memset(segment, 0, RAW_LOG_SECTOR_SIZE);
+    memcpy(segment, &super, sizeof(super));
+    return sd_card_write_sectors(segment, part_first, 1);
+}
+
+/**
+ * @brief Rebuild the superblock from the segments on the card.
+ *
+ * Reads the header of every slot: the log continues after the segment
+ * with the highest sequence, and session numbers after the highest
+ * session, so nothing already on the card is reused. A partition with no
+ * valid segment starts empty.
+ *
+ * @param sectors Size of the partition
+ */
+static bool rebuild_super(uint32_t sectors)
+{
+    memset(&super, 0, sizeof(super));
+    super.segment_sectors = RAW_LOG_SEGMENT_SECTORS;
+    super.first_sector = 1;
+    super.slots = (sectors - 1) / RAW_LOG_SEGMENT_SECTORS;
+    super.next_sequence = 1;
+    super.next_session = 1;
+
+    const raw_log_segment_t* seg = (const raw_log_segment_t*)segment;
+    uint32_t found = 0;
+    for (uint32_t slot = 0; slot < super.slots; slot++) {
+        if (!sd_card_read_sectors(segment, slot_sector(slot), 1)) return false;
+        if (!raw_log_segment_valid(seg)) continue;
+        found++;
+        if (seg->sequence >= super.next_sequence) {
+            super.next_sequence = seg->sequence + 1;
+            super.head_slot = (slot + 1) % super.slots;
+        }
+        if (seg->session >= super.next_session) super.next_session = seg->session + 1;
+    }
+
+    if (found == 0) {
+        ESP_LOGW(TAG, "Initializing raw log: %lu slots of %u KB at sector %lu",
+                 (unsigned long)super.slots, SEGMENT_BYTES / 1024, (unsigned long)part_first);
+    } else {
+        ESP_LOGW(TAG, "Raw log superblock damaged, rebuilt from %lu segment(s): next session %lu at slot %lu",
+                 (unsigned long)found, (unsigned long)super.next_session, (unsigned long)super.head_slot);
+    }
+    return write_super();
+}
+
+/**
+ * @brief Locate the partition and load its superblock, rebuilding it if it is missing or damaged.
+ */
+static bool load_super(void)
+{
+    uint32_t sectors;
+    if (!sd_card_read_sectors(segment, 0, 1)) return false;
+    if (!raw_log_find_partition(segment, &part_first, &sectors)) {
+        ESP_LOGE(TAG, "No raw log partition (MBR type 0x%02X) on the card", RAW_LOG_PARTITION_TYPE);
+        return false;
+    }
+
+    if (!sd_card_read_sectors(segment, part_first, 1)) return false;
+    memcpy(&super, segment, sizeof(super));
+    if (raw_log_super_valid(&super)) {
+        if (super.segment_sectors != RAW_LOG_SEGMENT_SECTORS ||
+            super.first_sector + (uint64_t)super.slots * super.segment_sectors > sectors) {
+            ESP_LOGE(TAG, "Raw log superblock does not match this firmware or partition");
+            return false;
+        }
+        return true;
+    }
+
+    // First use of the partition, or a torn superblock write (power loss during a checkpoint)
+    return rebuild_super(sectors);
+}
+
+/**
+ * @brief Advance head_slot over segments written after the last checkpoint.
+ *
+ * Follows the sequence chain from the superblock's head; the first slot
+ * that is not the next segment of the log (invalid, never written or
+ * left from the previous lap) is where writing resumes.
+ */
+static bool find_head(void)
+{
+    const raw_log_segment_t* seg = (const raw_log_segment_t*)segment;
+    uint32_t found = 0;
+
+    while (found < super.slots) {
+        if (!sd_card_read_sectors(segment, slot_sector(super.head_slot), 1)) return false;
+        if (!raw_log_segment_valid(seg) || seg->sequence != super.next_sequence) break;
+        if (seg->session >= super.next_session) super.next_session = seg->session + 1;
+        super.next_sequence++;
+        super.head_slot = (super.head_slot + 1) % super.slots;
+        found++;
+    }
+    if (found > 0) ESP_LOGW(TAG, "%lu segment(s) after the last checkpoint recovered", (unsigned long)found);
+    return true;
+}
+
+/**
+ * @brief Write the segment being filled to the head slot.
+ *
+ * Only the sectors holding data are written. With advance the segment is
+ * complete and the head moves on; without, it is a snapshot that a later
+ * write of the same slot (same sequence) replaces.
+ *
+ * @param flags RAW_LOG_FLAG_* for the header
+ */
+static bool write_segment(uint16_t flags, bool advance)
+{
+    uint8_t* payload = segment + RAW_LOG_SECTOR_SIZE;
+    uint32_t used = (current.payload_bytes + RAW_LOG_SECTOR_SIZE - 1) / RAW_LOG_SECTOR_SIZE;
+    memset(payload + current.payload_bytes, 0, used * RAW_LOG_SECTOR_SIZE - current.payload_bytes);
+
+    current.sequence = super.next_sequence;
+    current.flags = flags;
+    raw_log_seal_segment(&current, payload);
+    memset(segment, 0, RAW_LOG_SECTOR_SIZE);
+    memcpy(segment, &current, sizeof(current));
+
+    if (!sd_card_write_sectors(segment, slot_sector(super.head_slot), 1 + used)) return false;
+    if (advance) {
+        super.next_sequence++;
+        super.head_slot = (super.head_slot + 1) % super.slots;
+        current.index++;
+        current.stream_offset += current.payload_bytes;
+        current.payload_bytes = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Start a session at the head of the raw log.
+ *
+ * The card must be acquired. Finds the raw partition, creates its
+ * superblock on first use and skips segments written since the last
+ * checkpoint (a session cut by a power loss). When the log is full the
+ * oldest segments are overwritten.
+ *
+ * @param name File name the session would have on FAT, kept for extraction
+ * @param start Session start time
+ * @param fmt PCM format of the audio that will be written
+ * @return false if there is no usable raw partition
+ */
+bool raw_log_begin(const char* name, time_t start, const wav_format_t* fmt)
+{
+    segment = heap_caps_malloc(SEGMENT_BYTES, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (!segment) {
+        ESP_LOGE(TAG, "Cannot allocate the %u KB segment buffer", SEGMENT_BYTES / 1024);
+        return false;
+    }
+    if (!load_super() || !find_head()) {
+        raw_log_end();
+        return false;
+    }
+
+    memset(&current, 0, sizeof(current));
+    current.session = super.next_session++;
+    current.start_time = (int64_t)start;
+    current.sample_rate = fmt->sample_rate;
+    current.channels = fmt->channels;
+    current.bits_per_sample = fmt->bits_per_sample;
+    while (*name == '/') name++;
+    strncpy(current.name, name, sizeof(current.name) - 1);
+
+    ESP_LOGI(TAG, "Session %lu at slot %lu of %lu", (unsigned long)current.session,
+             (unsigned long)super.head_slot, (unsigned long)super.slots);
+    return write_super();
+}
+
+/**
+ * @brief Append audio to the session; full segments go to the card as one write.
+ * @return Bytes accepted (less than len on error)
+ */
+size_t raw_log_write(const void* data, size_t len)
+{
+    const uint8_t* in = (const uint8_t*)data;
+    size_t done = 0;
+    while (done < len) {
+        size_t n = RAW_LOG_SEGMENT_PAYLOAD - current.payload_bytes;
+        if (n > len - done) n = len - done;
+        memcpy(segment + RAW_LOG_SECTOR_SIZE + current.payload_bytes, in + done, n);
+        current.payload_bytes += n;
+        done += n;
+        if (current.payload_bytes == RAW_LOG_SEGMENT_PAYLOAD && !write_segment(0, true)) {
+            current.payload_bytes -= n;
+            return done - n;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief Put the partial segment on the card and record the head in the superblock.
+ *
+ * After a power loss the session then reads back up to this point, and
+ * the next session starts without scanning far.
+ */
+bool raw_log_checkpoint(void)
+{
+    bool ok = current.payload_bytes == 0 || write_segment(0, false);
+    return write_super() && ok;
+}
+
+/**
+ * @brief Write the last segment, update the superblock and free the buffer.
+ * @return false if the end of the session could not be written
+ */
+bool raw_log_end(void)
+{
+    if (!segment) return true;
+
+    bool ok = true;
+    if (current.session != 0) {
+        if (current.payload_bytes > 0) ok = write_segment(RAW_LOG_FLAG_LAST, true);
+        ok = write_super() && ok;
+        ESP_LOGI(TAG, "Session %lu closed: %llu bytes in %lu segment(s)", (unsigned long)current.session,
+                 (unsigned long long)current.stream_offset, (unsigned long)current.index);
+    }
+    memset(&current, 0, sizeof(current));
+    heap_caps_free(segment);
+    segment = NULL;
+    return ok;
+}
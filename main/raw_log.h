@@ -0,0 +1,24 @@
+#ifndef RAW_LOG_H
+#define RAW_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "wav_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== API PÚBLICA ====================
+// Escritura de sesiones en la partición RAW (formato en raw_log_format.h)
+bool raw_log_begin(const char* name, time_t start, const wav_format_t* fmt);
+size_t raw_log_write(const void* data, size_t len);
+bool raw_log_checkpoint(void);
+bool raw_log_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RAW_LOG_H
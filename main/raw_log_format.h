@@ -0,0 +1,93 @@
+#ifndef RAW_LOG_FORMAT_H
+#define RAW_LOG_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-card layout of the raw audio log, shared by the recorder and the
+ * offline extractor (tools/raw_extract.c).
+ *
+ * The log lives in its own MBR partition of type RAW_LOG_PARTITION_TYPE.
+ * Sector 0 of the partition holds the superblock; the rest is divided into
+ * fixed slots of RAW_LOG_SEGMENT_SECTORS, used as a circular log. Each slot
+ * holds one segment: a one-sector header followed by audio payload. All
+ * integers are little-endian.
+ *
+ * Segments are self-describing, so the log can be read without the
+ * superblock: a segment is valid if its header CRC matches, and its audio
+ * if the payload CRC matches. Consecutive segments of the log carry
+ * consecutive sequence numbers; the first slot that breaks the chain is
+ * where writing resumes. The superblock only records where that was at
+ * the last checkpoint, to shorten the scan; a damaged one is rebuilt from
+ * the slot headers (highest sequence and session).
+ */
+
+// ==================== CONFIGURACIÓN ====================
+#define RAW_LOG_SECTOR_SIZE 512
+#define RAW_LOG_PARTITION_TYPE 0xDA             /**< MBR type "non-FS data" */
+#define RAW_LOG_SEGMENT_SECTORS 128             /**< Slot size: 64 KB, one multi-block write */
+#define RAW_LOG_SEGMENT_PAYLOAD ((RAW_LOG_SEGMENT_SECTORS - 1) * RAW_LOG_SECTOR_SIZE)
+#define RAW_LOG_SUPER_MAGIC 0x31574152u         /**< "RAW1" */
+#define RAW_LOG_SEGMENT_MAGIC 0x47455352u       /**< "RSEG" */
+#define RAW_LOG_VERSION 1
+#define RAW_LOG_NAME_MAX 64                     /**< Session name including the terminator */
+
+#define RAW_LOG_FLAG_LAST 0x0001                /**< Session closed in this segment (unset if it closed on a segment boundary or was cut) */
+
+/** Sector 0 of the partition */
+typedef struct {
+    uint32_t magic;             /**< RAW_LOG_SUPER_MAGIC */
+    uint16_t version;           /**< RAW_LOG_VERSION */
+    uint16_t segment_sectors;   /**< Sectors per slot */
+    uint32_t first_sector;      /**< Partition sector of slot 0 */
+    uint32_t slots;             /**< Slots in the partition */
+    uint64_t next_sequence;     /**< Sequence of the segment to write at head_slot */
+    uint32_t head_slot;         /**< Slot to write next, as of the last checkpoint */
+    uint32_t next_session;      /**< Session number to use next */
+    uint32_t reserved;
+    uint32_t crc;               /**< CRC-32 of the fields above */
+} raw_log_super_t;
+
+/** First sector of every slot; the payload follows it */
+typedef struct {
+    uint32_t magic;             /**< RAW_LOG_SEGMENT_MAGIC */
+    uint16_t version;           /**< RAW_LOG_VERSION */
+    uint16_t flags;             /**< RAW_LOG_FLAG_* */
+    uint64_t sequence;          /**< Position in the log, +1 per segment written */
+    uint32_t session;           /**< Recording session */
+    uint32_t index;             /**< Segment number within the session */
+    uint64_t stream_offset;     /**< Session audio bytes before this segment */
+    int64_t start_time;         /**< Session start, Unix time */
+    uint32_t sample_rate;       /**< PCM format of the session */
+    uint16_t channels;
+    uint16_t bits_per_sample;
+    uint32_t payload_bytes;     /**< Audio bytes in this segment */
+    uint32_t payload_crc;       /**< CRC-32 of those bytes */
+    char name[RAW_LOG_NAME_MAX];/**< File name the session would have had on FAT */
+    uint32_t reserved;
+    uint32_t header_crc;        /**< CRC-32 of the fields above */
+} raw_log_segment_t;
+
+_Static_assert(sizeof(raw_log_super_t) == 40, "raw_log_super_t layout");
+_Static_assert(sizeof(raw_log_segment_t) == 128, "raw_log_segment_t layout");
+
+// ==================== API PÚBLICA ====================
+uint32_t raw_log_crc32(uint32_t crc, const void* data, size_t len);
+void raw_log_seal_super(raw_log_super_t* sb);
+bool raw_log_super_valid(const raw_log_super_t* sb);
+void raw_log_seal_segment(raw_log_segment_t* seg, const void* payload);
+bool raw_log_segment_valid(const raw_log_segment_t* seg);
+bool raw_log_payload_valid(const raw_log_segment_t* seg, const void* payload);
+bool raw_log_find_partition(const uint8_t* mbr, uint32_t* first_sector, uint32_t* sectors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RAW_LOG_FORMAT_H
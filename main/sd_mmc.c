@@ -1,18 +1,38 @@
 #include "sd_mmc.h"
 #include "esp_vfs_fat.h"
+#include "esp_heap_caps.h"
+#include "ff.h"
+#include "diskio_sdmmc.h"
 #include "driver/sdmmc_host.h"
 #include "driver/sdmmc_types.h"
 #include "sdmmc_cmd.h"
 #include "esp_log.h"
+#include "esp_cpu.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "rtc_updater.h"
+#include "sd_profile.h"
+#include "raw_log_format.h"
 
 static const char* TAG = "SD";
 static sdmmc_card_t* card = NULL;
 static const char* base_path = "/sdcard";
+static char drive[4] = "0:";    // FatFs logical drive of the card, for direct access
+
+// Mount manager: the card stays mounted while unused, until sd_card_unmount()
+static uint32_t mount_refs = 0;                 /**< Outstanding sd_card_acquire() calls */
+static SemaphoreHandle_t mount_lock = NULL;     /**< Serializes mount, unmount and mount_refs */
+static StaticSemaphore_t mount_lock_buf;
+static portMUX_TYPE mount_lock_init = portMUX_INITIALIZER_UNLOCKED;
+
+// Write profile of the mounted card (see sd_profile.h)
+static uint32_t mount_freq_khz = 0;                 /**< Bus clock of the current mount */
+static uint32_t write_size = SD_FILE_STAGE_SIZE;    /**< sd_file_t staging buffer size */
+static sd_write_hook_t write_hook = NULL;           /**< Told about every timed card access */
 
 // Board-specific pin definitions
 #define MMC_CLK  7
@@ -22,25 +42,38 @@ static const char* base_path = "/sdcard";
 #define MMC_D2   4
 #define MMC_D3   5
 
+/**
+ * @brief Take the mount lock, creating it on first use.
+ */
+static void lock_mount(void)
+{
+    taskENTER_CRITICAL(&mount_lock_init);
+    if (!mount_lock) mount_lock = xSemaphoreCreateMutexStatic(&mount_lock_buf);
+    taskEXIT_CRITICAL(&mount_lock_init);
+    xSemaphoreTake(mount_lock, portMAX_DELAY);
+}
+
 /**
  * @brief Initialize and mount the SD/MMC card.
  *
  * Configures SDMMC pins, slot, clock speed, and mounts the card
  * using FAT filesystem under /sdcard. Logs errors if mounting fails.
+ *
+ * @param freq_khz SDMMC bus clock
  */
-void sd_card_init(void)
+static void mount_card(uint32_t freq_khz)
 {
     ESP_LOGI(TAG, "Initializing SD card...");
     esp_err_t ret;
 
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,
-        .max_files = 1,
-        .allocation_unit_size = 16 * 1024,
+        .max_files = 2,     // Sidecars (spectrum, level log); audio files use sd_file_t
+        .allocation_unit_size = SD_ALLOCATION_UNIT,
     };
 
     sdmmc_host_t host = SDMMC_HOST_DEFAULT();
-    host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+    host.max_freq_khz = freq_khz;
 
     sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
     slot_config.clk = MMC_CLK;
@@ -60,7 +93,9 @@ void sd_card_init(void)
         return;
     }
 
-    ESP_LOGI(TAG, "SD mounted at %s", base_path);
+    snprintf(drive, sizeof(drive), "%u:", ff_diskio_get_pdrv_card(card));
+    mount_freq_khz = freq_khz;
+    ESP_LOGI(TAG, "SD mounted at %s (%lu kHz)", base_path, (unsigned long)freq_khz);
 }
 
 /**
@@ -68,7 +103,7 @@ void sd_card_init(void)
  *
  * Logs unmount operation.
  */
-void sd_card_deinit(void)
+static void unmount_card(void)
 {
     if (card) {
         esp_vfs_fat_sdcard_unmount(base_path, card);
@@ -77,6 +112,134 @@ void sd_card_deinit(void)
     }
 }
 
+/**
+ * @brief Mount at a given bus clock, remounting if the card runs at another.
+ */
+static void mount_at(uint32_t freq_khz)
+{
+    if (card && mount_freq_khz == freq_khz) return;
+    unmount_card();
+    mount_card(freq_khz);
+}
+
+/**
+ * @brief Measure every write size at every bus clock and pick the best profile.
+ * @param best Receives the winner
+ * @return false if no measurement succeeded
+ */
+static bool calibrate_card(sd_profile_t* best)
+{
+    static const uint32_t freqs[] = { SDMMC_FREQ_HIGHSPEED, SDMMC_FREQ_DEFAULT };
+    bool found = false;
+
+    ESP_LOGI(TAG, "New card, calibrating write size and bus speed...");
+    for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+        mount_at(freqs[f]);
+        if (!card) continue;
+
+        char path[32];
+        snprintf(path, sizeof(path), "%s%s", drive, SD_PROFILE_TEST_FILE);
+        for (uint32_t size = SD_PROFILE_MIN_WRITE; size <= SD_PROFILE_MAX_WRITE; size *= 2) {
+            // A recording holds two staging buffers (current and pre-created file)
+            if (heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) < 2 * size) break;
+
+            sd_profile_t p = { .freq_khz = freqs[f] };
+            if (!sd_profile_measure(path, size, &p)) continue;
+            ESP_LOGI(TAG, "  %5lu kHz, %3lu KB writes: %5lu KB/s, worst write %lu us",
+                     (unsigned long)p.freq_khz, (unsigned long)(size / 1024),
+                     (unsigned long)p.throughput_kbps, (unsigned long)p.max_latency_us);
+            if (!found || sd_profile_better(&p, best)) {
+                *best = p;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Mount the card with its stored write profile, calibrating a new card first.
+ *
+ * The card is mounted at SDMMC_FREQ_HIGHSPEED to read its CID, then
+ * remounted if its profile uses another clock. Without a usable profile
+ * the defaults (high speed, SD_FILE_STAGE_SIZE) apply.
+ */
+static void mount_tuned(void)
+{
+    write_size = SD_FILE_STAGE_SIZE;
+    mount_at(SDMMC_FREQ_HIGHSPEED);
+    if (!card) return;
+
+    uint32_t key = sd_profile_card_key(card);
+    sd_profile_t profile;
+    if (!sd_profile_load(key, &profile)) {
+        if (!calibrate_card(&profile)) {
+            ESP_LOGW(TAG, "Calibration failed, using default write settings");
+            mount_at(SDMMC_FREQ_HIGHSPEED);
+            return;
+        }
+        sd_profile_save(key, &profile);
+    }
+
+    mount_at(profile.freq_khz);
+    if (!card) {
+        ESP_LOGW(TAG, "Card does not mount at its profile clock, using defaults");
+        mount_at(SDMMC_FREQ_HIGHSPEED);
+        return;
+    }
+    write_size = profile.write_size;
+    ESP_LOGI(TAG, "Card %08lx: %lu KB writes at %lu kHz (%lu KB/s, worst write %lu us)",
+             (unsigned long)key, (unsigned long)(write_size / 1024), (unsigned long)profile.freq_khz,
+             (unsigned long)profile.throughput_kbps, (unsigned long)profile.max_latency_us);
+}
+
+/**
+ * @brief Take a reference on the card, mounting it if it is not mounted.
+ *
+ * Mounting (card init and FAT scan) happens once; later users of the
+ * same wake share the mount. Each call must be paired with
+ * sd_card_release(), also when the mount failed: a later acquire retries.
+ *
+ * @return true if the card is mounted.
+ */
+bool sd_card_acquire(void)
+{
+    lock_mount();
+    if (!card) mount_tuned();
+    mount_refs++;
+    bool mounted = card != NULL;
+    xSemaphoreGive(mount_lock);
+    return mounted;
+}
+
+/**
+ * @brief Drop a reference taken with sd_card_acquire().
+ *
+ * The card stays mounted for the next user; only sd_card_unmount()
+ * unmounts it.
+ */
+void sd_card_release(void)
+{
+    lock_mount();
+    if (mount_refs > 0) mount_refs--;
+    else ESP_LOGW(TAG, "sd_card_release() without sd_card_acquire()");
+    xSemaphoreGive(mount_lock);
+}
+
+/**
+ * @brief Unmount the card now, before deep sleep or after an I/O error.
+ *
+ * Files must be closed first. Outstanding references stay counted and
+ * the next sd_card_acquire() mounts again.
+ */
+void sd_card_unmount(void)
+{
+    lock_mount();
+    if (mount_refs > 0) ESP_LOGW(TAG, "Unmounting with %u reference(s) held", (unsigned)mount_refs);
+    unmount_card();
+    xSemaphoreGive(mount_lock);
+}
+
 /**
  * @brief Check if a file exists on the SD card.
  *
@@ -116,6 +279,454 @@ void sd_card_close(FILE* file)
     if (file) { fclose(file); }
 }
 
+/**
+ * @brief Delete a file on the SD card.
+ *
+ * @param path Relative path of the file (from SD root).
+ * @return true if the file was removed.
+ */
+bool sd_card_remove(const char* path)
+{
+    char full_path[128];
+    snprintf(full_path, sizeof(full_path), "%s%s", base_path, path);
+    return remove(full_path) == 0;
+}
+
+/**
+ * @brief Read a small file into a new buffer.
+ * @return Contents (free() them) with room for a terminator, NULL if missing, empty or too large
+ */
+static char* read_small_file(const char* path, size_t* len)
+{
+    FILE* f = sd_card_open(path, "rb");
+    if (!f) return NULL;
+    char* buf = malloc(SD_PREPARE_KEEP_MAX);
+    *len = buf ? fread(buf, 1, SD_PREPARE_KEEP_MAX, f) : 0;
+    bool whole = feof(f);
+    fclose(f);
+    if (*len == 0 || !whole) {
+        if (buf && !whole) ESP_LOGW(TAG, "%s is too large to keep", path);
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/**
+ * @brief Cluster and data-area alignment for the card, following the SD file system spec.
+ *
+ * The data area starts on an allocation unit (AU) boundary, the card's
+ * erase and write-management block, so no cluster straddles two AUs.
+ * SDHC cards get FAT32 with 32 KB clusters and SDXC cards exFAT with
+ * 128 KB (256 KB above 512 GB), never more than the AU. The marker file
+ * may ask for "fat32" or "exfat" instead.
+ *
+ * @param marker Contents of SD_PREPARE_FILE (may be NULL)
+ * @param opt Receives the f_mkfs() parameters
+ * @return AU size in bytes
+ */
+static uint32_t plan_format(const char* marker, MKFS_PARM* opt)
+{
+    uint32_t au = card->ssr.alloc_unit_kb ? card->ssr.alloc_unit_kb * 1024u : SD_PREPARE_DEFAULT_AU;
+    uint64_t sectors = (uint64_t)card->csd.capacity;
+
+    bool exfat = sectors > (32ull << 30) / 512;     // SDXC
+    if (marker && strncasecmp(marker, "fat32", 5) == 0) exfat = false;
+    if (marker && strncasecmp(marker, "exfat", 5) == 0) exfat = true;
+#if !FF_FS_EXFAT
+    if (exfat) ESP_LOGW(TAG, "exFAT is not enabled in FatFs, formatting FAT32");
+    exfat = false;
+#endif
+
+    uint32_t cluster = !exfat ? 32 * 1024 : (sectors > (512ull << 30) / 512) ? 256 * 1024 : 128 * 1024;
+    if (cluster > au) cluster = au;
+
+    // FatFs aligns to a power of two of at most 32768 sectors: the largest that divides the AU
+    uint32_t align = (au / 512) & -(au / 512);
+    if (align > 32768) align = 32768;
+
+    memset(opt, 0, sizeof(*opt));
+    opt->fmt = exfat ? FM_EXFAT : FM_FAT32;
+    opt->n_fat = exfat ? 1 : 2;
+    opt->align = align;
+    opt->au_size = cluster;
+    return au;
+}
+
+/**
+ * @brief Reformat the card aligned to its allocation unit, then verify by benchmark.
+ *
+ * Requested by placing SD_PREPARE_FILE on the card; everything else on it
+ * is erased, except config.txt and Calendar.csv, which are written back.
+ * The old and new layouts are timed with the same write size, the card
+ * is recalibrated (sd_profile.h) for its new layout, and the results are
+ * written to SD_PREPARE_REPORT. The card must be acquired.
+ *
+ * SD_PREPARE_FILE is deleted before anything can fail, so a failed
+ * preparation is not retried on every boot. A card with a raw log
+ * partition (raw_log_format.h) is left alone: f_mkfs() writes a new
+ * single-partition MBR, which would delete it.
+ *
+ * @return true if the card was formatted and mounts again.
+ */
+bool sd_card_prepare(void)
+{
+    static const char* const keep[] = { "/config.txt", "/Calendar.csv" };
+    char* kept[sizeof(keep) / sizeof(keep[0])] = { NULL };
+    size_t kept_len[sizeof(keep) / sizeof(keep[0])] = { 0 };
+
+    lock_mount();
+    if (!card) {
+        xSemaphoreGive(mount_lock);
+        return false;
+    }
+
+    size_t marker_len;
+    char* marker = read_small_file(SD_PREPARE_FILE, &marker_len);
+    if (marker) marker[marker_len] = '\0';     // read_small_file() leaves room
+    if (!sd_card_remove(SD_PREPARE_FILE)) ESP_LOGW(TAG, "Cannot delete %s", SD_PREPARE_FILE);
+
+    uint32_t raw_first, raw_sectors;
+    bool raw_log = false;
+    uint8_t* mbr = heap_caps_malloc(512, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    bool mbr_read = mbr && sd_card_read_sectors(mbr, 0, 1);
+    if (mbr_read) raw_log = raw_log_find_partition(mbr, &raw_first, &raw_sectors);
+    heap_caps_free(mbr);
+    if (!mbr_read || raw_log) {
+        if (raw_log) {
+            ESP_LOGE(TAG, "Card has a raw log partition (MBR type 0x%02X, %lu sectors); formatting would delete it. "
+                          "Not preparing", RAW_LOG_PARTITION_TYPE, (unsigned long)raw_sectors);
+            FILE* f = sd_card_open(SD_PREPARE_REPORT, "w");
+            if (f) {
+                fprintf(f, "refused=raw log partition (MBR type 0x%02X) would be deleted\n", RAW_LOG_PARTITION_TYPE);
+                fclose(f);
+            }
+        } else {
+            ESP_LOGE(TAG, "Cannot read the MBR. Not preparing");
+        }
+        free(marker);
+        xSemaphoreGive(mount_lock);
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(keep) / sizeof(keep[0]); i++) kept[i] = read_small_file(keep[i], &kept_len[i]);
+
+    MKFS_PARM opt;
+    uint32_t au = plan_format(marker, &opt);
+    free(marker);
+    uint32_t key = sd_profile_card_key(card);
+    uint32_t test_size = write_size;
+
+    char path[32];
+    snprintf(path, sizeof(path), "%s%s", drive, SD_PROFILE_TEST_FILE);
+    sd_profile_t before = { 0 }, after = { 0 };
+    sd_profile_measure(path, test_size, &before);
+
+    ESP_LOGW(TAG, "Formatting card: %s, %lu KB clusters, data aligned to %lu KB (AU %lu KB)",
+             opt.fmt == FM_EXFAT ? "exFAT" : "FAT32", (unsigned long)(opt.au_size / 1024),
+             (unsigned long)(opt.align / 2), (unsigned long)(au / 1024));
+    FRESULT res = FR_INT_ERR;
+    void* work = heap_caps_malloc(SD_PREPARE_WORK_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (work) {
+        f_mount(NULL, drive, 0);
+        res = f_mkfs(drive, &opt, work, SD_PREPARE_WORK_SIZE);
+        heap_caps_free(work);
+    }
+    unmount_card();
+    if (res != FR_OK) ESP_LOGE(TAG, "Format failed (%d)", res);
+
+    sd_profile_forget(key);     // The old layout's measurements no longer apply
+    if (res == FR_OK) mount_tuned();
+
+    bool ok = res == FR_OK && card;
+    if (ok) {
+        for (size_t i = 0; i < sizeof(keep) / sizeof(keep[0]); i++) {
+            if (!kept[i]) continue;
+            FILE* f = sd_card_open(keep[i], "wb");
+            if (!f || fwrite(kept[i], 1, kept_len[i], f) != kept_len[i]) ESP_LOGE(TAG, "Cannot restore %s", keep[i]);
+            if (f) fclose(f);
+        }
+
+        // Verify the layout FatFs actually created, then time it like the old one
+        DWORD free_clusters;
+        FATFS* fs;
+        LBA_t data_sector = 0;
+        uint32_t cluster_bytes = 0;
+        if (f_getfree(drive, &free_clusters, &fs) == FR_OK) {
+            data_sector = fs->database;
+            cluster_bytes = fs->csize * 512u;
+        }
+        bool aligned = data_sector != 0 && data_sector % opt.align == 0;
+        sd_profile_measure(path, test_size, &after);
+
+        ESP_LOGI(TAG, "Prepared: %lu KB clusters, data area %s; %lu KB writes %lu -> %lu KB/s, worst %lu -> %lu us",
+                 (unsigned long)(cluster_bytes / 1024), aligned ? "aligned" : "NOT aligned",
+                 (unsigned long)(test_size / 1024), (unsigned long)before.throughput_kbps,
+                 (unsigned long)after.throughput_kbps, (unsigned long)before.max_latency_us,
+                 (unsigned long)after.max_latency_us);
+
+        FILE* f = sd_card_open(SD_PREPARE_REPORT, "w");
+        if (f) {
+            fprintf(f, "filesystem=%s\ncluster_kb=%lu\nau_kb=%lu\ndata_sector=%lu\naligned=%s\n"
+                       "write_kb=%lu\nbefore_kbps=%lu\nafter_kbps=%lu\nbefore_max_us=%lu\nafter_max_us=%lu\n"
+                       "profile_write_kb=%lu\nprofile_freq_khz=%lu\n",
+                    opt.fmt == FM_EXFAT ? "exFAT" : "FAT32", (unsigned long)(cluster_bytes / 1024),
+                    (unsigned long)(au / 1024), (unsigned long)data_sector, aligned ? "yes" : "no",
+                    (unsigned long)(test_size / 1024), (unsigned long)before.throughput_kbps,
+                    (unsigned long)after.throughput_kbps, (unsigned long)before.max_latency_us,
+                    (unsigned long)after.max_latency_us, (unsigned long)(write_size / 1024),
+                    (unsigned long)mount_freq_khz);
+            fclose(f);
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(keep) / sizeof(keep[0]); i++) free(kept[i]);
+    xSemaphoreGive(mount_lock);
+    return ok;
+}
+
+/**
+ * @brief Read whole sectors of the mounted card, bypassing FatFs.
+ *
+ * @param dst Destination, count * 512 bytes (DMA-capable avoids a bounce copy).
+ * @param sector First card sector.
+ * @param count Number of sectors.
+ * @return false if no card is mounted or the read failed.
+ */
+bool sd_card_read_sectors(void* dst, uint32_t sector, uint32_t count)
+{
+    if (!card) return false;
+    esp_err_t err = sdmmc_read_sectors(card, dst, sector, count);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Read of %lu sectors at %lu failed: %s",
+                                (unsigned long)count, (unsigned long)sector, esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+/**
+ * @brief Write whole sectors of the mounted card, bypassing FatFs.
+ *
+ * Only for regions outside the FAT volume (the raw log partition). Timed
+ * through the write hook like sd_file_t writes.
+ *
+ * @param src Source, count * 512 bytes, DMA-capable.
+ * @param sector First card sector.
+ * @param count Number of sectors.
+ * @return false if no card is mounted or the write failed.
+ */
+bool sd_card_write_sectors(const void* src, uint32_t sector, uint32_t count)
+{
+    if (!card) return false;
+    uint32_t t0 = (uint32_t)esp_cpu_get_cycle_count();
+    esp_err_t err = sdmmc_write_sectors(card, src, sector, count);
+    if (write_hook) write_hook(err == ESP_OK ? (size_t)count * 512 : 0, (uint32_t)esp_cpu_get_cycle_count() - t0);
+    if (err != ESP_OK) ESP_LOGE(TAG, "Write of %lu sectors at %lu failed: %s",
+                                (unsigned long)count, (unsigned long)sector, esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+/**
+ * @brief File written with FatFs directly, bypassing VFS and newlib stdio.
+ *
+ * Data is collected in a DMA-capable staging buffer and handed to f_write()
+ * one whole buffer at a time, always at a file offset that is a multiple
+ * of its size (the card's calibrated write size, a power of two). Since a
+ * file starts on a cluster, every write is whole sectors starting on a
+ * cluster or sub-cluster boundary: FatFs passes it straight to the
+ * SDMMC driver as one multi-block transfer, with no sector-buffer copy and
+ * no bounce buffer. The FatFs file pointer always stays at stage_pos.
+ */
+struct sd_file {
+    FIL fil;
+    uint8_t* stage;             /**< stage_size bytes, internal DMA-capable RAM */
+    size_t stage_size;          /**< Bytes per f_write() */
+    uint64_t stage_pos;         /**< File offset of stage[0] */
+    size_t fill;                /**< Bytes staged */
+};
+
+/**
+ * @brief Create (or replace) a file for direct writing.
+ *
+ * With prealloc the file gets that many bytes in consecutive clusters up
+ * front (f_expand), so FatFs never touches the FAT while it is written;
+ * sd_file_close() cuts it back to the data written. If the card has no
+ * contiguous free space that large the file simply grows as usual.
+ *
+ * f_expand() also sets the file size to prealloc, and every f_sync()
+ * (sd_file_sync()) stores that size in the directory entry. A file cut
+ * by a power loss therefore keeps the full preallocated size, and
+ * whatever was on the card before fills it past the last data written.
+ * Only formats whose header records the real length survive that.
+ *
+ * @param path Relative path of the file (from SD root).
+ * @param prealloc Bytes to reserve, 0 for none.
+ * @return File handle, NULL on failure.
+ */
+sd_file_t* sd_file_create(const char* path, uint64_t prealloc)
+{
+    char ff_path[128];
+    snprintf(ff_path, sizeof(ff_path), "%s%s", drive, path);
+
+    sd_file_t* file = calloc(1, sizeof(sd_file_t));
+    if (!file) return NULL;
+    file->stage_size = write_size;
+    file->stage = heap_caps_malloc(file->stage_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (!file->stage && write_size > SD_FILE_STAGE_SIZE) {
+        file->stage_size = SD_FILE_STAGE_SIZE;    // Short on internal RAM, fall back to the default
+        file->stage = heap_caps_malloc(file->stage_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    }
+    FRESULT res = file->stage ? f_open(&file->fil, ff_path, FA_WRITE | FA_CREATE_ALWAYS) : FR_INT_ERR;
+    if (res != FR_OK) {
+        ESP_LOGE(TAG, "Cannot create %s (%d)", path, res);
+        heap_caps_free(file->stage);
+        free(file);
+        return NULL;
+    }
+
+    if (prealloc > 0) {
+        if (sizeof(FSIZE_t) < sizeof(uint64_t) && prealloc > 0xFFFFFFFFu) prealloc = 0xFFFFFFFFu;
+        res = f_expand(&file->fil, (FSIZE_t)prealloc, 1);
+        if (res != FR_OK) ESP_LOGW(TAG, "Cannot preallocate %llu bytes for %s (%d)", prealloc, path, res);
+    }
+    return file;
+}
+
+/**
+ * @brief Observe the duration of every card access made by sd_file_t and sd_card_write_sectors().
+ *
+ * The hook runs on the writing task right after each f_write() or sector
+ * write (with the bytes written) and f_sync() (with 0 bytes), with the
+ * CPU cycles the call took. Pass NULL to stop.
+ */
+void sd_card_set_write_hook(sd_write_hook_t hook)
+{
+    write_hook = hook;
+}
+
+static FRESULT timed_write(FIL* fil, const void* data, UINT len, UINT* written)
+{
+    uint32_t t0 = (uint32_t)esp_cpu_get_cycle_count();
+    FRESULT res = f_write(fil, data, len, written);
+    if (write_hook) write_hook(*written, (uint32_t)esp_cpu_get_cycle_count() - t0);
+    return res;
+}
+
+static FRESULT timed_sync(FIL* fil)
+{
+    uint32_t t0 = (uint32_t)esp_cpu_get_cycle_count();
+    FRESULT res = f_sync(fil);
+    if (write_hook) write_hook(0, (uint32_t)esp_cpu_get_cycle_count() - t0);
+    return res;
+}
+
+/**
+ * @brief Write the staged bytes at stage_pos.
+ * @param advance Move past them and empty the stage (only for a full stage)
+ */
+static bool sd_file_flush(sd_file_t* file, bool advance)
+{
+    UINT written;
+    FRESULT res = timed_write(&file->fil, file->stage, (UINT)file->fill, &written);
+    if (res != FR_OK || written != file->fill) {
+        ESP_LOGE(TAG, "f_write failed (%d), %u of %u bytes", res, written, (unsigned)file->fill);
+        return false;
+    }
+    if (advance) {
+        file->stage_pos += file->fill;
+        file->fill = 0;
+        return true;
+    }
+    return f_lseek(&file->fil, (FSIZE_t)file->stage_pos) == FR_OK;
+}
+
+/**
+ * @brief Append data to the file.
+ *
+ * @param file Handle from sd_file_create().
+ * @param data Bytes to append.
+ * @param len Number of bytes.
+ * @return Bytes accepted (less than len on error).
+ */
+size_t sd_file_write(sd_file_t* file, const void* data, size_t len)
+{
+    const uint8_t* in = (const uint8_t*)data;
+    size_t done = 0;
+    while (done < len) {
+        size_t n = file->stage_size - file->fill;
+        if (n > len - done) n = len - done;
+        memcpy(file->stage + file->fill, in + done, n);
+        file->fill += n;
+        done += n;
+        if (file->fill == file->stage_size && !sd_file_flush(file, true)) {
+            file->fill -= n;
+            return done - n;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief Overwrite bytes already appended (e.g. a header).
+ *
+ * Bytes still in the stage are patched in memory; bytes already on the
+ * card are rewritten in place.
+ *
+ * @param file Handle from sd_file_create().
+ * @param offset File offset of the first byte.
+ * @param data Replacement bytes.
+ * @param len Number of bytes, all within what was appended.
+ * @return true on success.
+ */
+bool sd_file_patch(sd_file_t* file, uint64_t offset, const void* data, size_t len)
+{
+    if (offset + len > file->stage_pos + file->fill) return false;
+
+    const uint8_t* in = (const uint8_t*)data;
+    if (offset < file->stage_pos) {
+        size_t n = (offset + len > file->stage_pos) ? (size_t)(file->stage_pos - offset) : len;
+        UINT written;
+        bool ok = f_lseek(&file->fil, (FSIZE_t)offset) == FR_OK &&
+                  timed_write(&file->fil, in, (UINT)n, &written) == FR_OK && written == n;
+        ok = (f_lseek(&file->fil, (FSIZE_t)file->stage_pos) == FR_OK) && ok;
+        if (!ok) return false;
+        in += n;
+        offset += n;
+        len -= n;
+    }
+    memcpy(file->stage + (offset - file->stage_pos), in, len);
+    return true;
+}
+
+/**
+ * @brief Commit everything appended so far, including the FAT entry, to the card.
+ *
+ * The partial stage is written but kept, so the next full flush rewrites
+ * it and writes stay aligned.
+ *
+ * @param file Handle from sd_file_create().
+ * @return true on success.
+ */
+bool sd_file_sync(sd_file_t* file)
+{
+    if (file->fill > 0 && !sd_file_flush(file, false)) return false;
+    return timed_sync(&file->fil) == FR_OK;
+}
+
+/**
+ * @brief Write the remaining data, drop unused preallocation and close the file.
+ *
+ * @param file Handle from sd_file_create(), freed.
+ * @return true if all data reached the card.
+ */
+bool sd_file_close(sd_file_t* file)
+{
+    bool ok = (file->fill == 0) || sd_file_flush(file, true);
+    ok = (f_truncate(&file->fil) == FR_OK) && ok;   // At the end of the data
+    ok = (f_close(&file->fil) == FR_OK) && ok;
+    heap_caps_free(file->stage);
+    free(file);
+    return ok;
+}
+
 /**
  * @brief Create a default configuration file on the SD card.
  *
@@ -2,13 +2,47 @@
 #pragma once
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+// Montaje compartido (referencias)
+bool sd_card_acquire(void);
+void sd_card_release(void);
+void sd_card_unmount(void);
+
+// Preparación de la tarjeta: formato alineado a su unidad de asignación (AU)
+#define SD_PREPARE_FILE "/prepare_card.txt"     // Its presence at boot requests sd_card_prepare(); may say "fat32" or "exfat"
+#define SD_PREPARE_REPORT "/card_prepare.txt"   // Layout and before/after write speed
+#define SD_PREPARE_DEFAULT_AU (4 * 1024 * 1024) // When the card does not report its AU
+#define SD_PREPARE_WORK_SIZE (32 * 1024)        // f_mkfs() work buffer
+#define SD_PREPARE_KEEP_MAX (16 * 1024)         // Largest file carried over the format
+
+bool sd_card_prepare(void);
 
 // Funciones básicas SD
-void sd_card_init(void);
-void sd_card_deinit(void);
 bool sd_card_exists(const char* path);
 FILE* sd_card_open(const char* path, const char* mode);
 void sd_card_close(FILE* file);
+bool sd_card_remove(const char* path);
+
+// Escritura directa por FatFs (audio)
+#define SD_ALLOCATION_UNIT (16 * 1024)      // Cluster size when the card is formatted
+#define SD_FILE_STAGE_SIZE SD_ALLOCATION_UNIT // Staging buffer of uncalibrated cards: whole sectors, flushed aligned
+
+typedef struct sd_file sd_file_t;
+
+sd_file_t* sd_file_create(const char* path, uint64_t prealloc);
+size_t sd_file_write(sd_file_t* file, const void* data, size_t len);
+bool sd_file_patch(sd_file_t* file, uint64_t offset, const void* data, size_t len);
+bool sd_file_sync(sd_file_t* file);
+bool sd_file_close(sd_file_t* file);
+
+// Acceso directo a sectores (fuera del volumen FAT)
+bool sd_card_read_sectors(void* dst, uint32_t sector, uint32_t count);
+bool sd_card_write_sectors(const void* src, uint32_t sector, uint32_t count);
+
+// Duración de cada acceso a la tarjeta (bytes escritos, 0 en f_sync; ciclos de CPU)
+typedef void (*sd_write_hook_t)(size_t bytes, uint32_t cycles);
+void sd_card_set_write_hook(sd_write_hook_t hook);
 
 // Estructura y funciones para config.txt
 typedef struct {
@@ -0,0 +1,144 @@
+// sd_profile.c
+#include "sd_profile.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ff.h"
+#include "nvs.h"
+#include <stdio.h>
+
+static const char* TAG = "SD_PROFILE";
+static const char* NVS_NAMESPACE = "sd_profile";
+
+/**
+ * @brief Identify a card by a hash of its raw CID (manufacturer, product, serial).
+ */
+uint32_t sd_profile_card_key(const sdmmc_card_t* card)
+{
+    const uint8_t* p = (const uint8_t*)card->raw_cid;
+    uint32_t hash = 2166136261u;                // FNV-1a
+    for (size_t i = 0; i < sizeof(card->raw_cid); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// ==================== NVS ====================
+/**
+ * @brief Read the stored profile of a card.
+ * @return false if the card has not been calibrated
+ */
+bool sd_profile_load(uint32_t key, sd_profile_t* profile)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "%08lx", (unsigned long)key);
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return false;
+    size_t size = sizeof(*profile);
+    esp_err_t err = nvs_get_blob(nvs, name, profile, &size);
+    nvs_close(nvs);
+    return err == ESP_OK && size == sizeof(*profile) &&
+           profile->write_size >= SD_PROFILE_MIN_WRITE && profile->write_size <= SD_PROFILE_MAX_WRITE;
+}
+
+/**
+ * @brief Store the profile of a card.
+ * @return false on NVS error
+ */
+bool sd_profile_save(uint32_t key, const sd_profile_t* profile)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "%08lx", (unsigned long)key);
+
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, name, profile, sizeof(*profile));
+        if (err == ESP_OK) err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) ESP_LOGE(TAG, "Cannot store profile %s: %s", name, esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+/**
+ * @brief Drop the stored profile of a card, so it is calibrated again at the next mount.
+ */
+void sd_profile_forget(uint32_t key)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "%08lx", (unsigned long)key);
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+    if (nvs_erase_key(nvs, name) == ESP_OK) nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+// ==================== MEASUREMENT ====================
+/**
+ * @brief Time SD_PROFILE_TEST_BYTES of writes of one size on the mounted card.
+ *
+ * Uses the same path as recordings: a preallocated file written with
+ * f_write() from an internal DMA-capable buffer, ending with f_sync() so
+ * the card's own flush is counted. The scratch file is removed.
+ *
+ * @param ff_path FatFs path of the scratch file
+ * @param write_size Bytes per f_write(), a multiple of 512
+ * @param result Receives write_size, throughput and worst latency (freq_khz untouched)
+ * @return false if the buffer or the file could not be used
+ */
+bool sd_profile_measure(const char* ff_path, uint32_t write_size, sd_profile_t* result)
+{
+    uint8_t* buf = heap_caps_malloc(write_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (!buf) return false;
+    for (uint32_t i = 0; i < write_size; i++) buf[i] = (uint8_t)(i * 31 + 7);  // Not an erased-flash pattern
+
+    FIL fil;
+    bool ok = f_open(&fil, ff_path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+    if (ok) {
+        f_expand(&fil, SD_PROFILE_TEST_BYTES, 1);  // Like a preallocated recording; grows normally if it fails
+
+        uint32_t max_us = 0;
+        int64_t start = esp_timer_get_time();
+        for (uint32_t done = 0; ok && done < SD_PROFILE_TEST_BYTES; done += write_size) {
+            int64_t t0 = esp_timer_get_time();
+            UINT written;
+            ok = f_write(&fil, buf, write_size, &written) == FR_OK && written == write_size;
+            uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+            if (us > max_us) max_us = us;
+        }
+        ok = (f_sync(&fil) == FR_OK) && ok;
+        int64_t total_us = esp_timer_get_time() - start;
+        f_close(&fil);
+        f_unlink(ff_path);
+
+        result->write_size = write_size;
+        result->throughput_kbps = (uint32_t)((uint64_t)SD_PROFILE_TEST_BYTES * 1000000 / 1024 / (total_us + 1));
+        result->max_latency_us = max_us;
+    }
+    heap_caps_free(buf);
+    return ok;
+}
+
+/**
+ * @brief Whether a measured candidate beats the best profile so far.
+ *
+ * Profiles within SD_PROFILE_LATENCY_LIMIT_US win over those above it;
+ * among those the fastest wins, but throughput within 5% counts as a tie
+ * that the smaller write size (less internal RAM) wins. Above the limit
+ * the lowest worst-case latency wins.
+ */
+bool sd_profile_better(const sd_profile_t* candidate, const sd_profile_t* best)
+{
+    bool candidate_ok = candidate->max_latency_us <= SD_PROFILE_LATENCY_LIMIT_US;
+    bool best_ok = best->max_latency_us <= SD_PROFILE_LATENCY_LIMIT_US;
+    if (candidate_ok != best_ok) return candidate_ok;
+    if (!candidate_ok) return candidate->max_latency_us < best->max_latency_us;
+
+    uint64_t c = candidate->throughput_kbps, b = best->throughput_kbps;
+    if (c * 20 > b * 21) return true;
+    if (c * 21 < b * 20) return false;
+    return candidate->write_size < best->write_size;
+}
@@ -0,0 +1,41 @@
+#ifndef SD_PROFILE_H
+#define SD_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/sdmmc_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define SD_PROFILE_MIN_WRITE (4 * 1024)         /**< Smallest write size tried */
+#define SD_PROFILE_MAX_WRITE (128 * 1024)       /**< Largest write size tried */
+#define SD_PROFILE_TEST_BYTES (2 * 1024 * 1024) /**< Written per measurement */
+#define SD_PROFILE_LATENCY_LIMIT_US 250000      /**< Worst write a profile may show */
+#define SD_PROFILE_TEST_FILE "/sdcal.tmp"       /**< Scratch file, removed afterwards */
+
+/**
+ * @brief Write settings measured for one card, stored in NVS under its CID.
+ */
+typedef struct {
+    uint32_t freq_khz;          /**< SDMMC bus clock */
+    uint32_t write_size;        /**< Bytes per f_write() (sd_file_t staging buffer) */
+    uint32_t throughput_kbps;   /**< Measured sustained write rate, KB/s */
+    uint32_t max_latency_us;    /**< Slowest single write seen */
+} sd_profile_t;
+
+// ==================== API PÚBLICA ====================
+uint32_t sd_profile_card_key(const sdmmc_card_t* card);
+bool sd_profile_load(uint32_t key, sd_profile_t* profile);
+bool sd_profile_save(uint32_t key, const sd_profile_t* profile);
+void sd_profile_forget(uint32_t key);
+bool sd_profile_measure(const char* ff_path, uint32_t write_size, sd_profile_t* result);
+bool sd_profile_better(const sd_profile_t* candidate, const sd_profile_t* best);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_PROFILE_H
@@ -0,0 +1,264 @@
+// wav_format.c
+#include "wav_format.h"
+#include <string.h>
+
+/**
+ * @brief Store a 16-bit value little-endian.
+ */
+static void put_le16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+/**
+ * @brief Store a 32-bit value little-endian.
+ */
+static void put_le32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/**
+ * @brief Store a 64-bit value little-endian.
+ */
+static void put_le64(uint8_t* p, uint64_t v)
+{
+    put_le32(p, (uint32_t)v);
+    put_le32(p + 4, (uint32_t)(v >> 32));
+}
+
+/**
+ * @brief Write the RIFF/RF64 chunk header and, if requested, the ds64 slot.
+ *
+ * With ds64 a 36-byte chunk follows "WAVE": a JUNK chunk while the file
+ * fits a RIFF, or the ds64 chunk of an RF64 file (EBU Tech 3306) once the
+ * data chunk exceeds WAV_RIFF_MAX_DATA. Both have the same size, so a
+ * file created with the placeholder is upgraded by rewriting its header.
+ *
+ * @param buf Output
+ * @param header_size Header length without the ds64 slot
+ * @param data_size Size of the data chunk in bytes
+ * @param frames Sample frames in the data chunk
+ * @param ds64 Reserve the ds64 slot
+ * @return Offset of the fmt chunk
+ */
+static size_t put_riff(uint8_t* buf, size_t header_size, uint64_t data_size, uint64_t frames, bool ds64)
+{
+    memcpy(buf + 8, "WAVE", 4);
+    if (!ds64) {
+        memcpy(buf, "RIFF", 4);
+        put_le32(buf + 4, (uint32_t)(data_size + header_size - 8));
+        return 12;
+    }
+
+    uint64_t riff_size = data_size + header_size + WAV_DS64_CHUNK_SIZE - 8;
+    if (data_size <= WAV_RIFF_MAX_DATA) {
+        memcpy(buf, "RIFF", 4);
+        put_le32(buf + 4, (uint32_t)riff_size);
+        memcpy(buf + 12, "JUNK", 4);
+        put_le32(buf + 16, WAV_DS64_CHUNK_SIZE - 8);
+        memset(buf + 20, 0, WAV_DS64_CHUNK_SIZE - 8);
+    } else {
+        memcpy(buf, "RF64", 4);
+        put_le32(buf + 4, 0xFFFFFFFFu);
+        memcpy(buf + 12, "ds64", 4);
+        put_le32(buf + 16, WAV_DS64_CHUNK_SIZE - 8);
+        put_le64(buf + 20, riff_size);
+        put_le64(buf + 28, data_size);
+        put_le64(buf + 36, frames);
+        put_le32(buf + 44, 0);          // No table entries
+    }
+    return 12 + WAV_DS64_CHUNK_SIZE;
+}
+
+/**
+ * @brief Bytes per sample frame (all channels).
+ */
+uint32_t wav_block_align(const wav_format_t* fmt)
+{
+    return fmt->channels * ((fmt->bits_per_sample + 7) / 8);
+}
+
+/**
+ * @brief Bytes per second of audio data.
+ */
+uint32_t wav_byte_rate(const wav_format_t* fmt)
+{
+    return fmt->sample_rate * wav_block_align(fmt);
+}
+
+/**
+ * @brief Build a canonical 44-byte PCM WAV header, or 80 bytes with the ds64 slot.
+ * @param buf Output, at least WAV_HEADER_SIZE (+ WAV_DS64_CHUNK_SIZE) bytes
+ * @param fmt Sample format
+ * @param data_size Size of the data chunk in bytes (0 while still recording)
+ * @param ds64 Reserve room for RF64; required for data beyond WAV_RIFF_MAX_DATA
+ * @return Header length in bytes
+ */
+size_t wav_build_header(uint8_t* buf, const wav_format_t* fmt, uint64_t data_size, bool ds64)
+{
+    // p is shifted past the ds64 slot so the chunks keep their canonical offsets
+    uint8_t* p = buf + put_riff(buf, WAV_HEADER_SIZE, data_size, data_size / wav_block_align(fmt), ds64) - 12;
+
+    memcpy(p + 12, "fmt ", 4);
+    put_le32(p + 16, 16);
+    put_le16(p + 20, WAV_FORMAT_PCM);
+    put_le16(p + 22, fmt->channels);
+    put_le32(p + 24, fmt->sample_rate);
+    put_le32(p + 28, wav_byte_rate(fmt));
+    put_le16(p + 32, (uint16_t)wav_block_align(fmt));
+    put_le16(p + 34, fmt->bits_per_sample);
+
+    memcpy(p + 36, "data", 4);
+    put_le32(p + 40, (data_size > WAV_RIFF_MAX_DATA) ? 0xFFFFFFFFu : (uint32_t)data_size);
+    return (size_t)(p - buf) + WAV_HEADER_SIZE;
+}
+
+/**
+ * @brief Build a 60-byte IMA ADPCM WAV header (fmt with samplesPerBlock, fact chunk), 96 with the ds64 slot.
+ * @param buf Output, at least WAV_IMA_HEADER_SIZE (+ WAV_DS64_CHUNK_SIZE) bytes
+ * @param fmt Source PCM format (sample rate and channels are used)
+ * @param block_align Bytes per ADPCM block
+ * @param samples_per_block Frames per ADPCM block
+ * @param frames Real frame count for the fact chunk (0 while still recording)
+ * @param data_size Size of the data chunk in bytes (0 while still recording)
+ * @param ds64 Reserve room for RF64; required for data beyond WAV_RIFF_MAX_DATA
+ * @return Header length in bytes
+ */
+size_t wav_build_ima_header(uint8_t* buf, const wav_format_t* fmt, uint32_t block_align,
+                            uint32_t samples_per_block, uint64_t frames, uint64_t data_size, bool ds64)
+{
+    bool rf64 = ds64 && data_size > WAV_RIFF_MAX_DATA;
+    uint8_t* p = buf + put_riff(buf, WAV_IMA_HEADER_SIZE, data_size, frames, ds64) - 12;
+
+    memcpy(p + 12, "fmt ", 4);
+    put_le32(p + 16, 20);
+    put_le16(p + 20, WAV_FORMAT_IMA_ADPCM);
+    put_le16(p + 22, fmt->channels);
+    put_le32(p + 24, fmt->sample_rate);
+    put_le32(p + 28, (uint32_t)((uint64_t)fmt->sample_rate * block_align / samples_per_block));
+    put_le16(p + 32, (uint16_t)block_align);
+    put_le16(p + 34, 4);
+    put_le16(p + 36, 2);                // cbSize
+    put_le16(p + 38, (uint16_t)samples_per_block);
+
+    memcpy(p + 40, "fact", 4);
+    put_le32(p + 44, 4);
+    put_le32(p + 48, rf64 ? 0xFFFFFFFFu : (uint32_t)frames);
+
+    memcpy(p + 52, "data", 4);
+    put_le32(p + 56, rf64 ? 0xFFFFFFFFu : (uint32_t)data_size);
+    return (size_t)(p - buf) + WAV_IMA_HEADER_SIZE;
+}
+
+// ==================== CUE POINTS ====================
+#define WAV_CUE_POINT_SIZE 24
+#define WAV_LTXT_SIZE 20
+
+/**
+ * @brief Size of a labl entry payload: cue id plus the text, padded to even.
+ */
+static uint32_t labl_size(const wav_cue_t* cue)
+{
+    return 4 + (uint32_t)strnlen(cue->label, WAV_CUE_LABEL_MAX - 1) + 1;
+}
+
+/**
+ * @brief Bytes taken by the cue and LIST/adtl chunks for these cues.
+ * @return 0 if count is 0
+ */
+size_t wav_cue_chunks_size(const wav_cue_t* cues, size_t count)
+{
+    if (count == 0) return 0;
+
+    size_t size = 8 + 4 + count * WAV_CUE_POINT_SIZE;  // cue
+    size += 8 + 4;                                      // LIST adtl
+    for (size_t i = 0; i < count; i++) {
+        size += 8 + WAV_LTXT_SIZE;
+        size += 8 + ((labl_size(&cues[i]) + 1) & ~1u);
+    }
+    return size;
+}
+
+/**
+ * @brief Build a cue chunk and a LIST/adtl chunk describing the cues.
+ *
+ * Each cue gets an ltxt entry carrying its length (purpose "gap ") and a
+ * labl entry with its text, which editors show as region names.
+ *
+ * @param buf Output, wav_cue_chunks_size() bytes
+ * @param cues Cue points in file order
+ * @param count Number of cues
+ * @return Bytes written
+ */
+size_t wav_build_cue_chunks(uint8_t* buf, const wav_cue_t* cues, size_t count)
+{
+    if (count == 0) return 0;
+    uint8_t* p = buf;
+
+    memcpy(p, "cue ", 4);
+    put_le32(p + 4, (uint32_t)(4 + count * WAV_CUE_POINT_SIZE));
+    put_le32(p + 8, (uint32_t)count);
+    p += 12;
+    for (size_t i = 0; i < count; i++, p += WAV_CUE_POINT_SIZE) {
+        put_le32(p, cues[i].id);
+        put_le32(p + 4, cues[i].position);
+        memcpy(p + 8, "data", 4);
+        put_le32(p + 12, 0);            // Chunk start
+        put_le32(p + 16, 0);            // Block start
+        put_le32(p + 20, cues[i].position);
+    }
+
+    uint8_t* list = p;
+    memcpy(p, "LIST", 4);
+    memcpy(p + 8, "adtl", 4);
+    p += 12;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(p, "ltxt", 4);
+        put_le32(p + 4, WAV_LTXT_SIZE);
+        put_le32(p + 8, cues[i].id);
+        put_le32(p + 12, cues[i].length);
+        memcpy(p + 16, "gap ", 4);
+        memset(p + 20, 0, 8);           // Country, language, dialect, code page
+        p += 8 + WAV_LTXT_SIZE;
+
+        uint32_t size = labl_size(&cues[i]);
+        memcpy(p, "labl", 4);
+        put_le32(p + 4, size);
+        put_le32(p + 8, cues[i].id);
+        memcpy(p + 12, cues[i].label, size - 5);
+        p[12 + size - 5] = '\0';
+        p += 8 + size;
+        if (size & 1) *p++ = 0;         // Chunks are word aligned
+    }
+    put_le32(list + 4, (uint32_t)(p - list - 8));
+
+    return (size_t)(p - buf);
+}
+
+/**
+ * @brief Read a 32-bit little-endian value.
+ */
+static uint32_t get_le32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * @brief Grow the RIFF size of a built header by chunks appended after the data.
+ *
+ * For an RF64 header the 64-bit size in the ds64 chunk is updated instead.
+ */
+void wav_extend_riff(uint8_t* header, uint32_t extra_bytes)
+{
+    if (memcmp(header, "RF64", 4) == 0) {
+        uint64_t size = get_le32(header + 20) | (uint64_t)get_le32(header + 24) << 32;
+        put_le64(header + 20, size + extra_bytes);
+    } else {
+        put_le32(header + 4, get_le32(header + 4) + extra_bytes);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef WAV_FORMAT_H
+#define WAV_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ==================== CONFIGURACIÓN ====================
+#define WAV_HEADER_SIZE 44          /**< RIFF + fmt (PCM) + data chunk headers */
+#define WAV_IMA_HEADER_SIZE 60      /**< RIFF + fmt (IMA ADPCM) + fact + data chunk headers */
+#define WAV_DS64_CHUNK_SIZE 36      /**< JUNK placeholder that becomes the RF64 ds64 chunk */
+#define WAV_RIFF_MAX_DATA (0xFFFFFFFFu - 0x100000u)  /**< Largest data chunk kept as RIFF (room for trailing chunks) */
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_IMA_ADPCM 0x0011
+#define WAV_CUE_LABEL_MAX 32        /**< Label text including the terminator */
+
+/** Sample format described by the fmt chunk */
+typedef struct {
+    uint32_t sample_rate;       /**< Frames per second */
+    uint16_t channels;          /**< Interleaved channels */
+    uint16_t bits_per_sample;   /**< 16, 24 or 32 */
+} wav_format_t;
+
+/** Marker stored as a cue point with an adtl ltxt (length) and labl (text) entry */
+typedef struct {
+    uint32_t id;                /**< Cue identifier, unique in the file */
+    uint32_t position;          /**< Sample frame offset in the data chunk */
+    uint32_t length;            /**< Length in sample frames (ltxt), 0 for a point */
+    char label[WAV_CUE_LABEL_MAX];
+} wav_cue_t;
+
+// ==================== API PÚBLICA ====================
+uint32_t wav_block_align(const wav_format_t* fmt);
+uint32_t wav_byte_rate(const wav_format_t* fmt);
+size_t wav_build_header(uint8_t* buf, const wav_format_t* fmt, uint64_t data_size, bool ds64);
+size_t wav_build_ima_header(uint8_t* buf, const wav_format_t* fmt, uint32_t block_align,
+                            uint32_t samples_per_block, uint64_t frames, uint64_t data_size, bool ds64);
+size_t wav_cue_chunks_size(const wav_cue_t* cues, size_t count);
+size_t wav_build_cue_chunks(uint8_t* buf, const wav_cue_t* cues, size_t count);
+void wav_extend_riff(uint8_t* header, uint32_t extra_bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WAV_FORMAT_H
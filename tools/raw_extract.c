@@ -0,0 +1,278 @@
+// raw_extract.c
+//
+// Extract the recordings of a raw log partition (main/raw_log_format.h) to
+// WAV files, on Linux.
+//
+// Build from the repository root:
+//   gcc -O2 -Wall -I main -o raw_extract tools/raw_extract.c main/raw_log_format.c main/wav_format.c
+//
+// Usage:
+//   raw_extract [-l] <card or image> [output directory]
+//
+// The input is the whole card (/dev/sdX, or an image of it), whose MBR
+// points to the raw partition, or an image of the partition alone. It is
+// mapped read-only. Every slot is read, so sessions from the previous lap
+// of the log that have not been overwritten yet are recovered too, as is a
+// session cut by a power loss up to its last written segment. Segments
+// whose payload fails its CRC (a write interrupted by the power loss) and
+// missing segments are replaced by silence so the timing is kept.
+//
+// With -l the sessions are listed and nothing is written.
+
+#include "raw_log_format.h"
+#include "wav_format.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Valid segment found in a slot */
+typedef struct {
+    const raw_log_segment_t* header;
+    const uint8_t* payload;
+} found_segment_t;
+
+static const uint8_t* image = NULL;     // Mapped input
+static uint64_t image_size = 0;
+
+/**
+ * @brief Map the input read-only; block devices report their size through BLKGETSIZE64.
+ */
+static bool map_input(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    image_size = (uint64_t)st.st_size;
+    if (ok && S_ISBLK(st.st_mode)) ok = ioctl(fd, BLKGETSIZE64, &image_size) == 0;
+    if (ok && image_size >= RAW_LOG_SECTOR_SIZE) {
+        void* p = mmap(NULL, image_size, PROT_READ, MAP_SHARED, fd, 0);
+        ok = p != MAP_FAILED;
+        if (ok) image = p;
+    } else {
+        ok = false;
+    }
+    if (!ok) fprintf(stderr, "%s: cannot map (%s)\n", path, errno ? strerror(errno) : "too small");
+    close(fd);
+    return ok;
+}
+
+/**
+ * @brief Find the partition and its slot geometry.
+ *
+ * Uses the superblock if it is intact; otherwise assumes the layout this
+ * firmware creates, since the segments describe themselves.
+ */
+static bool locate_log(uint64_t* base, uint32_t* first_sector, uint32_t* segment_sectors, uint32_t* slots)
+{
+    uint64_t sectors;
+    raw_log_super_t sb;
+    memcpy(&sb, image, sizeof(sb));
+
+    if (raw_log_super_valid(&sb)) {                 // Image of the partition alone
+        *base = 0;
+        sectors = image_size / RAW_LOG_SECTOR_SIZE;
+    } else {
+        uint32_t first, count;
+        if (!raw_log_find_partition(image, &first, &count)) {
+            fprintf(stderr, "No raw log partition (MBR type 0x%02X) and no superblock at the start\n",
+                    RAW_LOG_PARTITION_TYPE);
+            return false;
+        }
+        *base = (uint64_t)first * RAW_LOG_SECTOR_SIZE;
+        sectors = count;
+        if (*base + sectors * RAW_LOG_SECTOR_SIZE > image_size) {
+            fprintf(stderr, "Image is shorter than the raw log partition, reading what is there\n");
+            sectors = (image_size - *base) / RAW_LOG_SECTOR_SIZE;
+        }
+        memcpy(&sb, image + *base, sizeof(sb));
+    }
+
+    if (raw_log_super_valid(&sb)) {
+        *first_sector = sb.first_sector;
+        *segment_sectors = sb.segment_sectors;
+        printf("Superblock: %u slots of %u sectors, head at slot %u, next session %u\n",
+               sb.slots, sb.segment_sectors, sb.head_slot, sb.next_session);
+    } else {
+        fprintf(stderr, "Superblock damaged, assuming the default layout\n");
+        *first_sector = 1;
+        *segment_sectors = RAW_LOG_SEGMENT_SECTORS;
+    }
+    *slots = (sectors > *first_sector) ? (uint32_t)((sectors - *first_sector) / *segment_sectors) : 0;
+    return *slots > 0;
+}
+
+static int compare_segments(const void* a, const void* b)
+{
+    const raw_log_segment_t* x = ((const found_segment_t*)a)->header;
+    const raw_log_segment_t* y = ((const found_segment_t*)b)->header;
+    if (x->session != y->session) return x->session < y->session ? -1 : 1;
+    if (x->index != y->index) return x->index < y->index ? -1 : 1;
+    return (x->sequence < y->sequence) ? -1 : (x->sequence > y->sequence);
+}
+
+/**
+ * @brief Output path for a session: the name it was recorded under, or its number.
+ */
+static void session_path(char* buf, size_t size, const char* dir, const raw_log_segment_t* seg)
+{
+    char name[RAW_LOG_NAME_MAX];
+    memcpy(name, seg->name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+    for (char* c = name; *c; c++) {
+        if (*c == '/') *c = '_';
+    }
+    if (name[0]) snprintf(buf, size, "%s/%s", dir, name);
+    else snprintf(buf, size, "%s/session_%05u.wav", dir, seg->session);
+
+    if (access(buf, F_OK) == 0) {   // Same name recorded twice: keep both
+        size_t len = strlen(buf);
+        snprintf(buf + len, size - len, ".%u.wav", seg->session);
+    }
+}
+
+static bool write_zeros(FILE* f, uint64_t bytes)
+{
+    static const uint8_t zeros[RAW_LOG_SEGMENT_PAYLOAD];
+    while (bytes > 0) {
+        size_t n = (bytes > sizeof(zeros)) ? sizeof(zeros) : (size_t)bytes;
+        if (fwrite(zeros, 1, n, f) != n) return false;
+        bytes -= n;
+    }
+    return true;
+}
+
+/**
+ * @brief Write the segments of one session (sorted by index) as a WAV file.
+ * @return false on a write error
+ */
+static bool extract_session(const found_segment_t* segs, size_t count, const char* dir, bool list_only)
+{
+    const raw_log_segment_t* first = segs[0].header;
+    const raw_log_segment_t* last = segs[count - 1].header;
+    uint64_t start = first->stream_offset;
+    uint64_t data_size = last->stream_offset + last->payload_bytes - start;
+
+    wav_format_t fmt = {
+        .sample_rate = first->sample_rate,
+        .channels = first->channels,
+        .bits_per_sample = first->bits_per_sample,
+    };
+    uint32_t align = wav_block_align(&fmt);
+    if (align == 0 || fmt.sample_rate == 0) {
+        fprintf(stderr, "Session %u: invalid format, skipped\n", first->session);
+        return true;
+    }
+    data_size -= data_size % align;
+
+    char when[32];
+    time_t t = (time_t)first->start_time;
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+    printf("Session %u  %s UTC  %s  %u Hz %u ch %u-bit  %.1f s  %zu segment(s)%s%s\n",
+           first->session, when, first->name[0] ? first->name : "-", fmt.sample_rate, fmt.channels,
+           fmt.bits_per_sample, (double)data_size / align / fmt.sample_rate, count,
+           first->index > 0 ? "  [start overwritten]" : "",
+           (last->flags & RAW_LOG_FLAG_LAST) ? "" : "  [not closed]");
+    if (list_only) return true;
+
+    char path[512];
+    session_path(path, sizeof(path), dir, first);
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    uint8_t header[WAV_HEADER_SIZE + WAV_DS64_CHUNK_SIZE];
+    size_t header_len = wav_build_header(header, &fmt, data_size, data_size > WAV_RIFF_MAX_DATA);
+    bool ok = fwrite(header, 1, header_len, f) == header_len;
+
+    uint64_t pos = 0;           // Data bytes written
+    uint64_t filled = 0;        // Of which silence
+    for (size_t i = 0; ok && i < count && pos < data_size; i++) {
+        const raw_log_segment_t* seg = segs[i].header;
+        uint64_t offset = seg->stream_offset - start;
+        if (offset < pos) continue;                 // Overlaps what is written (should not happen)
+        if (offset > pos) {
+            ok = write_zeros(f, offset - pos);
+            filled += offset - pos;
+            pos = offset;
+        }
+
+        uint64_t n = seg->payload_bytes;
+        if (n > data_size - pos) n = data_size - pos;
+        if (raw_log_payload_valid(seg, segs[i].payload)) {
+            ok = ok && fwrite(segs[i].payload, 1, (size_t)n, f) == n;
+        } else {
+            ok = ok && write_zeros(f, n);
+            filled += n;
+        }
+        pos += n;
+    }
+    if (ok && pos < data_size) {
+        filled += data_size - pos;
+        ok = write_zeros(f, data_size - pos);
+    }
+    if (data_size & 1) ok = ok && fputc(0, f) != EOF;      // RIFF pad byte
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok) fprintf(stderr, "%s: write error\n", path);
+    else printf("  -> %s%s\n", path, filled ? " (missing audio replaced by silence)" : "");
+    if (filled) fprintf(stderr, "  %llu byte(s) missing or damaged\n", (unsigned long long)filled);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    bool list_only = argc > 1 && strcmp(argv[1], "-l") == 0;
+    int arg = list_only ? 2 : 1;
+    if (argc - arg < 1 || argc - arg > 2) {
+        fprintf(stderr, "Usage: %s [-l] <card or image> [output directory]\n", argv[0]);
+        return 2;
+    }
+    const char* dir = (argc - arg == 2) ? argv[arg + 1] : ".";
+    if (!map_input(argv[arg])) return 1;
+
+    uint64_t base;
+    uint32_t first_sector, segment_sectors, slots;
+    if (!locate_log(&base, &first_sector, &segment_sectors, &slots)) return 1;
+
+    found_segment_t* segs = malloc(sizeof(found_segment_t) * slots);
+    if (!segs) return 1;
+    size_t count = 0;
+    for (uint32_t s = 0; s < slots; s++) {
+        const uint8_t* slot = image + base + ((uint64_t)first_sector + (uint64_t)s * segment_sectors) * RAW_LOG_SECTOR_SIZE;
+        const raw_log_segment_t* seg = (const raw_log_segment_t*)slot;
+        if (!raw_log_segment_valid(seg)) continue;
+        if (seg->payload_bytes > (segment_sectors - 1) * RAW_LOG_SECTOR_SIZE) continue;
+        segs[count].header = seg;
+        segs[count].payload = slot + RAW_LOG_SECTOR_SIZE;
+        count++;
+    }
+    printf("%zu valid segment(s) in %u slots\n", count, slots);
+    qsort(segs, count, sizeof(found_segment_t), compare_segments);
+
+    bool ok = true;
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && segs[j].header->session == segs[i].header->session) j++;
+        ok = extract_session(segs + i, j - i, dir, list_only) && ok;
+        i = j;
+    }
+
+    free(segs);
+    munmap((void*)image, image_size);
+    return ok ? 0 : 1;
+}